@@ -165,6 +165,8 @@ JIT_PRODUCT_SOURCE_FILES+=\
     $(JIT_PRODUCT_DIR)/optimizer/RubyInliner.cpp \
     $(JIT_PRODUCT_DIR)/optimizer/RubyTrivialInliner.cpp \
     $(JIT_PRODUCT_DIR)/optimizer/RubyLowerMacroOps.cpp \
+    $(JIT_PRODUCT_DIR)/optimizer/RubyDeadStackStoreElimination.cpp \
+    $(JIT_PRODUCT_DIR)/optimizer/RubyTypePropagation.cpp \
     $(JIT_OMR_DIRTY_DIR)/optimizer/BackwardBitVectorAnalysis.cpp \
     $(JIT_OMR_DIRTY_DIR)/optimizer/BackwardIntersectionBitVectorAnalysis.cpp \
     $(JIT_OMR_DIRTY_DIR)/optimizer/BackwardUnionBitVectorAnalysis.cpp \
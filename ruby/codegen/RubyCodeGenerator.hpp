@@ -31,6 +31,9 @@ namespace Ruby { typedef CodeGenerator CodeGeneratorConnector; }
 
 #include "codegen/OMRCodeGenerator.hpp"
 
+namespace TR { class Node; }
+namespace TR { class Register; }
+
 namespace Ruby
 {
 
@@ -41,6 +44,27 @@ class OMR_EXTENSIBLE CodeGenerator : public OMR::CodeGeneratorConnector
    CodeGenerator() :
       OMR::CodeGeneratorConnector() {}
 
+   /**
+    * The register an overflow test left the sum or difference of its
+    * operands in, for the add or subtract of the same operands after it to
+    * reuse. It is cleared where an extended block ends, and within one the
+    * commoned operands identify the value.
+    */
+   struct OverflowResult
+      {
+      OverflowResult() : left(NULL), right(NULL), isAdd(false), reg(NULL) {}
+
+      TR::Node     *left;
+      TR::Node     *right;
+      bool          isAdd;
+      TR::Register *reg;
+      };
+
+   OverflowResult &overflowResult() { return _overflowResult; }
+
+   private:
+
+   OverflowResult _overflowResult;
    };
 
 }
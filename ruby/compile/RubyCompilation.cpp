@@ -53,6 +53,7 @@ Ruby::Compilation::Compilation(
       options,
       dispatchRegion,
       m,
-      optimizationPlan)
+      optimizationPlan),
+     _inliningBudget(0)
    {
    }
@@ -62,6 +62,17 @@ class Compilation : public OMR::CompilationConnector
 
    ~Compilation() {}
 
+   /**
+    * Bytecode, in iseq slots, that inlining may still add to this
+    * compilation.
+    */
+   int32_t getInliningBudget()               { return _inliningBudget; }
+   void    setInliningBudget(int32_t budget) { _inliningBudget = budget; }
+
+   private:
+
+   int32_t _inliningBudget;
+
    };
 
 }
@@ -27,6 +27,10 @@
 #include "il/symbol/ParameterSymbol.hpp"
 #include "infra/List.hpp"
 
+extern "C" {
+#include "internal.h"                          // for struct RClass, rb_classext_t
+}
+
 
 Ruby::SymbolReferenceTable::SymbolReferenceTable(size_t sizeHint, TR::Compilation *c) :
    OMR::SymbolReferenceTableConnector(sizeHint, c),
@@ -34,10 +38,41 @@ Ruby::SymbolReferenceTable::SymbolReferenceTable(size_t sizeHint, TR::Compilatio
      _ruby_threadSymRefs(c->trMemory()),
      _rubyHelperSymRefs(0),
      _rubyHelperSymRefsBV(sizeHint, c->trMemory(), heapAlloc, growable, TR_Memory::BitVector),
+     _rubyFrameHelperSymRefsBV(sizeHint, c->trMemory(), heapAlloc, growable, TR_Memory::BitVector),
+     _rubyObjectsHelperSymRefsBV(sizeHint, c->trMemory(), heapAlloc, growable, TR_Memory::BitVector),
+     _rubyGlobalHelperSymRefsBV(sizeHint, c->trMemory(), heapAlloc, growable, TR_Memory::BitVector),
+     _rubyStackSlotSymRefsBV(sizeHint, c->trMemory(), heapAlloc, growable, TR_Memory::BitVector),
+     _rubyPCSymRefsBV(sizeHint, c->trMemory(), heapAlloc, growable, TR_Memory::BitVector),
      _rubyRedefinedFlagSymRefs(0),
      _rubyInterrupt_flag_SymRef(0),
      _rubyInterrupt_mask_SymRef(0),
-     _ruby_inlined_receiver_temp_SymRef(c->allocator("SymRefTab"))
+     _rubyBasicFlagsSymRef(0),
+     _rubyBasicKlassSymRef(0),
+     _rubyClassExtSymRef(0),
+     _rubyClassSerialSymRef(0),
+     _rubyObjectNumIVSymRef(0),
+     _rubyObjectIVPtrSymRef(0),
+     _rubyObjectSlotSymRef(0),
+     _rubyICSerialSymRef(0),
+     _rubyICValueSymRef(0),
+     _rubyGlobalConstantStateSymRef(0),
+     _rubyGlobalMethodStateSymRef(0),
+     _rubyISeqJitBodyInfoSymRef(0),
+     _rubyJitStartPCSymRef(0),
+     _rubyStructHeapPtrSymRef(0),
+     _rubyArrayLenSymRef(0),
+     _rubyArrayPtrSymRef(0),
+     _rubyFrameSPSymRef(0),
+     _rubyPrevEPSymRef(0),
+     _rubyPromotedLocals(0),
+     _rubyFrameRegisters(0),
+     _ruby_inlined_receiver_temp_SymRef(c->allocator("SymRefTab")),
+     _ruby_send_argument_temp_SymRefs(c->allocator("SymRefTab")),
+     _ruby_send_receiver_temp_SymRef(c->allocator("SymRefTab")),
+     _ruby_inlined_block_iseq(c->allocator("SymRefTab")),
+     _ruby_virtual_frame(c->allocator("SymRefTab")),
+     _ruby_send_symbol_block_ci(c->allocator("SymRefTab")),
+     _ruby_send_stack_arguments_SymRef(c->allocator("SymRefTab"))
    {
    }
 
@@ -94,6 +129,84 @@ Ruby::SymbolReferenceTable::initializeRubyHelperSymbolRefs(uint32_t maxIndex)
    }
 
 
+/**
+ * The state a helper may read or write. Helpers that may run Ruby code,
+ * reach the interpreter or fill an inline cache may touch anything; the
+ * others are listed here. Any helper that may raise touches the frame, which
+ * exception handlers and backtraces read.
+ */
+uint32_t
+Ruby::SymbolReferenceTable::getRubyHelperEffects(TR_RuntimeHelper helper)
+   {
+   static const char *disableHelperEffects = feGetEnv("OMR_RUBY_DISABLE_HELPER_EFFECTS");
+   if (disableHelperEffects)
+      return HelperEffectsAll;
+
+   switch (helper)
+      {
+      // Remembered set bookkeeping only.
+      case RubyHelper_rb_gc_writebarrier:
+         return HelperEffectsNone;
+
+      // Allocate and fill new objects, which nothing else refers to yet.
+      case RubyHelper_rb_ary_new_capa:
+      case RubyHelper_rb_ary_new_from_values:
+      case RubyHelper_rb_ary_resurrect:
+      case RubyHelper_rb_ary_tmp_new:
+      case RubyHelper_rb_str_new:
+      case RubyHelper_rb_str_new_cstr:
+      case RubyHelper_rb_str_resurrect:
+      case RubyHelper_rb_hash_new:
+      case RubyHelper_rb_obj_alloc:
+         return HelperEffectsFrame;
+
+      // Push and pop frames, or walk environments.
+      case RubyHelper_vm_jit_materialize_frame:
+      case RubyHelper_vm_jit_dematerialize_frame:
+      case RubyHelper_rb_vm_ep_local_ep:
+      case RubyHelper_vm_get_block_ptr:
+         return HelperEffectsFrame;
+
+      // Read the class of an object.
+      case RubyHelper_rb_class_of:
+         return HelperEffectsObjects;
+
+      // Store into arrays without calling back into Ruby; frozen arrays raise.
+      case RubyHelper_rb_ary_push:
+      case RubyHelper_rb_ary_store:
+         return HelperEffectsFrame | HelperEffectsObjects;
+
+      default:
+         return HelperEffectsAll;
+      }
+   }
+
+
+/**
+ * The helpers that may touch any of the state in `effects`.
+ */
+TR_BitVector &
+Ruby::SymbolReferenceTable::getRubyHelperSymRefsWithEffects(uint32_t effects)
+   {
+   switch (effects)
+      {
+      case HelperEffectsFrame:   return _rubyFrameHelperSymRefsBV;
+      case HelperEffectsObjects: return _rubyObjectsHelperSymRefsBV;
+      case HelperEffectsGlobal:  return _rubyGlobalHelperSymRefsBV;
+      case HelperEffectsAll:     return _rubyHelperSymRefsBV;
+      }
+
+   TR_BitVector *helpers = new (comp()->trHeapMemory()) TR_BitVector(0, comp()->trMemory(), heapAlloc, growable);
+   if (effects & HelperEffectsFrame)
+      *helpers |= _rubyFrameHelperSymRefsBV;
+   if (effects & HelperEffectsObjects)
+      *helpers |= _rubyObjectsHelperSymRefsBV;
+   if (effects & HelperEffectsGlobal)
+      *helpers |= _rubyGlobalHelperSymRefsBV;
+   return *helpers;
+   }
+
+
 TR::SymbolReference *
 Ruby::SymbolReferenceTable::findOrCreateRubyHelperSymbolRef(TR_RuntimeHelper helper,
                                                            bool canGCandReturn,
@@ -108,6 +221,13 @@ Ruby::SymbolReferenceTable::findOrCreateRubyHelperSymbolRef(TR_RuntimeHelper hel
       symRef->getSymbol()->castToMethodSymbol()->setSystemLinkageDispatch();
       symRef->getSymbol()->castToMethodSymbol()->setLinkage(TR_System);
       _rubyHelperSymRefsBV.set(symRef->getReferenceNumber());
+      uint32_t effects = getRubyHelperEffects(helper);
+      if (effects & HelperEffectsFrame)
+         _rubyFrameHelperSymRefsBV.set(symRef->getReferenceNumber());
+      if (effects & HelperEffectsObjects)
+         _rubyObjectsHelperSymRefsBV.set(symRef->getReferenceNumber());
+      if (effects & HelperEffectsGlobal)
+         _rubyGlobalHelperSymRefsBV.set(symRef->getReferenceNumber());
       _rubyHelperSymRefs[nameIndex] = symRef;
       }
 
@@ -116,29 +236,47 @@ Ruby::SymbolReferenceTable::findOrCreateRubyHelperSymbolRef(TR_RuntimeHelper hel
 
 
 TR::SymbolReference *
-Ruby::SymbolReferenceTable::createRubyNamedShadowSymRef(char* name, TR::DataTypes dt, size_t size, int32_t offset, bool killedAcrossCalls)
+Ruby::SymbolReferenceTable::createRubyNamedShadowSymRef(char* name, TR::DataTypes dt, size_t size, int32_t offset, bool killedAcrossCalls,
+                                                        uint32_t effects)
    {
    TR::Symbol* symbol = TR::Symbol::createNamedShadow(comp()->trHeapMemory(), dt, size, name);
    TR::SymbolReference* symRef = new (comp()->trHeapMemory()) TR::SymbolReference(self(), symbol, offset);
    symRef->setEmptyUseDefAliases(self());
 
    if(killedAcrossCalls)
-      symRef->setAliasedTo(_rubyHelperSymRefsBV, self(), true /*symmetric*/);
+      symRef->setAliasedTo(getRubyHelperSymRefsWithEffects(effects), self(), true /*symmetric*/);
 
    return symRef;
    }
 
 
 TR::SymbolReference *
-Ruby::SymbolReferenceTable::createRubyNamedStaticSymRef(char* name, TR::DataTypes dt, void* addr, int32_t offset, bool killedAcrossCalls)
+Ruby::SymbolReferenceTable::createRubyNamedStaticSymRef(char* name, TR::DataTypes dt, void* addr, int32_t offset, bool killedAcrossCalls,
+                                                        uint32_t effects)
    {
    TR::Symbol* symbol = TR::StaticSymbol::createNamed(comp()->trHeapMemory(), dt, addr, name);
    TR::SymbolReference* symRef = new (comp()->trHeapMemory()) TR::SymbolReference(self(), symbol, offset);
    symRef->setEmptyUseDefAliases(self());
 
    if (killedAcrossCalls)
-      symRef->setAliasedTo(_rubyHelperSymRefsBV, self(), true /*symmetric*/);
+      symRef->setAliasedTo(getRubyHelperSymRefsWithEffects(effects), self(), true /*symmetric*/);
+
+   return symRef;
+   }
 
+
+/**
+ * A temporary caching VM state that the helpers with `effects` may touch.
+ * It is aliased with those helpers like a shadow of that state, so that no
+ * optimization carries its value across a call to them before the cached
+ * state is written back and reloaded around the call.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::createRubyStateTemporary(TR::ResolvedMethodSymbol *owningMethodSymbol, TR::DataTypes dt, uint32_t effects)
+   {
+   TR::SymbolReference* symRef = createTemporary(owningMethodSymbol, dt);
+   symRef->setEmptyUseDefAliases(self());
+   symRef->setAliasedTo(getRubyHelperSymRefsWithEffects(effects), self(), true /*symmetric*/);
    return symRef;
    }
 
@@ -160,7 +298,7 @@ Ruby::SymbolReferenceTable::findOrCreateRubyRedefinedFlagSymbolRef(int32_t bop,
    {
 
    if(_rubyRedefinedFlagSymRefs[bop] == NULL)
-      _rubyRedefinedFlagSymRefs[bop] = createRubyNamedStaticSymRef(name, dt, addr, offset, killedAcrossCalls);
+      _rubyRedefinedFlagSymRefs[bop] = createRubyNamedStaticSymRef(name, dt, addr, offset, killedAcrossCalls, HelperEffectsGlobal);
 
    return _rubyRedefinedFlagSymRefs[bop];
    }
@@ -177,7 +315,7 @@ TR::SymbolReference *
 Ruby::SymbolReferenceTable::findOrCreateRubyVMEventFlagsSymbolRef(char* name, TR::DataTypes dt, void* addr, int32_t offset, bool killedAcrossCalls)
    {
    if (_ruby_vm_event_flags_SymRef == NULL)
-      _ruby_vm_event_flags_SymRef = createRubyNamedStaticSymRef(name, dt, addr, offset, killedAcrossCalls);
+      _ruby_vm_event_flags_SymRef = createRubyNamedStaticSymRef(name, dt, addr, offset, killedAcrossCalls, HelperEffectsGlobal);
 
    return _ruby_vm_event_flags_SymRef;
    }
@@ -198,7 +336,8 @@ Ruby::SymbolReferenceTable::findOrCreateRubyInterruptFlagSymRef()
                                                                TR_RubyFE::slotType(),
                                                                TR_RubyFE::SLOTSIZE,
                                                                offsetof(rb_thread_t, interrupt_flag),
-                                                               true);
+                                                               true,
+                                                               HelperEffectsGlobal);
    return _rubyInterrupt_flag_SymRef;
    }
 
@@ -211,11 +350,360 @@ Ruby::SymbolReferenceTable::findOrCreateRubyInterruptMaskSymRef()
                                                                TR_RubyFE::slotType(),
                                                                TR_RubyFE::SLOTSIZE,
                                                                offsetof(rb_thread_t, interrupt_mask),
-                                                               true);
+                                                               true,
+                                                               HelperEffectsGlobal);
    return _rubyInterrupt_mask_SymRef;
    }
 
 
+/**
+ * RBasic::flags. Killed across calls, as helpers may freeze an object or
+ * move its ivars out of line.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyBasicFlagsSymRef()
+   {
+   if (!_rubyBasicFlagsSymRef)
+      _rubyBasicFlagsSymRef = createRubyNamedShadowSymRef("RBasic->flags",
+                                                          TR_RubyFE::slotType(),
+                                                          TR_RubyFE::SLOTSIZE,
+                                                          offsetof(struct RBasic, flags),
+                                                          true,
+                                                          HelperEffectsObjects);
+   return _rubyBasicFlagsSymRef;
+   }
+
+
+/**
+ * RBasic::klass. Killed across calls, as a helper may install a singleton
+ * class on the object.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyBasicKlassSymRef()
+   {
+   if (!_rubyBasicKlassSymRef)
+      _rubyBasicKlassSymRef = createRubyNamedShadowSymRef("RBasic->klass",
+                                                          TR_RubyFE::slotType(),
+                                                          TR_RubyFE::SLOTSIZE,
+                                                          offsetof(struct RBasic, klass),
+                                                          true,
+                                                          HelperEffectsObjects);
+   return _rubyBasicKlassSymRef;
+   }
+
+
+/**
+ * RClass::ptr. The class extension of a class never changes.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyClassExtSymRef()
+   {
+   if (!_rubyClassExtSymRef)
+      _rubyClassExtSymRef = createRubyNamedShadowSymRef("RClass->ptr",
+                                                        TR::Address,
+                                                        TR_RubyFE::SLOTSIZE,
+                                                        offsetof(struct RClass, ptr),
+                                                        false,
+                                                        HelperEffectsGlobal);
+   return _rubyClassExtSymRef;
+   }
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyClassSerialSymRef()
+   {
+   static_assert(sizeof(((rb_classext_t *)0)->class_serial) == TR_RubyFE::SLOTSIZE,
+                 "class_serial wrong size");
+   if (!_rubyClassSerialSymRef)
+      _rubyClassSerialSymRef = createRubyNamedShadowSymRef("rb_classext_t->class_serial",
+                                                           TR_RubyFE::slotType(),
+                                                           TR_RubyFE::SLOTSIZE,
+                                                           offsetof(rb_classext_t, class_serial),
+                                                           true,
+                                                           HelperEffectsGlobal);
+   return _rubyClassSerialSymRef;
+   }
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyObjectNumIVSymRef()
+   {
+   if (!_rubyObjectNumIVSymRef)
+      _rubyObjectNumIVSymRef = createRubyNamedShadowSymRef("RObject->as.heap.numiv",
+                                                           TR_RubyFE::slotType(),
+                                                           TR_RubyFE::SLOTSIZE,
+                                                           offsetof(struct RObject, as.heap.numiv),
+                                                           true,
+                                                           HelperEffectsObjects);
+   return _rubyObjectNumIVSymRef;
+   }
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyObjectIVPtrSymRef()
+   {
+   if (!_rubyObjectIVPtrSymRef)
+      _rubyObjectIVPtrSymRef = createRubyNamedShadowSymRef("RObject->as.heap.ivptr",
+                                                           TR::Address,
+                                                           TR_RubyFE::SLOTSIZE,
+                                                           offsetof(struct RObject, as.heap.ivptr),
+                                                           true,
+                                                           HelperEffectsObjects);
+   return _rubyObjectIVPtrSymRef;
+   }
+
+
+/**
+ * A VALUE slot inside an object (an ivar, an array element, ...). The address
+ * of the slot is computed by the user, so the offset is zero.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyObjectSlotSymRef()
+   {
+   if (!_rubyObjectSlotSymRef)
+      _rubyObjectSlotSymRef = createRubyNamedShadowSymRef("object_slot",
+                                                          TR_RubyFE::slotType(),
+                                                          TR_RubyFE::SLOTSIZE,
+                                                          0,
+                                                          true,
+                                                          HelperEffectsObjects);
+   return _rubyObjectSlotSymRef;
+   }
+
+
+/**
+ * iseq_inline_cache_entry::ic_serial. Helpers refill the cache on a miss.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyICSerialSymRef()
+   {
+   if (!_rubyICSerialSymRef)
+      _rubyICSerialSymRef = createRubyNamedShadowSymRef("ic->ic_serial",
+                                                        TR_RubyFE::slotType(),
+                                                        TR_RubyFE::SLOTSIZE,
+                                                        offsetof(struct iseq_inline_cache_entry, ic_serial),
+                                                        true,
+                                                        HelperEffectsGlobal);
+   return _rubyICSerialSymRef;
+   }
+
+
+/**
+ * iseq_inline_cache_entry::ic_value. Covers both the value and index members
+ * of the union.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyICValueSymRef()
+   {
+   if (!_rubyICValueSymRef)
+      _rubyICValueSymRef = createRubyNamedShadowSymRef("ic->ic_value",
+                                                       TR_RubyFE::slotType(),
+                                                       TR_RubyFE::SLOTSIZE,
+                                                       offsetof(struct iseq_inline_cache_entry, ic_value.value),
+                                                       true,
+                                                       HelperEffectsGlobal);
+   return _rubyICValueSymRef;
+   }
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyGlobalConstantStateSymRef()
+   {
+   auto *globals = &static_cast<TR_RubyFE*>(comp()->fe())->getJitInterface()->globals;
+   static_assert(sizeof(*globals->ruby_vm_global_constant_state_ptr) == TR_RubyFE::SLOTSIZE,
+                 "vm_global_constant_state wrong size");
+   if (!_rubyGlobalConstantStateSymRef)
+      _rubyGlobalConstantStateSymRef = createRubyNamedStaticSymRef("ruby_vm_global_constant_state",
+                                                                   TR_RubyFE::slotType(),
+                                                                   globals->ruby_vm_global_constant_state_ptr,
+                                                                   0,
+                                                                   true,
+                                                                   HelperEffectsGlobal);
+   return _rubyGlobalConstantStateSymRef;
+   }
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyGlobalMethodStateSymRef()
+   {
+   auto *globals = &static_cast<TR_RubyFE*>(comp()->fe())->getJitInterface()->globals;
+   static_assert(sizeof(*globals->ruby_vm_global_method_state_ptr) == TR_RubyFE::SLOTSIZE,
+                 "vm_global_method_state wrong size");
+   if (!_rubyGlobalMethodStateSymRef)
+      _rubyGlobalMethodStateSymRef = createRubyNamedStaticSymRef("ruby_vm_global_method_state",
+                                                                 TR_RubyFE::slotType(),
+                                                                 globals->ruby_vm_global_method_state_ptr,
+                                                                 0,
+                                                                 true,
+                                                                 HelperEffectsGlobal);
+   return _rubyGlobalMethodStateSymRef;
+   }
+
+
+/**
+ * rb_iseq_t::jit.body_info. The body is installed by the VM when a
+ * compilation finishes, which can happen under any call.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyISeqJitBodyInfoSymRef()
+   {
+   if (!_rubyISeqJitBodyInfoSymRef)
+      _rubyISeqJitBodyInfoSymRef = createRubyNamedShadowSymRef("iseq->jit.body_info",
+                                                               TR::Address,
+                                                               TR_RubyFE::SLOTSIZE,
+                                                               offsetof(rb_iseq_t, jit.body_info),
+                                                               true,
+                                                               HelperEffectsGlobal);
+   return _rubyISeqJitBodyInfoSymRef;
+   }
+
+
+/**
+ * iseq_jit_body_info::startPC. A body_info is never changed once installed.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyJitStartPCSymRef()
+   {
+   if (!_rubyJitStartPCSymRef)
+      _rubyJitStartPCSymRef = createRubyNamedShadowSymRef("body_info->startPC",
+                                                          TR::Address,
+                                                          TR_RubyFE::SLOTSIZE,
+                                                          offsetof(iseq_jit_body_info, startPC),
+                                                          false,
+                                                          HelperEffectsGlobal);
+   return _rubyJitStartPCSymRef;
+   }
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyStructHeapPtrSymRef()
+   {
+   if (!_rubyStructHeapPtrSymRef)
+      _rubyStructHeapPtrSymRef = createRubyNamedShadowSymRef("RStruct->as.heap.ptr",
+                                                             TR::Address,
+                                                             TR_RubyFE::SLOTSIZE,
+                                                             offsetof(struct RStruct, as.heap.ptr),
+                                                             true,
+                                                             HelperEffectsObjects);
+   return _rubyStructHeapPtrSymRef;
+   }
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyArrayLenSymRef()
+   {
+   if (!_rubyArrayLenSymRef)
+      _rubyArrayLenSymRef = createRubyNamedShadowSymRef("RArray->as.heap.len",
+                                                        TR_RubyFE::slotType(),
+                                                        TR_RubyFE::SLOTSIZE,
+                                                        offsetof(struct RArray, as.heap.len),
+                                                        true,
+                                                        HelperEffectsObjects);
+   return _rubyArrayLenSymRef;
+   }
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyArrayPtrSymRef()
+   {
+   if (!_rubyArrayPtrSymRef)
+      _rubyArrayPtrSymRef = createRubyNamedShadowSymRef("RArray->as.heap.ptr",
+                                                        TR::Address,
+                                                        TR_RubyFE::SLOTSIZE,
+                                                        offsetof(struct RArray, as.heap.ptr),
+                                                        true,
+                                                        HelperEffectsObjects);
+   return _rubyArrayPtrSymRef;
+   }
+
+
+/**
+ * rb_control_frame_t::sp. Shared by the IL generated for every method of the
+ * compilation, as the body of a callee inlined without a frame continues the
+ * stack of its caller's frame.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyFrameSPSymRef()
+   {
+   if (!_rubyFrameSPSymRef)
+      _rubyFrameSPSymRef = createRubyNamedShadowSymRef("sp",
+                                                       TR::Address,
+                                                       TR_RubyFE::SLOTSIZE,
+                                                       offsetof(rb_control_frame_t, sp),
+                                                       true,
+                                                       HelperEffectsFrame);
+   return _rubyFrameSPSymRef;
+   }
+
+
+/**
+ * The slot of an environment linking it to the enclosing one, as
+ * GET_PREV_EP reads it: the previous EP with its low bits tagged.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::findOrCreateRubyPrevEPSymRef()
+   {
+   if (!_rubyPrevEPSymRef)
+      _rubyPrevEPSymRef = createRubyNamedShadowSymRef("prev_ep",
+                                                      TR_RubyFE::slotType(),
+                                                      TR_RubyFE::SLOTSIZE,
+                                                      0,
+                                                      true,
+                                                      HelperEffectsFrame);
+   return _rubyPrevEPSymRef;
+   }
+
+
+/**
+ * A new shadow for a slot of the YARV stack, at `offset` from the private SP
+ * of the method it belongs to. Each method, inlined or not, has its own.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::createRubyStackSlotSymRef(int32_t offset)
+   {
+   TR::SymbolReference *symRef = createRubyNamedShadowSymRef("stackSlot",
+                                                             TR_RubyFE::slotType(),
+                                                             TR_RubyFE::SLOTSIZE,
+                                                             offset,
+                                                             true,
+                                                             HelperEffectsFrame);
+   _rubyStackSlotSymRefsBV.set(symRef->getReferenceNumber());
+   return symRef;
+   }
+
+
+bool
+Ruby::SymbolReferenceTable::isRubyStackSlotSymRef(TR::SymbolReference *symRef)
+   {
+   return _rubyStackSlotSymRefsBV.isSet(symRef->getReferenceNumber());
+   }
+
+
+/**
+ * A new shadow for the pc of a control frame. Each method, inlined or not,
+ * has its own.
+ */
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::createRubyPCSymRef()
+   {
+   TR::SymbolReference *symRef = createRubyNamedShadowSymRef("pc",
+                                                             TR::Address,
+                                                             TR_RubyFE::SLOTSIZE,
+                                                             offsetof(rb_control_frame_t, pc),
+                                                             true,
+                                                             HelperEffectsFrame);
+   _rubyPCSymRefsBV.set(symRef->getReferenceNumber());
+   return symRef;
+   }
+
+
+bool
+Ruby::SymbolReferenceTable::isRubyPCSymRef(TR::SymbolReference *symRef)
+   {
+   return _rubyPCSymRefsBV.isSet(symRef->getReferenceNumber());
+   }
+
+
 TR::SymbolReference *
 Ruby::SymbolReferenceTable::setRubyInlinedReceiverTempSymRef(TR_CallSite* callSite, TR::SymbolReference* receiverTempSymRef)
 {
@@ -236,3 +724,138 @@ Ruby::SymbolReferenceTable::getRubyInlinedReceiverTempSymRef(TR_CallSite* callSi
       return NULL;
     }
 }
+
+
+void
+Ruby::SymbolReferenceTable::setRubySendArgumentTempSymRefs(TR::Node* callNode, TR::SymbolReference** argumentTempSymRefs)
+{
+  _ruby_send_argument_temp_SymRefs.Add(callNode, argumentTempSymRefs);
+}
+
+
+TR::SymbolReference **
+Ruby::SymbolReferenceTable::getRubySendArgumentTempSymRefs(TR::Node* callNode)
+{
+  if(_ruby_send_argument_temp_SymRefs.Locate(callNode))
+    {
+      return _ruby_send_argument_temp_SymRefs.Get(callNode);
+    }
+  else
+    {
+      return NULL;
+    }
+}
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::getRubySendArgumentTempSymRef(TR::Node* callNode, int32_t argIndex)
+{
+  TR::SymbolReference **argumentTempSymRefs = getRubySendArgumentTempSymRefs(callNode);
+  return argumentTempSymRefs ? argumentTempSymRefs[argIndex] : NULL;
+}
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::setRubySendReceiverTempSymRef(TR::Node* callNode, TR::SymbolReference* receiverTempSymRef)
+{
+  _ruby_send_receiver_temp_SymRef.Add(callNode, receiverTempSymRef);
+  return receiverTempSymRef;
+}
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::getRubySendReceiverTempSymRef(TR::Node* callNode)
+{
+  if(_ruby_send_receiver_temp_SymRef.Locate(callNode))
+    {
+      return _ruby_send_receiver_temp_SymRef.Get(callNode);
+    }
+  else
+    {
+      return NULL;
+    }
+}
+
+
+void
+Ruby::SymbolReferenceTable::setRubyInlinedBlockISeq(TR_ResolvedMethod* callee, struct rb_iseq_struct* blockiseq)
+{
+  _ruby_inlined_block_iseq.Add(callee, blockiseq);
+}
+
+
+struct rb_iseq_struct *
+Ruby::SymbolReferenceTable::getRubyInlinedBlockISeq(TR_ResolvedMethod* callee)
+{
+  if(_ruby_inlined_block_iseq.Locate(callee))
+    {
+      return _ruby_inlined_block_iseq.Get(callee);
+    }
+  else
+    {
+      return NULL;
+    }
+}
+
+
+void
+Ruby::SymbolReferenceTable::setRubyVirtualFrame(TR_ResolvedMethod* callee, TR_RubyVirtualFrame* frame)
+{
+  _ruby_virtual_frame.Add(callee, frame);
+}
+
+
+TR_RubyVirtualFrame *
+Ruby::SymbolReferenceTable::getRubyVirtualFrame(TR_ResolvedMethod* callee)
+{
+  if(_ruby_virtual_frame.Locate(callee))
+    {
+      return _ruby_virtual_frame.Get(callee);
+    }
+  else
+    {
+      return NULL;
+    }
+}
+
+
+void
+Ruby::SymbolReferenceTable::setRubySendSymbolBlockCallInfo(TR::Node* callNode, struct rb_call_info_struct* symbolCallInfo)
+{
+  _ruby_send_symbol_block_ci.Add(callNode, symbolCallInfo);
+}
+
+
+struct rb_call_info_struct *
+Ruby::SymbolReferenceTable::getRubySendSymbolBlockCallInfo(TR::Node* callNode)
+{
+  if(_ruby_send_symbol_block_ci.Locate(callNode))
+    {
+      return _ruby_send_symbol_block_ci.Get(callNode);
+    }
+  else
+    {
+      return NULL;
+    }
+}
+
+
+void
+Ruby::SymbolReferenceTable::setRubySendStackArgumentsSymRef(TR::Node* callNode, TR::SymbolReference* stackSlotSymRef)
+{
+  _ruby_send_stack_arguments_SymRef.Add(callNode, stackSlotSymRef);
+}
+
+
+TR::SymbolReference *
+Ruby::SymbolReferenceTable::getRubySendStackArgumentsSymRef(TR::Node* callNode)
+{
+  if(_ruby_send_stack_arguments_SymRef.Locate(callNode))
+    {
+      return _ruby_send_stack_arguments_SymRef.Get(callNode);
+    }
+  else
+    {
+      return NULL;
+    }
+}
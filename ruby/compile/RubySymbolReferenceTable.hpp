@@ -30,12 +30,139 @@ namespace Ruby { typedef Ruby::SymbolReferenceTable SymbolReferenceTableConnecto
 
 
 #include "compile/OMRSymbolReferenceTable.hpp"
+#include "env/TRMemory.hpp"
 #include "infra/BitVector.hpp"
 #include "cs2/hashtab.h"                       // for HashTable, etc
 
 namespace TR { class Compilation; }
 namespace OMR { class SymbolReference; }
 class TR_CallSite;
+class TR_ResolvedMethod;
+struct rb_iseq_struct;
+struct rb_method_entry_struct;
+struct rb_call_info_struct;
+
+
+/**
+ * The frame of a callee inlined without pushing a control frame. Its self,
+ * arguments and locals live in temporaries; a control frame is materialized
+ * from this description only around the calls of its body that may observe
+ * one. See Ruby::LowerMacroOps::materializeVirtualFrame.
+ */
+struct TR_RubyVirtualFrame
+   {
+   TR_ALLOC(TR_Memory::Inliner)
+
+   TR_RubyVirtualFrame(struct rb_method_entry_struct *me,
+                       uintptr_t definedClass,
+                       struct rb_iseq_struct *iseq,
+                       TR::SymbolReference *receiverTemp,
+                       TR::SymbolReference **argumentTemps)
+      : _me(me),
+        _definedClass(definedClass),
+        _iseq(iseq),
+        _receiverTemp(receiverTemp),
+        _argumentTemps(argumentTemps),
+        _localTemps(0),
+        _numLocals(0),
+        _classTemp(0),
+        _instanceClass(0),
+        _classSerial(0),
+        _methodState(0)
+      {}
+
+   struct rb_method_entry_struct *_me;
+   uintptr_t                      _definedClass;
+   struct rb_iseq_struct         *_iseq;
+   TR::SymbolReference           *_receiverTemp;
+   TR::SymbolReference          **_argumentTemps;  ///< In parameter order.
+
+   // Filled in by the IL generator: one temporary per entry of the local
+   // table, in local table order.
+   TR::SymbolReference          **_localTemps;
+   int32_t                        _numLocals;
+
+   // Set for the initialize of an inlined Class#new: self is allocated from
+   // the class in _classTemp, and the frame evaluates to self. The body runs
+   // only while the class serial and method state still match those it was
+   // compiled for; initialize is sent normally otherwise.
+   TR::SymbolReference           *_classTemp;
+   uintptr_t                      _instanceClass;
+   uintptr_t                      _classSerial;
+   uintptr_t                      _methodState;
+   };
+
+/**
+ * Locals of the method being compiled that live in temporaries rather than
+ * in its environment, as nothing but the method and its own literal blocks
+ * can see them. They are loaded from the EP on entry, and written back only
+ * where the VM may read the environment. See
+ * Ruby::LowerMacroOps::writeBackPromotedLocals.
+ */
+struct TR_RubyPromotedLocals
+   {
+   TR_ALLOC(TR_Memory::IlGenerator)
+
+   TR_RubyPromotedLocals(struct rb_iseq_struct *iseq,
+                         TR::SymbolReference *epTemp,
+                         TR::SymbolReference **localTemps,
+                         TR::SymbolReference **localShadows,
+                         int32_t numLocals)
+      : _iseq(iseq),
+        _epTemp(epTemp),
+        _localTemps(localTemps),
+        _localShadows(localShadows),
+        _numLocals(numLocals),
+        _cfpTemp(0),
+        _epShadow(0)
+      {}
+
+   struct rb_iseq_struct         *_iseq;
+   TR::SymbolReference           *_epTemp;        ///< The EP only moves to the heap for blocks.
+   TR::SymbolReference          **_localTemps;    ///< In local table order.
+   TR::SymbolReference          **_localShadows;  ///< The EP slot of each local.
+   int32_t                        _numLocals;
+
+   // Set if the method passes literal blocks: the environment is then
+   // written back around every call, and the EP reloaded through the CFP
+   // after it, as the call may have moved the environment to the heap.
+   TR::SymbolReference           *_cfpTemp;
+   TR::SymbolReference           *_epShadow;
+   };
+
+/**
+ * The VM registers of the method or block being compiled, loaded into
+ * temporaries on entry rather than off th->cfp at every instruction. The CFP
+ * and self are fixed for the life of the frame, and the JIT only writes the
+ * CFP back when popping the frame on return. The EPs, of the frame and those
+ * enclosing it, are recomputed after calls that may move the environments to
+ * the heap; see Ruby::LowerMacroOps::refreshFrameEPs.
+ */
+struct TR_RubyFrameRegisters
+   {
+   TR_ALLOC(TR_Memory::IlGenerator)
+
+   TR_RubyFrameRegisters(TR::SymbolReference *cfpTemp,
+                         TR::SymbolReference *cfpShadow,
+                         TR::SymbolReference *selfTemp,
+                         TR::SymbolReference *epShadow,
+                         TR::SymbolReference **epTemps,
+                         int32_t maxLevel)
+      : _cfpTemp(cfpTemp),
+        _cfpShadow(cfpShadow),
+        _selfTemp(selfTemp),
+        _epShadow(epShadow),
+        _epTemps(epTemps),
+        _maxLevel(maxLevel)
+      {}
+
+   TR::SymbolReference           *_cfpTemp;   ///< NULL if the CFP is loaded off the thread.
+   TR::SymbolReference           *_cfpShadow; ///< th->cfp
+   TR::SymbolReference           *_selfTemp;  ///< NULL if self is loaded off the CFP.
+   TR::SymbolReference           *_epShadow;  ///< cfp->ep
+   TR::SymbolReference          **_epTemps;   ///< Indexed by level; NULL at 0 if the EP is loaded off the CFP.
+   int32_t                        _maxLevel;
+   };
 
 
 namespace Ruby
@@ -45,14 +172,34 @@ class SymbolReferenceTable : public OMR::SymbolReferenceTableConnector
    {
    public:
 
+   /**
+    * The VM state a helper may read or write, and which of it a shadow or
+    * static killed across calls belongs to. A shadow is aliased only with
+    * the helpers that may touch its part of the state.
+    */
+   enum HelperEffects
+      {
+      HelperEffectsNone    = 0,
+      HelperEffectsFrame   = 1 << 0, ///< Control frame fields, environments and the YARV stack.
+      HelperEffectsObjects = 1 << 1, ///< Object headers, ivars, array and struct contents.
+      HelperEffectsGlobal  = 1 << 2, ///< Classes, inline caches, VM-wide state and flags.
+      HelperEffectsAll     = HelperEffectsFrame | HelperEffectsObjects | HelperEffectsGlobal
+      };
+
+   static uint32_t getRubyHelperEffects(TR_RuntimeHelper helper);
+
    SymbolReferenceTable(size_t size, TR::Compilation *comp);
 
    TR::SymbolReference * findOrCreateRubyThreadSymbolRef(TR::ResolvedMethodSymbol*);
 
    void initializeRubyHelperSymbolRefs(uint32_t maxIndex);
    TR::SymbolReference * findOrCreateRubyHelperSymbolRef(TR_RuntimeHelper helper, bool canGCandReturn, bool canGCandExcept, bool preservesAllRegisters);
-   TR::SymbolReference * createRubyNamedShadowSymRef(char* name, TR::DataTypes dt, size_t size, int32_t offset, bool killedAcrossCalls);
-   TR::SymbolReference * createRubyNamedStaticSymRef(char* name, TR::DataTypes dt, void* addr,  int32_t offset, bool killedAcrossCalls);
+   bool isRubyHelperSymRef(TR::SymbolReference *symRef) { return _rubyHelperSymRefsBV.isSet(symRef->getReferenceNumber()); }
+   TR::SymbolReference * createRubyNamedShadowSymRef(char* name, TR::DataTypes dt, size_t size, int32_t offset, bool killedAcrossCalls,
+                                                     uint32_t effects = HelperEffectsAll);
+   TR::SymbolReference * createRubyNamedStaticSymRef(char* name, TR::DataTypes dt, void* addr,  int32_t offset, bool killedAcrossCalls,
+                                                     uint32_t effects = HelperEffectsAll);
+   TR::SymbolReference * createRubyStateTemporary(TR::ResolvedMethodSymbol *owningMethodSymbol, TR::DataTypes dt, uint32_t effects);
 
    void initializeRubyRedefinedFlagSymbolRefs(uint32_t maxIndex);
    TR::SymbolReference * findRubyRedefinedFlagSymbolRef(int32_t bop);
@@ -63,20 +210,92 @@ class SymbolReferenceTable : public OMR::SymbolReferenceTableConnector
    TR::SymbolReference * findOrCreateRubyInterruptFlagSymRef();
    TR::SymbolReference * findOrCreateRubyInterruptMaskSymRef();
 
+   // Object model SymbolRefs, used by fast paths that look inside objects.
+   TR::SymbolReference * findOrCreateRubyBasicFlagsSymRef();
+   TR::SymbolReference * findOrCreateRubyBasicKlassSymRef();
+   TR::SymbolReference * findOrCreateRubyClassExtSymRef();
+   TR::SymbolReference * findOrCreateRubyClassSerialSymRef();
+   TR::SymbolReference * findOrCreateRubyObjectNumIVSymRef();
+   TR::SymbolReference * findOrCreateRubyObjectIVPtrSymRef();
+   TR::SymbolReference * findOrCreateRubyObjectSlotSymRef();
+   TR::SymbolReference * findOrCreateRubyICSerialSymRef();
+   TR::SymbolReference * findOrCreateRubyICValueSymRef();
+   TR::SymbolReference * findOrCreateRubyGlobalConstantStateSymRef();
+   TR::SymbolReference * findOrCreateRubyGlobalMethodStateSymRef();
+   TR::SymbolReference * findOrCreateRubyISeqJitBodyInfoSymRef();
+   TR::SymbolReference * findOrCreateRubyJitStartPCSymRef();
+   TR::SymbolReference * findOrCreateRubyStructHeapPtrSymRef();
+   TR::SymbolReference * findOrCreateRubyArrayLenSymRef();
+   TR::SymbolReference * findOrCreateRubyArrayPtrSymRef();
+   TR::SymbolReference * findOrCreateRubyFrameSPSymRef();
+   TR::SymbolReference * findOrCreateRubyPrevEPSymRef();
+
+   // Slots of the YARV stack, relative to the private SP of a method.
+   TR::SymbolReference * createRubyStackSlotSymRef(int32_t offset);
+   bool isRubyStackSlotSymRef(TR::SymbolReference *symRef);
+
+   // The pc of the control frame of a method.
+   TR::SymbolReference * createRubyPCSymRef();
+   bool isRubyPCSymRef(TR::SymbolReference *symRef);
+
    //Inlining
    TR::SymbolReference *setRubyInlinedReceiverTempSymRef(TR_CallSite* callSite, TR::SymbolReference* receiverTempSymRef);
    TR::SymbolReference *getRubyInlinedReceiverTempSymRef(TR_CallSite* callSite);
 
+   //Arguments of sends without a block, in parameter order, for fast paths
+   //and inlined bodies that replace the send.
+   void setRubySendArgumentTempSymRefs(TR::Node* callNode, TR::SymbolReference** argumentTempSymRefs);
+   TR::SymbolReference **getRubySendArgumentTempSymRefs(TR::Node* callNode);
+   TR::SymbolReference *getRubySendArgumentTempSymRef(TR::Node* callNode, int32_t argIndex = 0);
+
+   //Receiver of sends passing a literal block, for inlining them.
+   TR::SymbolReference *setRubySendReceiverTempSymRef(TR::Node* callNode, TR::SymbolReference* receiverTempSymRef);
+   TR::SymbolReference *getRubySendReceiverTempSymRef(TR::Node* callNode);
+
+   //Literal block passed to an inlined callee, for inlining its yields.
+   void setRubyInlinedBlockISeq(TR_ResolvedMethod* callee, struct rb_iseq_struct* blockiseq);
+   struct rb_iseq_struct *getRubyInlinedBlockISeq(TR_ResolvedMethod* callee);
+
+   //Callees inlined without pushing a control frame.
+   void setRubyVirtualFrame(TR_ResolvedMethod* callee, TR_RubyVirtualFrame* frame);
+   TR_RubyVirtualFrame *getRubyVirtualFrame(TR_ResolvedMethod* callee);
+
+   //Locals of the method being compiled kept in temporaries.
+   void setRubyPromotedLocals(TR_RubyPromotedLocals* locals) { _rubyPromotedLocals = locals; }
+   TR_RubyPromotedLocals *getRubyPromotedLocals() { return _rubyPromotedLocals; }
+
+   //VM registers of the method or block being compiled kept in temporaries.
+   void setRubyFrameRegisters(TR_RubyFrameRegisters* registers) { _rubyFrameRegisters = registers; }
+   TR_RubyFrameRegisters *getRubyFrameRegisters() { return _rubyFrameRegisters; }
+
+   //Call info for the direct send replacing a literal &:symbol block.
+   void setRubySendSymbolBlockCallInfo(TR::Node* callNode, struct rb_call_info_struct* symbolCallInfo);
+   struct rb_call_info_struct *getRubySendSymbolBlockCallInfo(TR::Node* callNode);
+
+   //Lowest YARV stack slot a send reads its receiver and arguments from.
+   void setRubySendStackArgumentsSymRef(TR::Node* callNode, TR::SymbolReference* stackSlotSymRef);
+   TR::SymbolReference *getRubySendStackArgumentsSymRef(TR::Node* callNode);
+
    private:
 
    // Ruby support
    TR::SymbolReference           *_ruby_vm_event_flags_SymRef;
    List<TR::SymbolReference>      _ruby_threadSymRefs;
 
+   TR_BitVector &getRubyHelperSymRefsWithEffects(uint32_t effects);
+
    //Helper SymbolRefs and associated BitVector
    TR::SymbolReference **         _rubyHelperSymRefs;
    TR_BitVector                    _rubyHelperSymRefsBV;
 
+   //Helpers by the state they may touch, see getRubyHelperEffects.
+   TR_BitVector                    _rubyFrameHelperSymRefsBV;
+   TR_BitVector                    _rubyObjectsHelperSymRefsBV;
+   TR_BitVector                    _rubyGlobalHelperSymRefsBV;
+
+   TR_BitVector                    _rubyStackSlotSymRefsBV;
+   TR_BitVector                    _rubyPCSymRefsBV;
+
    //Redefined Flag SymbolRefs
    TR::SymbolReference **         _rubyRedefinedFlagSymRefs;
 
@@ -84,8 +303,37 @@ class SymbolReferenceTable : public OMR::SymbolReferenceTableConnector
    TR::SymbolReference *          _rubyInterrupt_flag_SymRef;
    TR::SymbolReference *          _rubyInterrupt_mask_SymRef;
 
+   // Object model SymbolRefs.
+   TR::SymbolReference *          _rubyBasicFlagsSymRef;
+   TR::SymbolReference *          _rubyBasicKlassSymRef;
+   TR::SymbolReference *          _rubyClassExtSymRef;
+   TR::SymbolReference *          _rubyClassSerialSymRef;
+   TR::SymbolReference *          _rubyObjectNumIVSymRef;
+   TR::SymbolReference *          _rubyObjectIVPtrSymRef;
+   TR::SymbolReference *          _rubyObjectSlotSymRef;
+   TR::SymbolReference *          _rubyICSerialSymRef;
+   TR::SymbolReference *          _rubyICValueSymRef;
+   TR::SymbolReference *          _rubyGlobalConstantStateSymRef;
+   TR::SymbolReference *          _rubyGlobalMethodStateSymRef;
+   TR::SymbolReference *          _rubyISeqJitBodyInfoSymRef;
+   TR::SymbolReference *          _rubyJitStartPCSymRef;
+   TR::SymbolReference *          _rubyStructHeapPtrSymRef;
+   TR::SymbolReference *          _rubyArrayLenSymRef;
+   TR::SymbolReference *          _rubyArrayPtrSymRef;
+   TR::SymbolReference *          _rubyFrameSPSymRef;
+   TR::SymbolReference *          _rubyPrevEPSymRef;
+
+   TR_RubyPromotedLocals *        _rubyPromotedLocals;
+   TR_RubyFrameRegisters *        _rubyFrameRegisters;
+
    //Inlining
    CS2::HashTable<TR_CallSite*, TR::SymbolReference*, TR::Allocator> _ruby_inlined_receiver_temp_SymRef;
+   CS2::HashTable<TR::Node*, TR::SymbolReference**, TR::Allocator>   _ruby_send_argument_temp_SymRefs;
+   CS2::HashTable<TR::Node*, TR::SymbolReference*, TR::Allocator>    _ruby_send_receiver_temp_SymRef;
+   CS2::HashTable<TR_ResolvedMethod*, struct rb_iseq_struct*, TR::Allocator> _ruby_inlined_block_iseq;
+   CS2::HashTable<TR_ResolvedMethod*, TR_RubyVirtualFrame*, TR::Allocator>   _ruby_virtual_frame;
+   CS2::HashTable<TR::Node*, struct rb_call_info_struct*, TR::Allocator>     _ruby_send_symbol_block_ci;
+   CS2::HashTable<TR::Node*, TR::SymbolReference*, TR::Allocator>            _ruby_send_stack_arguments_SymRef;
 
    };
 
@@ -31,6 +31,8 @@
 extern void setupCodeCacheParameters(int32_t *, OMR::CodeCacheCodeGenCallbacks *callBacks, int32_t *numHelpers, int32_t *CCPreLoadedCodeSize);
 typedef VALUE (*jit_method_t)(rb_thread_t*);
 
+extern "C" VALUE jit_dispatch(rb_thread_t *th, jit_method_t code);
+
 #ifdef TR_HOST_POWER
 extern "C" VALUE compiledCodeDispatch(rb_thread_t *th, jit_method_t code, void *pseudoTOC);
 #endif
@@ -67,6 +69,12 @@ initializeAllHelpers(struct rb_vm_struct *vm, TR_RubyJitConfig *jitConfig)
    initHelper(lep_svar_set);
    initHelper(vm_getivar);
    initHelper(vm_setivar);
+   initHelper(rb_gc_writebarrier);
+   initHelper(rb_ary_push);
+   initHelper(rb_ary_new_capa);
+   initHelper(rb_hash_has_key);
+   initHelper(rb_hash_lookup2);
+   initHelper(rb_str_equal);
    initHelper(vm_opt_plus);
    initHelper(vm_opt_minus);
    initHelper(vm_opt_mult);
@@ -130,6 +138,10 @@ initializeAllHelpers(struct rb_vm_struct *vm, TR_RubyJitConfig *jitConfig)
    initHelper(rb_method_entry);
    initHelper(rb_class_of);
    initHelper(vm_send_woblock_jit_inline_frame);
+   initHelper(vm_send_jit_inline_frame);
+   initHelper(vm_invokeblock_jit_inline_frame);
+   initHelper(vm_yield_literal_block);
+   initHelper(vm_yield_literal_block_jit_inline_frame);
    initHelper(vm_send_woblock_inlineable_guard);
    initHelper(rb_bug);
    initHelper(vm_exec_core);
@@ -139,6 +151,15 @@ initializeAllHelpers(struct rb_vm_struct *vm, TR_RubyJitConfig *jitConfig)
    initHelper(rb_class2name);
    initHelper(vm_opt_aref_with);
    initHelper(vm_opt_aset_with);
+   initHelper(vm_jit_materialize_frame);
+   initHelper(vm_jit_dematerialize_frame);
+   initHelper(rb_obj_alloc);
+   initHelper(vm_send_symbol_without_block);
+   initHelper(vm_call_symbol_block);
+
+   // Not a VM callback: compiled code uses it to call directly into the
+   // body of another compiled method.
+   runtimeHelpers.setAddress(RubyHelper_jit_dispatch, helperAddress((void*)jit_dispatch));
    }
 
 static void
@@ -337,6 +358,14 @@ void *jit_compile(rb_iseq_t *iseq)
       return NULL;
       }
 
+   // A method the VM asks to compile again is among the hottest. The hot
+   // strategy is still experimental, and only used when asked for.
+   static const char *enableHotStrategy = feGetEnv("OMR_RUBY_ENABLE_HOT_STRATEGY");
+   if (enableHotStrategy
+       && TR::Options::getCmdLineOptions()->getOption(TR_EnableRubyTieredCompilation)
+       && iseq->jit.body_info)
+      optLevel = hot;
+
    auto &fe = TR_RubyFE::singleton();
 
    if ((iseq->param.flags.has_opt
@@ -60,6 +60,54 @@ Ruby::Node::xxor(TR::Node *a, TR::Node *b)
    return TR::Node::create(TR_RubyFE::SLOTSIZE == 8 ? TR::lxor : TR::ixor, 2, a, b);
    }
 
+TR::Node *
+Ruby::Node::xior(TR::Node *a, TR::Node *b)
+   {
+   return TR::Node::create(TR_RubyFE::SLOTSIZE == 8 ? TR::lor : TR::ior, 2, a, b);
+   }
+
+TR::Node *
+Ruby::Node::xmul(TR::Node *a, TR::Node *b)
+   {
+   return TR::Node::create(TR_RubyFE::SLOTSIZE == 8 ? TR::lmul : TR::imul, 2, a, b);
+   }
+
+TR::Node *
+Ruby::Node::xshl(TR::Node *a, TR::Node *count)
+   {
+   return TR::Node::create(TR_RubyFE::SLOTSIZE == 8 ? TR::lshl : TR::ishl, 2, a, count);
+   }
+
+TR::Node *
+Ruby::Node::xshr(TR::Node *a, TR::Node *count)
+   {
+   return TR::Node::create(TR_RubyFE::SLOTSIZE == 8 ? TR::lshr : TR::ishr, 2, a, count);
+   }
+
+TR::Node *
+Ruby::Node::x2a(TR::Node *a)
+   {
+   return TR::Node::create(TR_RubyFE::SLOTSIZE == 8 ? TR::l2a : TR::i2a, 1, a);
+   }
+
+TR::Node *
+Ruby::Node::a2x(TR::Node *a)
+   {
+   return TR::Node::create(TR_RubyFE::SLOTSIZE == 8 ? TR::a2l : TR::a2i, 1, a);
+   }
+
+TR::Node *
+Ruby::Node::i2x(TR::Node *a)
+   {
+   return TR_RubyFE::SLOTSIZE == 8 ? TR::Node::create(TR::i2l, 1, a) : a;
+   }
+
+TR::Node *
+Ruby::Node::x2i(TR::Node *a)
+   {
+   return TR_RubyFE::SLOTSIZE == 8 ? TR::Node::create(TR::l2i, 1, a) : a;
+   }
+
 TR::Node *
 Ruby::Node::xnot(TR::Node *a)
    {
@@ -78,6 +126,30 @@ Ruby::Node::ifxcmpeq(TR::Node *a, TR::Node *b)
    return TR::Node::createif(TR::Node::ifxcmpeqOp(), a, b);
    }
 
+TR::Node *
+Ruby::Node::ifxcmpge(TR::Node *a, TR::Node *b)
+   {
+   return TR::Node::createif(TR_RubyFE::SLOTSIZE == 8 ? TR::iflcmpge : TR::ificmpge, a, b);
+   }
+
+TR::Node *
+Ruby::Node::ifxucmpge(TR::Node *a, TR::Node *b)
+   {
+   return TR::Node::createif(TR_RubyFE::SLOTSIZE == 8 ? TR::iflucmpge : TR::ifiucmpge, a, b);
+   }
+
+TR::Node *
+Ruby::Node::xcmpeq(TR::Node *a, TR::Node *b)
+   {
+   return TR::Node::create(TR::Node::xcmpeqOp(), 2, a, b);
+   }
+
+TR::Node *
+Ruby::Node::xcmpne(TR::Node *a, TR::Node *b)
+   {
+   return TR::Node::create(TR_RubyFE::SLOTSIZE == 8 ? TR::lcmpne : TR::icmpne, 2, a, b);
+   }
+
 TR::Node *
 Ruby::Node::xcmpge(TR::Node *a, TR::Node *b)
    {
@@ -87,7 +159,7 @@ Ruby::Node::xcmpge(TR::Node *a, TR::Node *b)
 TR::Node *
 Ruby::Node::xternary(TR::Node *cmp, TR::Node *t, TR::Node *f)
    {
-   return TR::Node::create(TR_RubyFE::SLOTSIZE == 8 ? TR::lternary : TR::iternary, 3, cmp, t, f);
+   return TR::Node::create(TR::Node::xternaryOp(), 3, cmp, t, f);
    }
 
 TR::Node *
@@ -74,8 +74,17 @@ public:
    static TR::Node *xsub(TR::Node *a, TR::Node *b);
    static TR::Node *xand(TR::Node *a, TR::Node *b);
    static TR::Node *xxor(TR::Node *a, TR::Node *b);
+   static TR::Node *xior(TR::Node *a, TR::Node *b);
+   static TR::Node *xmul(TR::Node *a, TR::Node *b);
+   static TR::Node *xshl(TR::Node *a, TR::Node *count);
+   static TR::Node *xshr(TR::Node *a, TR::Node *count);
    static TR::Node *xnot(TR::Node *a);
 
+   static TR::Node *x2a(TR::Node *a);
+   static TR::Node *a2x(TR::Node *a);
+   static TR::Node *i2x(TR::Node *a);
+   static TR::Node *x2i(TR::Node *a);
+
    static TR::ILOpCodes ifxcmpneOp()
       { return TR_RubyFE::SLOTSIZE == 8 ? TR::iflcmpne : TR::ificmpne; }
    static TR::ILOpCodes ifxcmpeqOp()
@@ -83,7 +92,16 @@ public:
 
    static TR::Node *ifxcmpne(TR::Node *a, TR::Node *b);
    static TR::Node *ifxcmpeq(TR::Node *a, TR::Node *b);
+   static TR::Node *ifxcmpge(TR::Node *a, TR::Node *b);
+   static TR::Node *ifxucmpge(TR::Node *a, TR::Node *b);
+
+   static TR::ILOpCodes xcmpeqOp()
+      { return TR_RubyFE::SLOTSIZE == 8 ? TR::lcmpeq : TR::icmpeq; }
+   static TR::ILOpCodes xternaryOp()
+      { return TR_RubyFE::SLOTSIZE == 8 ? TR::lternary : TR::iternary; }
 
+   static TR::Node *xcmpeq(TR::Node *a, TR::Node *b);
+   static TR::Node *xcmpne(TR::Node *a, TR::Node *b);
    static TR::Node *xcmpge(TR::Node *a, TR::Node *b);
    static TR::Node *xternary(TR::Node *cmp, TR::Node *t, TR::Node *f);
 
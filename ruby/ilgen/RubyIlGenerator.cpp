@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <map>
 #include <set>
+#include <string.h>
 #include "vm_insnhelper.h" // For BOP_MINUS and FIXNUM_REDEFINED_OP_FLAG etc.
 #include "vm_core.h"       // For VM_SPECIAL_OBJECT_CBASE and VM_SPECIAL_OBJECT_CONST_BASE, etc.
 #include "iseq.h"          // For catch table defs.
@@ -36,6 +37,7 @@
 #include "ilgen/IlGeneratorMethodDetails_inlines.hpp"
 #include "infra/Annotations.hpp"
 #include "ruby/config.h"
+#include "ruby/optimizer/RubyCallInfo.hpp"
 #include "runtime/Runtime.hpp"
 #include "ras/DebugCounter.hpp"
 
@@ -77,7 +79,14 @@ RubyIlGenerator::RubyIlGenerator(TR::IlGeneratorMethodDetails &details,
      _pendingTreesOnEntry(std::less<int32_t>(),
                           TR::typed_allocator<std::pair<int32_t,int32_t>,
                                              TR::RawAllocator>(TR::RawAllocator())),
-     _vm_exec_coreBlock(0)
+     _entryTargets(std::less<int32_t>(),
+                   TR::typed_allocator<int32_t, TR::RawAllocator>(TR::RawAllocator())),
+     _pendingPushTempSlots(20, TR::comp()->trMemory(), heapAlloc, growable),
+     _vm_exec_coreBlock(0),
+     _virtualFrame(symRefTab.getRubyVirtualFrame(methodSymbol->getResolvedMethod())),
+     _promotedLocals(0),
+     _promotedLevel(0),
+     _frameRegisters(0)
    {
    trace_enabled = feGetEnv("TR_TRACE_RUBYILGEN");
    //Create Ruby Helpers.
@@ -92,30 +101,29 @@ RubyIlGenerator::RubyIlGenerator(TR::IlGeneratorMethodDetails &details,
       auto symRef = symRefTab.findOrCreateRubyHelperSymbolRef(helper, true, true, false);
       }
 
-   _epSymRef         = symRefTab.createRubyNamedShadowSymRef("ep",        TR::Address,            TR_RubyFE::SLOTSIZE, offsetof(rb_control_frame_t, ep),   true);
+   _epSymRef         = symRefTab.createRubyNamedShadowSymRef("ep",        TR::Address,            TR_RubyFE::SLOTSIZE, offsetof(rb_control_frame_t, ep),   true, TR::SymbolReferenceTable::HelperEffectsFrame);
    _cfpSymRef        = symRefTab.createRubyNamedShadowSymRef("cfp",       TR::Address,            TR_RubyFE::SLOTSIZE, offsetof(rb_thread_t, cfp),         false);
-   _spSymRef         = symRefTab.createRubyNamedShadowSymRef("sp",        TR::Address,            TR_RubyFE::SLOTSIZE, offsetof(rb_control_frame_t, sp),   true);
-   _flagSymRef       = symRefTab.createRubyNamedShadowSymRef("flag",      TR::Address,            TR_RubyFE::SLOTSIZE, offsetof(rb_control_frame_t, flag), true);
+   _spSymRef         = symRefTab.findOrCreateRubyFrameSPSymRef();
+   _flagSymRef       = symRefTab.createRubyNamedShadowSymRef("flag",      TR::Address,            TR_RubyFE::SLOTSIZE, offsetof(rb_control_frame_t, flag), true, TR::SymbolReferenceTable::HelperEffectsFrame);
 
 
    // PC is being rematerialized before calls that may read/modify its value, so kill it across helper calls.
-   _pcSymRef         = symRefTab.createRubyNamedShadowSymRef("pc",        TR::Address,             TR_RubyFE::SLOTSIZE, offsetof(rb_control_frame_t, pc),   true);
+   _pcSymRef         = symRefTab.createRubyPCSymRef();
    _selfSymRef       = symRefTab.createRubyNamedShadowSymRef("self",      TR_RubyFE::slotType(),    TR_RubyFE::SLOTSIZE, offsetof(rb_control_frame_t, self), false);
-   _icSerialSymRef   = symRefTab.createRubyNamedShadowSymRef("ic_serial", TR_RubyFE::slotType(),    TR_RubyFE::SLOTSIZE, offsetof(struct iseq_inline_cache_entry, ic_serial),        false);
-   _icValueSymRef    = symRefTab.createRubyNamedShadowSymRef("ic_value",  TR_RubyFE::slotType(),    TR_RubyFE::SLOTSIZE, offsetof(struct iseq_inline_cache_entry, ic_value.value),   false);
+   // Shared with the IL fastpather, which recognizes inline cache checks.
+   _icSerialSymRef   = symRefTab.findOrCreateRubyICSerialSymRef();
+   _icValueSymRef    = symRefTab.findOrCreateRubyICValueSymRef();
 
    _rb_iseq_struct_selfSymRef =
                        symRefTab.createRubyNamedShadowSymRef("rb_iseq_struct->self",      TR_RubyFE::slotType(),  TR_RubyFE::SLOTSIZE, offsetof(rb_iseq_struct, self),     false);  //self in rb_iseq_struct does not change across calls.
-   _iseqSymRef       = symRefTab.createRubyNamedShadowSymRef("iseq",                      TR::Address,           TR_RubyFE::SLOTSIZE, offsetof(rb_control_frame_t, iseq), true);
+   _iseqSymRef       = symRefTab.createRubyNamedShadowSymRef("iseq",                      TR::Address,           TR_RubyFE::SLOTSIZE, offsetof(rb_control_frame_t, iseq), true, TR::SymbolReferenceTable::HelperEffectsFrame);
 
-   static_assert(sizeof(*fe->getJitInterface()->globals.ruby_vm_global_constant_state_ptr) == TR_RubyFE::SLOTSIZE,
-                 "vm_global_constant_state wrong size");
-   _gcsSymRef        =  symRefTab.createRubyNamedStaticSymRef("ruby_vm_global_constant_state",     TR_RubyFE::slotType(),  fe->getJitInterface()->globals.ruby_vm_global_constant_state_ptr, 0, true);
+   _gcsSymRef        =  symRefTab.findOrCreateRubyGlobalConstantStateSymRef();
 
    static_assert(sizeof(*fe->getJitInterface()->globals.ruby_rb_mRubyVMFrozenCore_ptr) == TR_RubyFE::SLOTSIZE,
                  "frozen_core wrong size");
    _mRubyVMFrozenCoreSymRef =
-                        symRefTab.createRubyNamedStaticSymRef("ruby_mRubyVMFrozenCore",            TR_RubyFE::slotType(),  fe->getJitInterface()->globals.ruby_rb_mRubyVMFrozenCore_ptr,     0, true);
+                        symRefTab.createRubyNamedStaticSymRef("ruby_mRubyVMFrozenCore",            TR_RubyFE::slotType(),  fe->getJitInterface()->globals.ruby_rb_mRubyVMFrozenCore_ptr,     0, true, TR::SymbolReferenceTable::HelperEffectsGlobal);
 
    _privateSPSymRef = symRefTab.createTemporary(methodSymbol, TR::Address);
    _privateSPSymRef->setEmptyUseDefAliases(&symRefTab);
@@ -170,10 +178,29 @@ RubyIlGenerator::genIL()
 
    _stack = new (trStackMemory()) TR_Stack<TR::Node *>(trMemory(), 20, false, stackAlloc);
 
+   if (!_virtualFrame && comp()->isOutermostMethod())
+      createFrameRegisters();
+
+   bool passesBlocks = false;
+   if (_virtualFrame)
+      createVirtualFrameLocals();
+   else if (canPromoteLocals(passesBlocks))
+      createPromotedLocals(passesBlocks);
+   else
+      findPromotedOuterLocals();
+
    bool success = genILInternal();
 
    if (success)
+      {
       prependSPPrivatization();
+      if (_virtualFrame)
+         prependVirtualFrameSetup();
+      if (_promotedLocals && _promotedLevel == 0)
+         prependPromotedLocalsLoad();
+      if (_frameRegisters)
+         prependFrameRegistersLoad();
+      }
 
    comp()->setCurrentIlGenerator(0);
 
@@ -290,7 +317,8 @@ RubyIlGenerator::createBug(TR::Block * block, const char * abort_message, int32_
 void
 RubyIlGenerator::generateEntryTargets()
    {
-   const localset& targets = computeEntryTargets();
+   _entryTargets = computeEntryTargets();
+   const localset& targets = _entryTargets;
    for (auto iter = targets.begin(); iter != targets.end(); ++iter)
       {
       if (trace_enabled)
@@ -577,11 +605,26 @@ void
 RubyIlGenerator::addExceptionTargets(localset &targets)
    {
    const rb_iseq_t *iseq = mb().iseq();
+   if (!iseq->catch_table)
+      return;
+
+   // The redo and next entries of a block are only unwound to by a throw of
+   // the block itself: its plain next and redo are jumps.
+   bool hasThrow = false;
+   const VALUE *insns = rb_iseq_original_iseq(const_cast<rb_iseq_t *>(iseq));
+   for (unsigned long i = 0; i < iseq->iseq_size && !hasThrow; i += byteCodeLength(insns[i]))
+      hasThrow = insns[i] == BIN(throw);
+
    for (int i = 0;
         iseq->catch_table && i < iseq->catch_table->size;
         i++)
       {
       struct iseq_catch_table_entry &entry = iseq->catch_table->entries[i];
+      if (!hasThrow &&
+          (entry.type == iseq_catch_table_entry::CATCH_TYPE_REDO ||
+           entry.type == iseq_catch_table_entry::CATCH_TYPE_NEXT))
+         continue;
+
       if (!entry.iseq) // Catch entry is local
          {
 
@@ -621,6 +664,471 @@ RubyIlGenerator::prependSPPrivatization()
    return;
    }
 
+/**
+ * Create the temporaries holding the locals of a virtual frame, one per
+ * entry of the local table. Calls that materialize the frame may read and
+ * write them, so they are aliased with those calls.
+ */
+void
+RubyIlGenerator::createVirtualFrameLocals()
+   {
+   const rb_iseq_t *iseq = mb().iseq();
+   int32_t numLocals = iseq->local_table_size;
+
+   _virtualFrame->_numLocals  = numLocals;
+   _virtualFrame->_localTemps = (TR::SymbolReference **) comp()->trMemory()->allocateHeapMemory(std::max(numLocals, 1) * sizeof(TR::SymbolReference *));
+   for (int32_t i = 0; i < numLocals; i++)
+      _virtualFrame->_localTemps[i] = symRefTab()->createRubyStateTemporary(_methodSymbol, TR_RubyFE::slotType(), TR::SymbolReferenceTable::HelperEffectsFrame);
+   }
+
+/**
+ * Initialize the locals of a virtual frame as vm_push_frame would: the
+ * parameters from the send's arguments, everything else to nil.
+ */
+void
+RubyIlGenerator::prependVirtualFrameSetup()
+   {
+   const rb_iseq_t *iseq = mb().iseq();
+   bool isConstructor = _virtualFrame->_classTemp != NULL;
+
+   // The initialize of Class#new also allocates self, and runs only under
+   // the guards of genSendCacheGuards for the class it was looked up in.
+   // Nothing is allocated until the instance class is known to be unchanged:
+   //
+   //    B:     if (RCLASS_SERIAL(<instance class>) != <class_serial>) -> Bslow
+   //    B1:    if (ruby_vm_global_method_state != <method_state>)   -> Bslow
+   //    B2:    self = rb_obj_alloc(klass)
+   //           <locals>
+   //           ...
+   //    Bslow: see genConstructorSlowPath
+   TR::Block* block = methodSymbol()->prependEmptyFirstBlock();
+
+   if (isConstructor)
+      genObjectAllocation(block);
+
+   for (int32_t i = 0; i < _virtualFrame->_numLocals; i++)
+      {
+      TR::Node *value = i < iseq->param.lead_num ?
+         TR::Node::createLoad(_virtualFrame->_argumentTemps[i]) :
+         TR::Node::xconst(Qnil);
+      TR::Node::genTreeTop(TR::Node::createStore(_virtualFrame->_localTemps[i], value), block);
+      }
+
+   if (isConstructor)
+      {
+      TR::Block *slowBlock = genConstructorSlowPath();
+
+      TR::Block *stateBlock = methodSymbol()->prependEmptyFirstBlock();
+      auto ifMethodStateChanged = TR::Node::ifxcmpne(TR::Node::createLoad(symRefTab()->findOrCreateRubyGlobalMethodStateSymRef()),
+                                                     TR::Node::xconst(_virtualFrame->_methodState));
+      ifMethodStateChanged->setBranchDestination(slowBlock->getEntry());
+      TR::Node::genTreeTop(ifMethodStateChanged, stateBlock);
+      cfg()->addEdge(stateBlock, slowBlock);
+
+      TR::Block *classBlock = methodSymbol()->prependEmptyFirstBlock();
+      auto classExt = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                                 TR::Node::aconst(_virtualFrame->_instanceClass),
+                                                 symRefTab()->findOrCreateRubyClassExtSymRef());
+      auto ifClassMiss = TR::Node::ifxcmpne(xloadi(symRefTab()->findOrCreateRubyClassSerialSymRef(), classExt),
+                                            TR::Node::xconst(_virtualFrame->_classSerial));
+      ifClassMiss->setBranchDestination(slowBlock->getEntry());
+      TR::Node::genTreeTop(ifClassMiss, classBlock);
+      cfg()->addEdge(classBlock, slowBlock);
+      }
+   }
+
+/**
+ * self = rb_obj_alloc(klass), for the class Class#new was sent to.
+ */
+void
+RubyIlGenerator::genObjectAllocation(TR::Block *block)
+   {
+   TR::Node *alloc = TR::Node::create(TR::Node::xcallOp(), 1, TR::Node::createLoad(_virtualFrame->_classTemp));
+   alloc->setSymbolReference(getHelperSymRef(RubyHelper_rb_obj_alloc));
+   TR::Node::genTreeTop(TR::Node::createStore(_virtualFrame->_receiverTemp, alloc), block);
+   }
+
+/**
+ * The fallback of an inlined Class#new whose class or initialize changed
+ * since compilation: allocate and send initialize the way
+ * rb_class_new_instance would, and evaluate to the object.
+ *
+ *    Bslow: self = rb_obj_alloc(klass)
+ *           rb_funcallv(self, :initialize, argc, argv)
+ *           return self
+ */
+TR::Block *
+RubyIlGenerator::genConstructorSlowPath()
+   {
+   TR::Block *block = TR::Block::createEmptyBlock(comp());
+   cfg()->addNode(block);
+   _methodSymbol->getLastTreeTop()->join(block->getEntry());
+
+   genObjectAllocation(block);
+
+   int32_t argc = mb().iseq()->param.lead_num;
+   TR::Node *argv = TR::Node::aconst(0);
+   if (argc > 0)
+      {
+      TR::SymbolReference *localArray = comp()->getSymRefTab()->
+         createLocalPrimArray(TR_RubyFE::SLOTSIZE * argc, comp()->getMethodSymbol(), 8 /*FIXME: JVM-specific - byte*/);
+      localArray->setStackAllocatedArrayAccess();
+      argv = TR::Node::createWithSymRef(TR::loadaddr, 0, localArray);
+
+      for (int32_t i = 0; i < argc; i++)
+         {
+         TR::SymbolReference *shadow = comp()->getSymRefTab()->
+            findOrCreateGenericIntShadowSymbolReference(i * TR_RubyFE::SLOTSIZE, true /*allocUseDefBitVector*/);
+         TR::Node::genTreeTop(TR::Node::createWithSymRef(TR::astorei, 2, 2, argv,
+                                                         TR::Node::createLoad(_virtualFrame->_argumentTemps[i]),
+                                                         shadow),
+                              block);
+         }
+      }
+
+   TR::Node *call = TR::Node::create(TR::Node::xcallOp(), 4,
+                                     loadSelf(),
+                                     TR::Node::xconst(_virtualFrame->_me->called_id),
+                                     TR::Node::xconst(argc),
+                                     argv);
+   call->setSymbolReference(getHelperSymRef(RubyHelper_rb_funcallv));
+   TR::Node::genTreeTop(call, block);
+   TR::Node::genTreeTop(TR::Node::create(TR::areturn, 1, loadSelf()), block);
+   cfg()->addEdge(block, cfg()->getEnd());
+
+   return block;
+   }
+
+/**
+ * The temporary of the local `getlocal idx, 0` refers to in a virtual frame.
+ * Locals sit below the EP in local table order, so the local table index is
+ * `local_size - idx`.
+ */
+TR::SymbolReference *
+RubyIlGenerator::getVirtualFrameLocal(lindex_t idx)
+   {
+   int32_t index = mb().iseq()->local_size - idx;
+   TR_ASSERT(index >= 0 && index < _virtualFrame->_numLocals, "Local %d outside the local table of a virtual frame", (int32_t)idx);
+   return _virtualFrame->_localTemps[index];
+   }
+
+/**
+ * Why code other than the frame of `iseq` and the literal blocks it passes
+ * may see its locals, or NULL if nothing can. Blocks are checked the same
+ * way, and set `passesBlocks`.
+ *
+ * Locals escape through:
+ *
+ *   - a child iseq other than a literal block, be it a rescue or ensure
+ *     clause, a class body or a method definition, and a catch table entry
+ *     re-entering the body other than the break of a block;
+ *   - a block nested in a block, or passed to the methods that turn it into
+ *     a proc outliving the send, `lambda`, `proc` and `define_method`;
+ *   - a send that can capture the caller's binding, `binding` and the
+ *     string forms of eval, or of a method named at run time that might be
+ *     one of them.
+ *
+ * This is a syntactic escape analysis: a callee that converts a literal
+ * block into a proc is not seen here, which is why LowerMacroOps
+ * synchronizes the environment around every call of a method that passes
+ * blocks.
+ */
+const char *
+RubyIlGenerator::findLocalEscape(rb_iseq_t *iseq, bool isBlock, bool &passesBlocks)
+   {
+   static const char *capturingMethods[] =
+      {
+      "binding", "eval", "instance_eval", "class_eval", "module_eval",
+      "send", "__send__", "public_send",
+      };
+   static const char *escapingBlockSinks[] =
+      {
+      "lambda", "proc", "define_method",
+      };
+
+   for (int i = 0; iseq->catch_table && i < iseq->catch_table->size; i++)
+      {
+      struct iseq_catch_table_entry &entry = iseq->catch_table->entries[i];
+      if (entry.iseq ||
+          (entry.type != iseq_catch_table_entry::CATCH_TYPE_BREAK &&
+           entry.type != iseq_catch_table_entry::CATCH_TYPE_NEXT &&
+           entry.type != iseq_catch_table_entry::CATCH_TYPE_REDO))
+         return "catch_table";
+      }
+
+   const VALUE *insns = rb_iseq_original_iseq(iseq);
+   for (unsigned long i = 0; i < iseq->iseq_size; i += byteCodeLength(insns[i]))
+      {
+      const char *types = operandTypes(insns[i]);
+      for (int j = 0; types[j]; ++j)
+         {
+         VALUE operand = insns[i + j + 1];
+         if (types[j] == TS_ISEQ && operand)
+            return "child_iseq";
+
+         if (types[j] != TS_CALLINFO)
+            continue;
+
+         rb_call_info_t *ci = (rb_call_info_t *) operand;
+         const char *methodName = fe()->getJitInterface()->callbacks.rb_id2name_f(ci->mid);
+         for (size_t k = 0; methodName && k < sizeof(capturingMethods) / sizeof(capturingMethods[0]); k++)
+            {
+            if (!strcmp(methodName, capturingMethods[k]))
+               return methodName;
+            }
+
+         if (!ci->blockiseq)
+            continue;
+
+         if (isBlock)
+            return "nested_block";
+
+         for (size_t k = 0; methodName && k < sizeof(escapingBlockSinks) / sizeof(escapingBlockSinks[0]); k++)
+            {
+            if (!strcmp(methodName, escapingBlockSinks[k]))
+               return methodName;
+            }
+
+         const char *reason = findLocalEscape(ci->blockiseq, true, passesBlocks);
+         if (reason)
+            return reason;
+         passesBlocks = true;
+         }
+      }
+
+   return NULL;
+   }
+
+/**
+ * Whether the locals of this method can live in temporaries, which holds
+ * when only its own frame and the literal blocks it passes can see them;
+ * see findLocalEscape.
+ *
+ * TracePoint can still take a binding at a trace event, and the interpreter
+ * resumes from the environment; LowerMacroOps writes the locals back for
+ * both. A block that is not inlined, or a proc made from it, reads the
+ * environment from any call; LowerMacroOps writes the locals back around
+ * every call if `passesBlocks` is set.
+ */
+bool
+RubyIlGenerator::canPromoteLocals(bool &passesBlocks)
+   {
+   static const char *disablePromotion = feGetEnv("OMR_RUBY_DISABLE_LOCAL_PROMOTION");
+   if (disablePromotion || !comp()->isOutermostMethod())
+      return false;
+
+   rb_iseq_t *iseq = const_cast<rb_iseq_t *>(mb().iseq());
+   if (iseq->type != ISEQ_TYPE_METHOD)
+      return false;
+
+   passesBlocks = false;
+   const char *reason = findLocalEscape(iseq, false, passesBlocks);
+   if (reason)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.ilgen/promotedLocals/notPromoted/%s", reason));
+      return false;
+      }
+
+   static const char *disableBlockPromotion = feGetEnv("OMR_RUBY_DISABLE_BLOCK_LOCAL_PROMOTION");
+   if (passesBlocks && disableBlockPromotion)
+      return false;
+
+   return true;
+   }
+
+/**
+ * Create the temporaries holding the locals of this method, one per entry of
+ * the local table, and those holding its CFP and EP.
+ */
+void
+RubyIlGenerator::createPromotedLocals(bool passesBlocks)
+   {
+   rb_iseq_t *iseq = const_cast<rb_iseq_t *>(mb().iseq());
+   int32_t numLocals = iseq->local_table_size;
+
+   TR::SymbolReference **localTemps   = (TR::SymbolReference **) comp()->trMemory()->allocateHeapMemory(std::max(numLocals, 1) * sizeof(TR::SymbolReference *));
+   TR::SymbolReference **localShadows = (TR::SymbolReference **) comp()->trMemory()->allocateHeapMemory(std::max(numLocals, 1) * sizeof(TR::SymbolReference *));
+   for (int32_t i = 0; i < numLocals; i++)
+      {
+      localTemps[i]   = createPromotedLocalTemp(TR_RubyFE::slotType(), passesBlocks);
+      localShadows[i] = getLocalSymRef(iseq->local_size - i, 0);
+      }
+
+   TR::SymbolReference *epTemp = passesBlocks ?
+      createPromotedLocalTemp(TR::Address, passesBlocks) :
+      symRefTab()->createTemporary(_methodSymbol, TR::Address);
+   _promotedLocals = new (comp()->trHeapMemory()) TR_RubyPromotedLocals(iseq, epTemp, localTemps, localShadows, numLocals);
+   symRefTab()->setRubyPromotedLocals(_promotedLocals);
+   _promotedLevel = 0;
+
+   // The EP moves to the heap when a block becomes a proc; it is reloaded
+   // through the CFP after calls.
+   if (passesBlocks)
+      {
+      _promotedLocals->_cfpTemp  = _frameRegisters && _frameRegisters->_cfpTemp ? _frameRegisters->_cfpTemp : symRefTab()->createTemporary(_methodSymbol, TR::Address);
+      _promotedLocals->_epShadow = _epSymRef;
+      }
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.ilgen/promotedLocals/promoted%s", passesBlocks ? "/with_blocks" : ""));
+   }
+
+/**
+ * A temporary of a promoted local, aliased with the calls LowerMacroOps
+ * writes it back and reloads it around. That pass runs last, so until then
+ * the calls must kill the temporary themselves: a store before a call the
+ * environment is read from is not dead, and a load after one that may write
+ * it is not the value last stored.
+ */
+TR::SymbolReference *
+RubyIlGenerator::createPromotedLocalTemp(TR::DataTypes dt, bool passesBlocks)
+   {
+   if (passesBlocks)
+      return symRefTab()->createRubyStateTemporary(_methodSymbol, dt, TR::SymbolReferenceTable::HelperEffectsFrame);
+
+   TR::SymbolReference *temp = symRefTab()->createTemporary(_methodSymbol, dt);
+   temp->setEmptyUseDefAliases(symRefTab());
+   temp->setAliasedTo(getHelperSymRef(RubyHelper_vm_exec_core), true /*symmetric*/);
+   temp->setAliasedTo(getHelperSymRef(RubyHelper_vm_trace), true /*symmetric*/);
+   return temp;
+   }
+
+/**
+ * Load the EP and the promoted locals on entry. The VM has stored the
+ * arguments by then, and the body is entered here from every entry point,
+ * including the break of a block.
+ */
+void
+RubyIlGenerator::prependPromotedLocalsLoad()
+   {
+   TR::Block* block = methodSymbol()->prependEmptyFirstBlock();
+   if (_promotedLocals->_cfpTemp && !(_frameRegisters && _frameRegisters->_cfpTemp))
+      TR::Node::genTreeTop(TR::Node::createStore(_promotedLocals->_cfpTemp, loadCFP()), block);
+   TR::Node::genTreeTop(TR::Node::createStore(_promotedLocals->_epTemp, loadEP()), block);
+   for (int32_t i = 0; i < _promotedLocals->_numLocals; i++)
+      {
+      TR::Node *value = xloadi(_promotedLocals->_localShadows[i], TR::Node::createLoad(_promotedLocals->_epTemp));
+      TR::Node::genTreeTop(TR::Node::createStore(_promotedLocals->_localTemps[i], value), block);
+      }
+   }
+
+/**
+ * The temporary of the local `getlocal idx, <_promotedLevel>` refers to:
+ * a local of the method, or of the method a block inlined into it belongs
+ * to.
+ */
+TR::SymbolReference *
+RubyIlGenerator::getPromotedLocal(lindex_t idx)
+   {
+   int32_t index = _promotedLocals->_iseq->local_size - idx;
+   TR_ASSERT(index >= 0 && index < _promotedLocals->_numLocals, "Local %d outside the local table of a promoted method", (int32_t)idx);
+   return _promotedLocals->_localTemps[index];
+   }
+
+/**
+ * A block of the method being compiled, inlined at one of its yields, reads
+ * and writes the locals of the method in their temporaries.
+ */
+void
+RubyIlGenerator::findPromotedOuterLocals()
+   {
+   TR_RubyPromotedLocals *locals = symRefTab()->getRubyPromotedLocals();
+   if (locals && mb().iseq()->parent_iseq == locals->_iseq)
+      {
+      _promotedLocals = locals;
+      _promotedLevel  = 1;
+      }
+   }
+
+/**
+ * Create the temporaries holding the CFP, self and EP of the method or block
+ * being compiled, and its outer EPs, up to the deepest level its getlocal and
+ * setlocal reach.
+ *
+ * LowerMacroOps reloads the EPs after calls only once the other optimizations
+ * have run, so their temporaries are aliased with the helpers that may move
+ * an environment to the heap.
+ */
+void
+RubyIlGenerator::createFrameRegisters()
+   {
+   static const char *disablePrivatization = feGetEnv("OMR_RUBY_DISABLE_FRAME_REGISTER_PRIVATIZATION");
+   static const char *disableEPCache       = feGetEnv("OMR_RUBY_DISABLE_EP_CHAIN_CACHE");
+
+   int32_t maxLevel = 0;
+   for (int32_t i = 0; !disableEPCache && i < _maxByteCodeIndex; i += byteCodeLength(at(i)))
+      {
+      switch (at(i))
+         {
+         case BIN(getlocal):
+         case BIN(setlocal):
+            maxLevel = std::max(maxLevel, (int32_t) at(i + 2));
+            break;
+         case BIN(getlocal_OP__WC__1):
+         case BIN(setlocal_OP__WC__1):
+            maxLevel = std::max(maxLevel, 1);
+            break;
+         }
+      }
+
+   if (disablePrivatization && maxLevel == 0)
+      return;
+
+   TR::SymbolReference **epTemps = (TR::SymbolReference **) comp()->trMemory()->allocateHeapMemory((maxLevel + 1) * sizeof(TR::SymbolReference *));
+   epTemps[0] = disablePrivatization ? NULL : symRefTab()->createRubyStateTemporary(_methodSymbol, TR::Address, TR::SymbolReferenceTable::HelperEffectsFrame);
+   for (int32_t level = 1; level <= maxLevel; level++)
+      epTemps[level] = symRefTab()->createRubyStateTemporary(_methodSymbol, TR_RubyFE::slotType(), TR::SymbolReferenceTable::HelperEffectsFrame);
+
+   // Without privatization, only the outer EPs are kept; the CFP, self and
+   // EP are loaded off th->cfp as before.
+   TR::SymbolReference *cfpTemp  = disablePrivatization ? NULL : symRefTab()->createTemporary(_methodSymbol, TR::Address);
+   TR::SymbolReference *selfTemp = disablePrivatization ? NULL : symRefTab()->createTemporary(_methodSymbol, TR_RubyFE::slotType());
+
+   _frameRegisters = new (comp()->trHeapMemory()) TR_RubyFrameRegisters(cfpTemp, _cfpSymRef,
+                                                                       selfTemp, _epSymRef, epTemps, maxLevel);
+   symRefTab()->setRubyFrameRegisters(_frameRegisters);
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.ilgen/frameRegisters/%s/%d", disablePrivatization ? "outerEPs" : "all", maxLevel));
+   }
+
+/**
+ * Load the frame registers once on entry, keeping the CFP to walk the EP
+ * chain again from after calls. This runs ahead of every other entry block,
+ * which load them from their temporaries.
+ */
+void
+RubyIlGenerator::prependFrameRegistersLoad()
+   {
+   TR::Block* block = methodSymbol()->prependEmptyFirstBlock();
+   if (_frameRegisters->_cfpTemp)
+      {
+      TR::Node *cfp = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                                 loadThread(),
+                                                 _cfpSymRef);
+      TR::Node::genTreeTop(TR::Node::createStore(_frameRegisters->_cfpTemp, cfp), block);
+      }
+
+   if (_frameRegisters->_selfTemp)
+      {
+      TR::Node *self = xloadi(_selfSymRef, loadCFP());
+      TR::Node::genTreeTop(TR::Node::createStore(_frameRegisters->_selfTemp, self), block);
+      }
+
+   TR::Node *ep = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                             loadCFP(),
+                                             _epSymRef);
+   if (_frameRegisters->_epTemps[0])
+      {
+      TR::Node::genTreeTop(TR::Node::createStore(_frameRegisters->_epTemps[0], ep), block);
+      ep = TR::Node::createLoad(_frameRegisters->_epTemps[0]);
+      }
+
+   for (int32_t level = 1; level <= _frameRegisters->_maxLevel; level++)
+      {
+      TR::Node::genTreeTop(TR::Node::createStore(_frameRegisters->_epTemps[level], loadPrevEP(ep)), block);
+      ep = TR::Node::createLoad(_frameRegisters->_epTemps[level]);
+      }
+   }
+
 bool
 RubyIlGenerator::genILInternal()
    {
@@ -634,7 +1142,8 @@ RubyIlGenerator::genILInternal()
             enableEntrySwitch ? "enabled"
             : "disabled. This requires the VM check incoming offset be zero.");
 
-   if (enableEntrySwitch)
+   // A virtual frame is only entered at its start, from its call site.
+   if (enableEntrySwitch && !_virtualFrame)
       generateEntryTargets();
 
    TR::Block *lastBlock = walker(NULL);
@@ -661,7 +1170,7 @@ RubyIlGenerator::genILInternal()
    // points too?
    _stack->clear();
 
-   if (enableEntrySwitch)
+   if (enableEntrySwitch && !_virtualFrame)
       generateEntrySwitch();
 
    return true;
@@ -940,7 +1449,7 @@ RubyIlGenerator::getStackSymRef(int32_t stackHeight)
       return _stackSymRefs.DataAt(hashIndex);
 
    int32_t offset = TR_RubyFE::SLOTSIZE * stackHeight;
-   auto symRef = symRefTab()->createRubyNamedShadowSymRef("stackSlot", TR_RubyFE::slotType(), TR_RubyFE::SLOTSIZE, offset, true);
+   auto symRef = symRefTab()->createRubyStackSlotSymRef(offset);
    _stackSymRefs.Add(stackHeight, symRef);
 
    traceMsg(comp(), "Created stack symRef with spOffset = %d ( stackHeight %d SLOTSIZE %d)\n", offset, stackHeight, TR_RubyFE::SLOTSIZE);
@@ -960,7 +1469,8 @@ RubyIlGenerator::getLocalSymRef(lindex_t idx, rb_num_t level)
       char *name = const_cast<char*>(getLocalName(idx, level));
 
       int32_t offset = - TR_RubyFE::SLOTSIZE * idx;
-      auto symRef = symRefTab()->createRubyNamedShadowSymRef(name, TR_RubyFE::slotType(), TR_RubyFE::SLOTSIZE, offset, true);
+      auto symRef = symRefTab()->createRubyNamedShadowSymRef(name, TR_RubyFE::slotType(), TR_RubyFE::SLOTSIZE, offset, true,
+                                                             TR::SymbolReferenceTable::HelperEffectsFrame);
       _localSymRefs.Add(key, symRef);
 
       return symRef;
@@ -980,9 +1490,22 @@ RubyIlGenerator::getHelperSymRef(TR_RuntimeHelper helper)
 TR::Node *
 RubyIlGenerator::getlocal(lindex_t idx, rb_num_t level)
    {
-   // val = *(ep - idx);
-   TR::Node *load = xloadi(getLocalSymRef(idx, level),
-                            loadEP(level));
+   TR::Node *load;
+   if (_virtualFrame)
+      {
+      TR_ASSERT(level == 0, "Outer locals accessed in a virtual frame");
+      load = TR::Node::createLoad(getVirtualFrameLocal(idx));
+      }
+   else if (_promotedLocals && level == _promotedLevel)
+      {
+      load = TR::Node::createLoad(getPromotedLocal(idx));
+      }
+   else
+      {
+      // val = *(ep - idx);
+      load = xloadi(getLocalSymRef(idx, level),
+                    loadEP(level));
+      }
    genTreeTop(load); // anchor - the value may go onto
                      // the stack and a store may be done
                      // to the local in the interim
@@ -994,6 +1517,21 @@ RubyIlGenerator::setlocal(lindex_t idx, rb_num_t level)
    {
    // *(ep - idx) = val
    auto value = pop();
+   if (_virtualFrame)
+      {
+      TR_ASSERT(level == 0, "Outer locals accessed in a virtual frame");
+      TR::Node *store = TR::Node::createStore(getVirtualFrameLocal(idx), value);
+      genTreeTop(store);
+      return store;
+      }
+
+   if (_promotedLocals && level == _promotedLevel)
+      {
+      TR::Node *store = TR::Node::createStore(getPromotedLocal(idx), value);
+      genTreeTop(store);
+      return store;
+      }
+
    TR::Node *store = xstorei(getLocalSymRef(idx, level),
                               loadEP(level),
                               value);
@@ -1240,7 +1778,11 @@ RubyIlGenerator::genCall(TR_RuntimeHelper helper, TR::ILOpCodes opcode, int32_t
 
    handleSideEffect(callNode);
 
-   genTreeTop(storePC(byteCodePC)); //Store PC. This comes after handleSideEffect to enable the simple fastpathing code
+   //Store PC. This comes after handleSideEffect to enable the simple fastpathing code.
+   //A virtual frame's pc is recovered from the call's bytecode index instead,
+   //if the frame has to be materialized.
+   if (!_virtualFrame)
+      genTreeTop(storePC(byteCodePC));
    genTreeTop(callNode);
 
    return callNode;
@@ -1339,6 +1881,118 @@ RubyIlGenerator::computeNumArgs(rb_call_info_t* ci, CallType type)
    return numArgs;
    }
 
+/**
+ * Copy `ci` into a call info sending `mid` with `argc` arguments, with an
+ * inline cache of its own.
+ *
+ * Compiled bodies send through the copy, so it lives as long as the VM.
+ * There is one per call info, reused when the method is compiled again. Its
+ * cache starts out invalid, method state 0 never being current, so the VM
+ * looks the method up on the first send.
+ */
+rb_call_info_t *
+RubyIlGenerator::createDirectCallInfo(rb_call_info_t *ci, ID mid, int32_t argc)
+   {
+   typedef std::map<rb_call_info_t *, rb_call_info_t *, std::less<rb_call_info_t *>,
+                    TR::typed_allocator<std::pair<rb_call_info_t * const, rb_call_info_t *>, TR::RawAllocator>
+                   > callinfomap;
+   static callinfomap directCallInfos(std::less<rb_call_info_t *>(),
+                                      TR::typed_allocator<std::pair<rb_call_info_t * const, rb_call_info_t *>,
+                                                         TR::RawAllocator>(TR::RawAllocator()));
+
+   rb_call_info_t *&directCi = directCallInfos[ci];
+   if (!directCi)
+      directCi = new (comp()->trPersistentMemory()) rb_call_info_t(*ci);
+   else
+      *directCi = *ci;
+
+   directCi->mid          = mid;
+   directCi->orig_argc    = argc;
+   directCi->argc         = argc;
+   directCi->method_state = 0;
+   directCi->class_serial = 0;
+   directCi->me           = 0;
+   directCi->defined_class = 0;
+   directCi->call         = 0;
+   memset(&directCi->aux, 0, sizeof(directCi->aux));
+   return directCi;
+   }
+
+/**
+ * For `recv.send(:sym, args...)`, `__send__` or `public_send` with a literal
+ * symbol, return a call info sending `sym` with `args` directly. Returns
+ * NULL for any other send.
+ */
+rb_call_info_t *
+RubyIlGenerator::getSymbolSendCallInfo(rb_call_info_t *ci)
+   {
+   static const char *disableSymbolSends = feGetEnv("OMR_RUBY_DISABLE_SYMBOL_SEND_DISPATCH");
+   if (disableSymbolSends ||
+       ci->orig_argc < 1 ||
+       ci->kw_arg ||
+       (ci->flag & (VM_CALL_ARGS_SPLAT | VM_CALL_ARGS_BLOCKARG)))
+      return NULL;
+
+   const char *methodName = fe()->getJitInterface()->callbacks.rb_id2name_f(ci->mid);
+   if (!methodName)
+      return NULL;
+
+   bool isPublicSend = !strcmp(methodName, "public_send");
+   if (!isPublicSend && strcmp(methodName, "send") && strcmp(methodName, "__send__"))
+      return NULL;
+
+   // The symbol is the first argument, below the others on the stack.
+   TR::Node *symbol = topn(ci->orig_argc - 1);
+   if (!symbol->getOpCode().isLoadConst() || !STATIC_SYM_P((VALUE)symbol->get64bitIntegralValue()))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.ilgen/symbolSend/notConstant/%s", methodName));
+      return NULL;
+      }
+
+   rb_call_info_t *directCi = createDirectCallInfo(ci, SYM2ID((VALUE)symbol->get64bitIntegralValue()), ci->orig_argc - 1);
+
+   // send ignores visibility, as a send without a receiver would;
+   // public_send never reaches private or protected methods.
+   if (isPublicSend)
+      directCi->flag &= ~(VM_CALL_FCALL | VM_CALL_VCALL);
+   else
+      directCi->flag |= VM_CALL_FCALL;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.ilgen/symbolSend/direct/%s", methodName));
+   return directCi;
+   }
+
+/**
+ * For `recv.m(&:sym)`, return a call info sending `sym` to each value the
+ * block is yielded, as Symbol#to_proc's proc would: without arguments and
+ * respecting visibility. Returns NULL unless the block argument is a literal
+ * symbol.
+ */
+rb_call_info_t *
+RubyIlGenerator::getSymbolBlockCallInfo(rb_call_info_t *ci)
+   {
+   static const char *disableSymbolBlocks = feGetEnv("OMR_RUBY_DISABLE_SYMBOL_BLOCK_DISPATCH");
+   if (disableSymbolBlocks ||
+       !(ci->flag & VM_CALL_ARGS_BLOCKARG) ||
+       (ci->flag & VM_CALL_ARGS_SPLAT))
+      return NULL;
+
+   // The block argument is on top of the stack.
+   TR::Node *symbol = topn(0);
+   if (!symbol->getOpCode().isLoadConst() || !STATIC_SYM_P((VALUE)symbol->get64bitIntegralValue()))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.ilgen/symbolBlock/notConstant"));
+      return NULL;
+      }
+
+   rb_call_info_t *symbolCi = createDirectCallInfo(ci, SYM2ID((VALUE)symbol->get64bitIntegralValue()), 0);
+   symbolCi->flag      = 0;
+   symbolCi->blockiseq = 0;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.ilgen/symbolBlock/direct"));
+   return symbolCi;
+   }
+
 /**
  * Generate a call to a ruby function that gets its arguments via the ruby stack.
  */
@@ -1367,6 +2021,35 @@ RubyIlGenerator::genCall_ruby_stack(VALUE civ, CallType type)
       //unreachable.
       }
 
+   // A send of a literal symbol becomes a send of that method, the symbol
+   // dropping out of the arguments. vm_send_symbol_without_block dispatches
+   // it only while `send` still finds the method entry of Kernel#send
+   // through `sendCi`, and sends the symbol the original way otherwise.
+   rb_call_info_t *sendCi = NULL;
+   if (type == CallType_send_without_block)
+      {
+      rb_call_info_t *directCi = getSymbolSendCallInfo(ci);
+      if (directCi)
+         {
+         TR::Node **args = (TR::Node **) comp()->trMemory()->allocateHeapMemory(std::max(directCi->orig_argc, 1) * sizeof(TR::Node *));
+         for (int32_t i = 0; i < directCi->orig_argc; i++)
+            args[i] = pop();
+         pop(); // the symbol
+         for (int32_t i = directCi->orig_argc - 1; i >= 0; i--)
+            push(args[i]);
+
+         sendCi = ci;
+         ci     = directCi;
+         civ    = (VALUE)directCi;
+         }
+      }
+
+   // A literal &:sym block is kept along with the receiver, so that the
+   // fastpather can send `sym` to the elements of core iterators directly.
+   rb_call_info_t *symbolBlockCi = NULL;
+   if (type == CallType_send)
+      symbolBlockCi = getSymbolBlockCallInfo(ci);
+
    int32_t pending   = _stack->size();
    auto    numArgs   = computeNumArgs(ci, type);
    int32_t restores  = pending - numArgs; // Stack elements not consumed by call.
@@ -1384,6 +2067,16 @@ RubyIlGenerator::genCall_ruby_stack(VALUE civ, CallType type)
       traceMsg(comp(), "Creating call at bci=%d\n", _bcIndex);
 
    TR::Node *recv = 0;
+   TR::SymbolReference **argumentTemps = 0;
+   TR::SymbolReference *receiverTemp = 0;
+
+   // Keep the arguments of sends without a block in temps, for the
+   // fastpather's accessor expansions and for callees inlined without a
+   // frame. Both need a receiver class the VM recorded for the site, so
+   // sites it has none for are left alone.
+   if (type == CallType_send_without_block && ci->orig_argc > 0 &&
+       TR_RubyInliningPolicy::getSiteHotness(ci) != TR_RubyInliningPolicy::ColdSite)
+      argumentTemps = (TR::SymbolReference **) comp()->trMemory()->allocateHeapMemory(ci->orig_argc * sizeof(TR::SymbolReference *));
 
    if (pending > 0)
       {
@@ -1399,6 +2092,22 @@ RubyIlGenerator::genCall_ruby_stack(VALUE civ, CallType type)
             {
             val   = pop(); // Pop off args
             recv  = val;   // Save the receiver for those sends that need it.
+
+            if (argumentTemps && i < ci->orig_argc)
+               {
+               auto *argumentTemp = symRefTab()->createTemporary(_methodSymbol, val->getDataType());
+               genTreeTop(TR::Node::createStore(argumentTemp, val));
+               argumentTemps[ci->orig_argc - 1 - i] = argumentTemp;
+               }
+
+            // Likewise keep the receiver of sends passing a literal block,
+            // which the inliner needs to push the callee's frame.
+            if (i == numArgs - 1 && type == CallType_send &&
+                ((ci->blockiseq && !(ci->flag & VM_CALL_ARGS_BLOCKARG)) || symbolBlockCi))
+               {
+               receiverTemp = symRefTab()->createTemporary(_methodSymbol, val->getDataType());
+               genTreeTop(TR::Node::createStore(receiverTemp, val));
+               }
             traceMsg(comp(), "\t[%d] writing argument to stack slot %d (N = %p)\n",
                      _bcIndex, pending - i - 1, val);
             }
@@ -1432,13 +2141,30 @@ RubyIlGenerator::genCall_ruby_stack(VALUE civ, CallType type)
                             loadThread(),
                             TR::Node::aconst((uintptr_t)civ),
                             loadCFP());
+         if (receiverTemp)
+            symRefTab()->setRubySendReceiverTempSymRef(callNode, receiverTemp);
+         if (symbolBlockCi)
+            symRefTab()->setRubySendSymbolBlockCallInfo(callNode, symbolBlockCi);
+         //Sends with a literal block are inlined along with the block, and
+         //those passing &:sym are expanded ahead of inlining.
+         if (symbolBlockCi || receiverTemp)
+            methodSymbol()->setMayHaveInlineableCall(true);
          break;
       case CallType_send_without_block:
          TR_ASSERT(recv, "Reciever is null, despite sending-without-block\n");
-         callNode = genCall(RubyHelper_vm_send_without_block, TR::Node::xcallOp(), 3,
-                            loadThread(),
-                            TR::Node::aconst((uintptr_t)civ),
-                            recv);
+         if (sendCi)
+            callNode = genCall(RubyHelper_vm_send_symbol_without_block, TR::Node::xcallOp(), 4,
+                               loadThread(),
+                               TR::Node::aconst((uintptr_t)civ),
+                               recv,
+                               TR::Node::aconst((uintptr_t)sendCi));
+         else
+            callNode = genCall(RubyHelper_vm_send_without_block, TR::Node::xcallOp(), 3,
+                               loadThread(),
+                               TR::Node::aconst((uintptr_t)civ),
+                               recv);
+         if (argumentTemps)
+            symRefTab()->setRubySendArgumentTempSymRefs(callNode, argumentTemps);
          //Let the inliner take a pass at this.
          methodSymbol()->setMayHaveInlineableCall(true);
          break;
@@ -1460,6 +2186,8 @@ RubyIlGenerator::genCall_ruby_stack(VALUE civ, CallType type)
          callNode = genCall(RubyHelper_vm_invokeblock, TR::Node::xcallOp(), 2,
                             loadThread(),
                             TR::Node::aconst((uintptr_t)civ));
+         //The block is known if this method is inlined into a send passing a literal block.
+         methodSymbol()->setMayHaveInlineableCall(true);
          break;
 
       default:
@@ -1468,6 +2196,11 @@ RubyIlGenerator::genCall_ruby_stack(VALUE civ, CallType type)
          //unreachable.
       }
 
+   // The receiver and arguments are all the send reads off the YARV stack;
+   // the pending slots below them are only written for the interpreter.
+   if (pending > 0)
+      symRefTab()->setRubySendStackArgumentsSymRef(callNode, getStackSymRef(restores));
+
    if (restores > 0)
       {
       TR_ASSERT(pending > 0, "Reducing stack height where no buy occured!");
@@ -1944,13 +2677,16 @@ RubyIlGenerator::getinlinecache(OFFSET offset, IC ic)
 
    // TODO: Q: How important is it for us to push Qnil? Usually that value
    // will be discarded on the miss path. Need to investigate.
+   //
+   // When the cache is already filled at compile time, the IL fastpather
+   // folds the cached constant into the body (see foldConstantCache), so the
+   // shape of the ternary below must be kept in sync with it.
 
    // This way the operand stack is properly managed by the byte code iterator
    // framework
    TR::Node *icNode = TR::Node::aconst((uintptr_t)ic);
-   TR::Node *hit_p = TR::Node::create(TR::lcmpeq, 2,
-                                        loadICSerial(icNode),
-                                        getGlobalConstantState());
+   TR::Node *hit_p = TR::Node::xcmpeq(loadICSerial(icNode),
+                                      getGlobalConstantState());
    TR::Node *ternary = TR::Node::xternary(hit_p,
                                  loadICValue(icNode),
                                  TR::Node::xconst(Qnil));
@@ -1998,12 +2734,19 @@ RubyIlGenerator::generateCfpPop()
 int32_t
 RubyIlGenerator::genReturn(TR::Node *retval, bool popframe)
    {
-   genAsyncCheck();
+   // A virtual frame has no frame to pop, and leaves checking for interrupts
+   // to its caller.
+   if (!_virtualFrame)
+      genAsyncCheck();
 
    // anchor retval before popping the frame
    genTreeTop(retval);
 
-   if (popframe)
+   // Class#new evaluates to the object its initialize was sent to.
+   if (_virtualFrame && _virtualFrame->_classTemp)
+      retval = loadSelf();
+
+   if (popframe && !_virtualFrame)
       {
       auto* cfp = generateCfpPop();
       // pop the frame
@@ -2066,6 +2809,9 @@ RubyIlGenerator::loadDisplacement()
 TR::Node *
 RubyIlGenerator::loadCFP()
    {
+   if (_frameRegisters && _frameRegisters->_cfpTemp)
+      return TR::Node::createLoad(_frameRegisters->_cfpTemp);
+
    // iaload thread->cfp
    //    aload thread
    return TR::Node::createWithSymRef(TR::aloadi, 1, 1,
@@ -2145,6 +2891,12 @@ RubyIlGenerator::load_CFP_ISeq()
 TR::Node *
 RubyIlGenerator::loadSelf()
    {
+   if (_virtualFrame)
+      return TR::Node::createLoad(_virtualFrame->_receiverTemp);
+
+   if (_frameRegisters && _frameRegisters->_selfTemp)
+      return TR::Node::createLoad(_frameRegisters->_selfTemp);
+
    return xloadi(_selfSymRef,
                  loadCFP());
    }
@@ -2158,6 +2910,9 @@ RubyIlGenerator::loadPrivateSP()
 TR::Node *
 RubyIlGenerator::loadEP(rb_num_t level)
    {
+   if (_frameRegisters && level <= (rb_num_t) _frameRegisters->_maxLevel && _frameRegisters->_epTemps[level])
+      return TR::Node::createLoad(_frameRegisters->_epTemps[level]);
+
    TR::Node *ep = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
                                      loadCFP(),
                                      _epSymRef);
@@ -2173,12 +2928,9 @@ TR::Node *
 RubyIlGenerator::loadPrevEP(TR::Node *ep)
    {
    // Note: we need to use a shadow instead of _epSymRef as ep->ep
-   // is a different thing from cfp->ep
-   // 
-   // We can provide better aliasing if we  use a specific shadow symbols
-   // instead of generic-int-shadow
-   TR::SymbolReference *shadow = comp()->getSymRefTab()->
-      findOrCreateGenericIntShadowSymbolReference(0, true /*allocUseDefBitVector*/);
+   // is a different thing from cfp->ep. It is a shadow of its own rather
+   // than the generic int shadow, so that it only aliases environments.
+   TR::SymbolReference *shadow = symRefTab()->findOrCreateRubyPrevEPSymRef();
 
    return TR::Node::xand(xloadi(shadow,
                   ep),
@@ -2219,10 +2971,13 @@ RubyIlGenerator::saveStack(int32_t targetIndex)
       if (_stackTemps.topIndex() < i || _stackTemps[i] != _stack->element(i))
          handlePendingPushSaveSideEffects(_stack->element(i));
 
-   // In the future, this can be made non-static in the cases where we
-   // understand control flow must be passed along the JIT rather than
-   // coming from the interpreter.
-   static bool useTemps = feGetEnv("DEBUG_GET_TEMPS");
+   // The targets of the entry switch are entered from the VM with their
+   // pending values on the YARV stack. Every other block is only reached
+   // from compiled code, and takes them in pending push temps. The values
+   // the interpreter and the callees read are written out before each send
+   // regardless; see genCall_ruby_stack.
+   static const char *disableTemps = feGetEnv("OMR_RUBY_DISABLE_PENDING_PUSH_TEMPS");
+   bool useTemps = !disableTemps && targetIndex >= 0 && _entryTargets.find(targetIndex) == _entryTargets.end();
 
    if (!useTemps)
       {
@@ -2243,7 +2998,10 @@ RubyIlGenerator::saveStack(int32_t targetIndex)
          symRefTab()->findOrCreatePendingPushTemporary(_methodSymbol, i, n->getDataType()) :
          getStackSymRef(i);
 
-      if (_stackTemps.topIndex() < i || _stackTemps[i] != n)
+      // A slot saved for another target only holds n where that target
+      // takes it from.
+      if (_stackTemps.topIndex() < i || _stackTemps[i] != n ||
+          _pendingPushTempSlots.isSet(i) != useTemps)
          {
          traceMsg(comp(), "Saving node %p to %s slot %d in %d -> %d\n",
                   n,
@@ -2258,6 +3016,10 @@ RubyIlGenerator::saveStack(int32_t targetIndex)
 
          genTreeTop(store);
          _stackTemps[i] = n;
+         if (useTemps)
+            _pendingPushTempSlots.set(i);
+         else
+            _pendingPushTempSlots.reset(i);
          }
 
       // this arranges that the saved slot is reloaded on entry to the successor
@@ -24,6 +24,7 @@
 #include "ilgen/IlGen.hpp"
 #include "cs2/llistof.h"
 #include "il/Node.hpp"
+#include "infra/BitVector.hpp"
 
 /* Some OMR headers define min/max macros. To support use of 
  * STL headers here, we undef them here. 
@@ -43,6 +44,7 @@
 
 namespace TR { class IlGeneratorMethodDetails; }
 namespace TR { class Block; }
+struct TR_RubyVirtualFrame;
 
 // Set type: FIXME: Rename this to a better type.
 typedef std::set<int32_t, std::less<int32_t>, 
@@ -156,6 +158,20 @@ typedef std::map<int32_t, int32_t, std::less<int32_t>,
  * we have an exception edge target to a block that was not generated in
  * straight line code. 
  *
+ * Virtual Frames
+ * ==============
+ *
+ * A callee the inliner decided to inline without pushing a control frame is
+ * described by a TR_RubyVirtualFrame. Its IL reads self from the temporary
+ * the caller stored the receiver to, keeps its locals in temporaries
+ * initialized from the send's argument temporaries, and stores no pc. It
+ * continues the YARV stack of its caller and has no entry switch, as it is
+ * only entered at its start. Ruby::LowerMacroOps materializes a control frame
+ * around the calls that may observe it.
+ *
+ * The initialize of an inlined Class#new is generated as a virtual frame
+ * which first allocates self, and evaluates to self.
+ *
  * Other Requirements of IlGen
  * ===========================
  *
@@ -203,6 +219,20 @@ class RubyIlGenerator : public TR_IlGenerator, public TR_RubyByteCodeIteratorWit
 
    bool genILInternal();
    void prependSPPrivatization();
+   void createVirtualFrameLocals();
+   void prependVirtualFrameSetup();
+   void genObjectAllocation(TR::Block *block);
+   TR::Block *genConstructorSlowPath();
+   TR::SymbolReference *getVirtualFrameLocal(lindex_t idx);
+   const char *findLocalEscape(rb_iseq_t *iseq, bool isBlock, bool &passesBlocks);
+   bool canPromoteLocals(bool &passesBlocks);
+   void createPromotedLocals(bool passesBlocks);
+   TR::SymbolReference *createPromotedLocalTemp(TR::DataTypes dt, bool passesBlocks);
+   void prependPromotedLocalsLoad();
+   void findPromotedOuterLocals();
+   TR::SymbolReference *getPromotedLocal(lindex_t idx);
+   void createFrameRegisters();
+   void prependFrameRegistersLoad();
    TR::Block *walker(TR::Block *prevBlock);
 
    void indexedWalker(int32_t, int32_t&, int32_t&);
@@ -318,6 +348,9 @@ class RubyIlGenerator : public TR_IlGenerator, public TR_RubyByteCodeIteratorWit
 
    TR::Node *genCall(TR_RuntimeHelper helper, TR::ILOpCodes opcode, int32_t num, ...);
    TR::Node *genCall_ruby_stack(VALUE civ, CallType type);
+   rb_call_info_t *createDirectCallInfo(rb_call_info_t *ci, ID mid, int32_t argc);
+   rb_call_info_t *getSymbolSendCallInfo(rb_call_info_t *ci);
+   rb_call_info_t *getSymbolBlockCallInfo(rb_call_info_t *ci);
    TR::Node *genCall_funcallv(VALUE ci);
 
    void     dumpCallInfo(rb_call_info_t *);
@@ -378,6 +411,18 @@ class RubyIlGenerator : public TR_IlGenerator, public TR_RubyByteCodeIteratorWit
     */
    intmap _pendingTreesOnEntry; 
 
+   /**
+    * Targets of the entry switch, which take their pending trees off the
+    * YARV stack rather than from pending push temps.
+    */
+   localset _entryTargets;
+
+   /**
+    * Stack slots whose entry in `_stackTemps` was saved to a pending push
+    * temp rather than to the YARV stack.
+    */
+   TR_BitVector _pendingPushTempSlots;
+
    /**
     * Block containing a vm_exec_core call, which can be branched to
     * in order to reinvoke the interpreter. 
@@ -387,6 +432,26 @@ class RubyIlGenerator : public TR_IlGenerator, public TR_RubyByteCodeIteratorWit
     */
    TR::Block* _vm_exec_coreBlock; 
 
+   /**
+    * The frame of this method if it is being inlined without pushing a
+    * control frame, NULL otherwise.
+    */
+   TR_RubyVirtualFrame *_virtualFrame;
+
+   /**
+    * The locals kept in temporaries, NULL if they are all accessed through
+    * the EP: those of this method, or those of the method this block belongs
+    * to, at `_promotedLevel`.
+    */
+   TR_RubyPromotedLocals *_promotedLocals;
+   rb_num_t               _promotedLevel;
+
+   /**
+    * The CFP, self and EPs of this method or block kept in temporaries, NULL
+    * if they are loaded off th->cfp.
+    */
+   TR_RubyFrameRegisters *_frameRegisters;
+
    };
 
 #endif
@@ -58,6 +58,7 @@ static const OptimizationStrategy rubyNoOptStrategyOpts[] =
 
 static const OptimizationStrategy rubyColdStrategyOpts[] =
    {
+   { OMR::rubyBlockIntrinsicExpansion                                        },
    { OMR::trivialInlining                                                    },
    { OMR::rubyIlFastpather                                                   },
    { OMR::basicBlockExtension                                                },
@@ -89,11 +90,45 @@ static const OptimizationStrategy rubyWarmStrategyOpts[] =
    { OMR::endOpts                                                            },
    };
 
+// For the hottest methods: the loop and global opts run over the fastpathed
+// and inlined IL. Its loops get canonicalized and their induction variables
+// found. The loop versioner is left out: it removes Java checks, which the
+// Ruby IL does not have.
+// Partial redundancy elimination is the value numbering based redundancy
+// elimination, and also hoists the loop invariants, such as the loads of
+// the outer EPs and redefinition flags no helper in the loop may change.
+static const OptimizationStrategy rubyHotStrategyOpts[] =
+   {
+   { OMR::rubyBlockIntrinsicExpansion                                        },
+   { OMR::trivialInlining                                                    },
+   { OMR::rubyIlFastpather                                                   },
+   { OMR::basicBlockExtension                                                },
+   { OMR::localCSE                                                           },
+   { OMR::treeSimplification                                                 },
+   { OMR::localCSE                                                           },
+   { OMR::globalCopyPropagation,                     OMR::IfMoreThanOneBlock  },
+   { OMR::loopCanonicalization,                      OMR::IfLoops             },
+   { OMR::inductionVariableAnalysis,                 OMR::IfLoops             },
+   { OMR::globalValuePropagation,                    OMR::IfMoreThanOneBlock  },
+   { OMR::partialRedundancyElimination,              OMR::IfMoreThanOneBlock  },
+   { OMR::localCSE                                                           },
+   { OMR::treeSimplification                                                 },
+   { OMR::globalCopyPropagation,                     OMR::IfMoreThanOneBlock  },
+   { OMR::localDeadStoreElimination                                          },
+   { OMR::globalDeadStoreGroup                                               },
+   { OMR::isolatedStoreGroup                                                 },
+   { OMR::deadTreesElimination                                               },
+   { OMR::cheapTacticalGlobalRegisterAllocatorGroup                          },
+   { OMR::lowerRubyMacroOps,                         OMR::MustBeDone              },
+   { OMR::endOpts                                                            },
+   };
+
 const OptimizationStrategy *rubyCompilationStrategies[] =
    {
    rubyNoOptStrategyOpts,// only must-be-done opts
    rubyColdStrategyOpts, // <<  specialized
    rubyWarmStrategyOpts, // <<  specialized
+   rubyHotStrategyOpts,  // <<  specialized
    };
 
 
@@ -128,6 +163,9 @@ Ruby::Optimizer::Optimizer(TR::Compilation *comp, TR::ResolvedMethodSymbol *meth
    _opts[OMR::rubyIlFastpather] =
       new (comp->allocator()) TR::OptimizationManager(self(), Ruby::IlFastpather::create, OMR::rubyIlFastpather, "O^O RUBY IL FASTPATHER");
 
+   _opts[OMR::rubyBlockIntrinsicExpansion] =
+      new (comp->allocator()) TR::OptimizationManager(self(), Ruby::BlockIntrinsicExpander::create, OMR::rubyBlockIntrinsicExpansion, "O^O RUBY BLOCK INTRINSIC EXPANSION");
+
    _opts[OMR::lowerRubyMacroOps] =
       new (comp->allocator()) TR::OptimizationManager(self(), Ruby::LowerMacroOps::create, OMR::lowerRubyMacroOps, "O^O LOWER RUBY MACRO OPS");
 
@@ -19,16 +19,28 @@
 
 #include "ruby/optimizer/RubyCallInfo.hpp"
 
+#include <stdlib.h>
+#include <string.h>
+#include "compile/Compilation.hpp"
 #include "compile/SymbolReferenceTable.hpp"
 #include "il/SymbolReference.hpp"
 #include "il/Node_inlines.hpp"
 #include "optimizer/Inliner.hpp"
+#include "ras/DebugCounter.hpp"
+#include "ruby/env/RubyFE.hpp"
 #include "ruby/env/RubyMethod.hpp"
 
 #ifdef RUBY_PROJECT_SPECIFIC
 #include "ruby/config.h" 
 #endif
 
+extern "C" {
+#include "iseq.h"                              // for rb_iseq_original_iseq
+}
+/* Ruby */
+#include "insns.inc"
+#include "insns_info.inc"
+
 TR_CallSite* TR_CallSite::create(TR::TreeTop* tt,
       TR::Node *parent,
       TR::Node *node,
@@ -46,7 +58,7 @@ TR_CallSite* TR_CallSite::create(TR::TreeTop* tt,
       {
       if (node->getSymbolReference() == comp->getSymRefTab()->getSymRef(RubyHelper_vm_send))
          {
-         return new (trMemory, kind) TR_Ruby_Send_CallSite(lCaller,
+         TR_CallSite* callSite = new (trMemory, kind) TR_Ruby_Send_CallSite(lCaller,
                tt,
                parent,
                node,
@@ -60,6 +72,14 @@ TR_CallSite* TR_CallSite::create(TR::TreeTop* tt,
                false,
                node->getByteCodeInfo(),
                comp);
+
+         //The receiver isn't a child of vm_send; ILGen kept it in a temporary
+         //for sends passing a literal block, the only ones we inline.
+         TR::SymbolReference *receiverTemp = comp->getSymRefTab()->getRubySendReceiverTempSymRef(node);
+         if (receiverTemp)
+            comp->getSymRefTab()->setRubyInlinedReceiverTempSymRef(callSite, receiverTemp);
+
+         return callSite;
          }
       else if (node->getSymbolReference() == comp->getSymRefTab()->getSymRef(RubyHelper_vm_invokeblock))
          {
@@ -78,7 +98,25 @@ TR_CallSite* TR_CallSite::create(TR::TreeTop* tt,
                node->getByteCodeInfo(),
                comp);
          }
-      else if (node->getSymbolReference() == comp->getSymRefTab()->getSymRef(RubyHelper_vm_send_without_block))
+      else if (node->getSymbolReference() == comp->getSymRefTab()->getSymRef(RubyHelper_vm_yield_literal_block))
+         {
+         return new (trMemory, kind) TR_Ruby_YieldLiteralBlock_CallSite(lCaller,
+               tt,
+               parent,
+               node,
+               NULL,
+               receiverClass,
+               (int32_t)symRef->getOffset(),
+               symRef->getCPIndex(),
+               resolvedMethod,
+               NULL,
+               node->getOpCode().isCallIndirect(),
+               false,
+               node->getByteCodeInfo(),
+               comp);
+         }
+      else if (node->getSymbolReference() == comp->getSymRefTab()->getSymRef(RubyHelper_vm_send_without_block) ||
+               node->getSymbolReference() == comp->getSymRefTab()->getSymRef(RubyHelper_vm_send_symbol_without_block))
          {
          TR_CallSite* callSite = new (trMemory, kind) TR_Ruby_SendSimple_CallSite(lCaller,
                tt,
@@ -131,60 +169,645 @@ TR_RubyCallSite::findCallSiteTarget (TR_CallStack* callStack, TR_InlinerBase* in
    return false;
    }
 
+/**
+ * Create the resolved method the inliner generates IL for, for `iseq`.
+ */
+static ResolvedRubyMethod *
+createCalleeMethod(TR::Compilation *comp, rb_iseq_t *iseq)
+   {
+   int32_t len =
+         RSTRING_LEN(iseq->location.path) +
+         (sizeof(size_t) * 3) +                // first_lineno: estimate three decimal digits per byte
+         RSTRING_LEN(iseq->location.label) +
+         3;                                    // two colons and a null terminator
+
+   char *name = (char*) comp->trMemory()->allocateHeapMemory(len);
+   sprintf(name, "%s:%lld:%s",
+         (char*) RSTRING_PTR(iseq->location.path),
+         FIX2LONG(iseq->location.first_lineno),
+         (char*)RSTRING_PTR(iseq->location.label));
+
+   RubyMethodBlock* callee_mb = new (comp->trPersistentMemory()) RubyMethodBlock(iseq, name);
+   return new (comp->trPersistentMemory()) ResolvedRubyMethod(*callee_mb);
+   }
+
 bool
 TR_Ruby_Send_CallSite::findCallSiteTarget (TR_CallStack* callStack, TR_InlinerBase* inliner)
    {
-   return false;
+   if (!TR_Ruby_SendSimple_CallSite::findCallSiteTarget(callStack, inliner))
+      return false;
+
+   rb_call_info_t *ci = (rb_call_info_t *) _callNode->getSecondChild()->getAddress();
+
+   //Each inlined callee pushes its frame with the literal block, so a yield
+   //in its body always calls that block.
+   for (int32_t i = 0; i < numTargets(); i++)
+      comp()->getSymRefTab()->setRubyInlinedBlockISeq(getTarget(i)->_calleeMethod, ci->blockiseq);
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send/inlined_with_block"));
+   return true;
+   }
+
+/**
+ * Add an unguarded target inlining `blockiseq` at `callSite`, if the
+ * inlining policy admits it.
+ */
+static bool
+addBlockTarget(TR_CallSite *callSite, TR_InlinerBase* inliner, TR_CallStack *callStack, rb_iseq_t *blockiseq,
+               TR_RubyInliningPolicy::SiteHotness hotness)
+   {
+   TR::Compilation *comp = callSite->comp();
+   if (!TR_RubyInliningPolicy::admitCallee(comp, callStack, hotness, blockiseq))
+      return false;
+
+   ResolvedRubyMethod* block_method = createCalleeMethod(comp, blockiseq);
+   callSite->_initialCalleeMethod = block_method;
+   callSite->_initialCalleeSymbol = TR::ResolvedMethodSymbol::createJittedMethodSymbol(comp->trHeapMemory(), block_method, comp);
+
+   TR_VirtualGuardSelection *guard = new (comp->trHeapMemory()) TR_VirtualGuardSelection(TR_NoGuard);
+   callSite->addTarget(comp->trMemory(),
+         inliner,
+         guard,
+         block_method,
+         block_method->classOfMethod(),
+         heapAlloc);
+   return true;
    }
 
+/**
+ * The block frame is pushed by vm_invokeblock_jit_inline_frame and popped by
+ * the block's own leave, just as an inlined method's is, so the block's
+ * parameters must be filled without any of the block argument massaging:
+ * arity must match exactly and a single argument must not be auto-splatted.
+ */
+int
+TR_Ruby_InvokeBlock_CallSite::checkInlineableBlock(TR::Compilation *comp, int32_t argc, rb_iseq_t *blockiseq)
+   {
+   if (blockiseq->param.flags.has_opt    ||
+       blockiseq->param.flags.has_rest   ||
+       blockiseq->param.flags.has_post   ||
+       blockiseq->param.flags.has_block  ||
+       blockiseq->param.flags.has_kw     ||
+       blockiseq->param.flags.has_kwrest)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/invokeblock/notInlineable/has_opt_args"));
+      return Ruby_has_opt_args;
+      }
+
+   if (blockiseq->param.lead_num != argc ||
+       (argc == 1 && !blockiseq->param.flags.ambiguous_param0))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/invokeblock/notInlineable/arity_mismatch"));
+      return Ruby_has_opt_args;
+      }
+
+   //Every block has redo and next entries, unwound to only by a throw of the
+   //block itself, which is rejected below; ILGen adds no targets for them.
+   //Break entries are unwound to by the blocks the block passes, and as for
+   //an inlined method, ILGen aborts the compilation on a non-zero sp.
+   //Rescue and ensure are out.
+   for (int i = 0; blockiseq->catch_table && i < blockiseq->catch_table->size; i++)
+      {
+      struct iseq_catch_table_entry &entry = blockiseq->catch_table->entries[i];
+      if (entry.iseq ||
+          (entry.type != iseq_catch_table_entry::CATCH_TYPE_BREAK &&
+           entry.type != iseq_catch_table_entry::CATCH_TYPE_NEXT &&
+           entry.type != iseq_catch_table_entry::CATCH_TYPE_REDO) ||
+          (entry.type == iseq_catch_table_entry::CATCH_TYPE_BREAK && entry.sp != 0))
+         {
+         TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/invokeblock/notInlineable/non_zero_catchtable"));
+         return Ruby_non_zero_catchtable;
+         }
+      }
+
+   //break, next from a lambda and return unwind through frames that do not
+   //exist once the block is inlined.
+   const VALUE *insns = rb_iseq_original_iseq(blockiseq);
+   for (unsigned long i = 0; i < blockiseq->iseq_size; i += insn_len(insns[i]))
+      {
+      if (insns[i] == BIN(throw))
+         {
+         TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/invokeblock/notInlineable/throw"));
+         return Ruby_unsupported_calltype;
+         }
+      }
+
+   return InlineableTarget;
+   }
+
+/**
+ * Inline the block of a yield whose method was inlined into a send passing a
+ * literal block. No guard is needed: that inlined copy of the method is only
+ * entered from the send, whose block it pushed with its frame.
+ */
 bool
 TR_Ruby_InvokeBlock_CallSite::findCallSiteTarget (TR_CallStack* callStack, TR_InlinerBase* inliner)
    {
-   return false;
+   rb_iseq_t *blockiseq = comp()->getSymRefTab()->getRubyInlinedBlockISeq(callStack->_method);
+   if (!blockiseq)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/invokeblock/notInlineable/unknown_block"));
+      return false;
+      }
+
+   rb_call_info_t *ci = (rb_call_info_t *) _callNode->getSecondChild()->getAddress();
+   if (checkInlineableBlock(comp(), ci->orig_argc, blockiseq) != InlineableTarget)
+      return false;
+
+   if (!addBlockTarget(this, inliner, callStack, blockiseq, TR_RubyInliningPolicy::WarmSite))
+      return false;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/invokeblock/inlineable"));
+   return true;
+   }
+
+/**
+ * The block is the send's own literal block, so no guard is needed.
+ */
+bool
+TR_Ruby_YieldLiteralBlock_CallSite::findCallSiteTarget (TR_CallStack* callStack, TR_InlinerBase* inliner)
+   {
+   rb_call_info_t *ci = (rb_call_info_t *) _callNode->getSecondChild()->getAddress();
+   if (TR_Ruby_InvokeBlock_CallSite::checkInlineableBlock(comp(), 1, ci->blockiseq) != InlineableTarget)
+      return false;
+
+   //The yield runs on every iteration of its loop.
+   if (!addBlockTarget(this, inliner, callStack, ci->blockiseq, TR_RubyInliningPolicy::HotSite))
+      return false;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/yield_literal_block/inlineable"));
+   return true;
+   }
+
+
+/**
+ * The VM keeps two receiver classes per call info: profiled_klass, when built
+ * with OMR_JIT_PROFILING, which is Qnil once the site has seen a second
+ * class, and the class its inline cache was last filled for. The profiled
+ * class is reported first. The cached class is added when the cache is still
+ * current and holds a different class, so a site the cache was refilled at
+ * after its profile was taken gets both.
+ */
+int32_t
+TR_Ruby_SendSimple_CallSite::getProfiledClasses(rb_call_info_t *ci, VALUE (&classes)[MaxProfiledClasses])
+   {
+   auto *jitInterface = TR_RubyFE::instance()->getJitInterface();
+   int32_t numClasses = 0;
+
+#ifdef OMR_JIT_PROFILING
+   VALUE profiled = ci->profiled_klass;
+   if (profiled != Qnil && profiled != Qundef && profiled != 0)
+      classes[numClasses++] = profiled;
+#endif
+
+   VALUE cached = ci->klass;
+   if (cached && ci->me &&
+       ci->method_state == *jitInterface->globals.ruby_vm_global_method_state_ptr &&
+       ci->class_serial == jitInterface->callbacks.rb_class_serial_f(cached) &&
+       (numClasses == 0 || classes[0] != cached))
+      classes[numClasses++] = cached;
+
+   return numClasses;
+   }
+
+int
+TR_Ruby_SendSimple_CallSite::checkInlineableClass(TR::Compilation *comp, rb_call_info_t *ci, VALUE klass)
+   {
+/*
+ * Preconditions:
+ *     true == (ci->me->def->type == VM_METHOD_TYPE_ISEQ)
+ *             If its not a proper Ruby method, all bets are off.
+ *     Lead and optional parameters only.
+ *             With optional parameters vm_callee_setup_arg starts the frame at (ci->aux.opt_pc != 0),
+ *             which the inlined body's entry switch selects; see Ruby::InlinerUtil::calleeTreeTopPreMergeActions.
+ *     false == (ci->flag & VM_CALL_TAILCALL)
+ *             Here we're handling the case of normal calls via vm_call_iseq_setup_normal.
+ *             For TailCalls we will need to work with vm_call_iseq_setup_tailcall.
+ *             The JIT currently doesn't compile methods of type VM_CALL_TAILCALL.
+ */
+#ifdef OMR_RUBY_VALID_CLASS
+   if(!TR_RubyFE::instance()->getJitInterface()->callbacks.ruby_omr_is_valid_object_f(klass))
+#endif
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/invalid_klass"));
+      return Ruby_invalid_klass;
+      }
+
+   VALUE actual_klass;
+   rb_method_entry_t *me = (rb_method_entry_t*)TR_RubyFE::instance()->getJitInterface()->callbacks.rb_method_entry_f(klass, ci->mid, &actual_klass);
+
+   if(!me)
+     {
+     TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/missing_method_entry"));
+     return Ruby_missing_method_entry;
+     }
+
+   //Private methods are only reachable by sends without an explicit receiver
+   //(FCALL), and the VM has already resolved those at this site. Protected
+   //methods also need the caller's self to be a kind of the defining class,
+   //which we only know holds for FCALLs.
+   bool isFCall = (ci->flag & (VM_CALL_FCALL | VM_CALL_VCALL)) != 0;
+   int visibility = me->flag & NOEX_MASK;
+   if (visibility != NOEX_PUBLIC && !isFCall)
+     {
+     TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/%s_without_fcall",
+                                                                                    visibility == NOEX_PRIVATE ? "private" : "protected"));
+     return Ruby_unsupported_method_entry_flag;
+     }
+
+   //Anything but visibility, NOEX_BASIC and NOEX_NOSUPER, such as a $SAFE
+   //level, is left to the VM.
+   if((me->flag & ~(NOEX_MASK | NOEX_BASIC | NOEX_NOSUPER)) != 0)
+     {
+     char flag[15];
+     snprintf(flag, 15, "0x%x", me->flag);
+     TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/unsupported_method_entry_flag/%s", flag));
+     return Ruby_unsupported_method_entry_flag;
+     }
+
+   char methodName[64];
+   snprintf(methodName, 64, "%s", TR_RubyFE::instance()->getJitInterface()->callbacks.rb_id2name_f(ci->mid));
+   char klassName[64];
+   snprintf(klassName, 64, "%s", TR_RubyFE::instance()->getJitInterface()->callbacks.rb_class2name_f(klass));
+
+   //If this isn't a proper Ruby method, don't inline.
+   switch(me->def->type)
+      {
+      case VM_METHOD_TYPE_ISEQ:
+         break;
+      case VM_METHOD_TYPE_CFUNC:
+         if (getInlineableInitialize(comp, ci, klass, me, NULL, NULL))
+            return InlineableTarget;
+         TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/inlining_cfunc/%s/%s", klassName,methodName));
+         return Ruby_inlining_cfunc;
+      default:
+         TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/inlining_non_iseq_method/%s/%s", klassName,methodName));
+         return Ruby_non_iseq_method;
+      }
+
+   rb_iseq_t *iseq_callee = me->def->body.iseq;
+
+
+   //Check if the callee has complex parameters. Optional parameters are
+   //supported when the site passes enough arguments for the lead ones and no
+   //more than all of them.
+   bool check_arg_opts     = (iseq_callee->param.flags.has_opt    != 0) &&
+                             (ci->orig_argc < iseq_callee->param.lead_num ||
+                              ci->orig_argc > iseq_callee->param.lead_num + iseq_callee->param.opt_num);
+   bool check_arg_rest     = (iseq_callee->param.flags.has_rest   != 0);
+   bool check_arg_post_len = (iseq_callee->param.flags.has_post   != 0);
+   bool check_arg_block    = (iseq_callee->param.flags.has_block  != 0);
+   bool check_arg_keywords = (iseq_callee->param.flags.has_kw     != 0);
+   bool check_arg_kwrest   = (iseq_callee->param.flags.has_kwrest != 0);
+
+   if ( check_arg_opts      ||
+       check_arg_rest      ||
+       check_arg_post_len  ||
+       check_arg_block     ||
+       check_arg_keywords ||
+       check_arg_kwrest
+       )
+     {
+     if (check_arg_kwrest)
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_kwrest"));
+     if (check_arg_opts)
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_opts_argc"));
+     if (check_arg_rest)
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_rest"));
+     if (check_arg_post_len)
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_post_len"));
+     if (check_arg_block)
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_block"));
+     if (check_arg_keywords)
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_keywords"));
+
+     return Ruby_has_opt_args;
+     }
+
+   //The inlined callee keeps its own frame, so an exception raised in it is
+   //handled by the VM against the callee's catch table just as when it is
+   //called, the caller resuming through its entry switch. Only local entries
+   //with a non-zero sp are out: ILGen aborts the compilation on them.
+   for (int i = 0; iseq_callee->catch_table && i < iseq_callee->catch_table->size; i++)
+     {
+     struct iseq_catch_table_entry &entry = iseq_callee->catch_table->entries[i];
+     if (!entry.iseq && entry.sp != 0)
+        {
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/non_zero_sp_catch_entry"));
+        return Ruby_non_zero_catchtable;
+        }
+     }
+
+   return InlineableTarget;
+   }
+
+/**
+ * Check that `sendCi`, a send, __send__ or public_send of a literal symbol,
+ * finds the method of Kernel, or of BasicObject for __send__, for receivers
+ * of class `klass`.
+ */
+bool
+TR_Ruby_SendSimple_CallSite::isKernelSend(TR::Compilation *comp, rb_call_info_t *sendCi, VALUE klass)
+   {
+   auto &callbacks = TR_RubyFE::instance()->getJitInterface()->callbacks;
+   const char *methodName = callbacks.rb_id2name_f(sendCi->mid);
+   auto &globals = TR_RubyFE::instance()->getJitInterface()->globals;
+   VALUE definingModule = methodName && !strcmp(methodName, "__send__") ? *globals.ruby_rb_cBasicObject_ptr : *globals.ruby_rb_mKernel_ptr;
+
+   VALUE defined_class;
+   rb_method_entry_t *me = (rb_method_entry_t*)callbacks.rb_method_entry_f(klass, sendCi->mid, &defined_class);
+   if (!me || me->klass != definingModule ||
+       (me->def->type != VM_METHOD_TYPE_OPTIMIZED && me->def->type != VM_METHOD_TYPE_CFUNC))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_symbol/notInlineable/send_redefined"));
+      return false;
+      }
+   return true;
    }
 
+/**
+ * Add an inlining target, each under its own class guard, for the most
+ * frequent inlineable receiver classes of the site. The inliner chains the
+ * guards, leaving the original send as the fallback.
+ */
 bool
 TR_Ruby_SendSimple_CallSite::findCallSiteTarget (TR_CallStack* callStack, TR_InlinerBase* inliner)
    {
    //Landing here implies TR_RubyFE::checkInlineableWithoutInitialCalleeSymbol did all the checks and
-   //decided this callSite was a valid inlineable target.
+   //decided at least one receiver class of this callSite was a valid inlineable target.
 
    TR::Node* node = _callNode;
 
    //Ensure that ILGen hasn't changed the children's layout we expect.
-   TR_ASSERT(  ((node->getNumChildren() == 3) &&
+   TR_ASSERT(  ((node->getNumChildren() >= 3) &&
          node->getSecondChild() &&
          node->getSecondChild()->getOpCodeValue() == TR::aconst), "Unexpected children in hierarchy of vm_send_without_block when creating callsite target.");
 
    rb_call_info_t *ci = (rb_call_info_t *) node->getSecondChild()->getAddress();
-#ifdef OMR_JIT_PROFILING
-   VALUE klass = ci->profiled_klass;
-#else
-   VALUE klass = Qundef; 
-#endif
+
+   //A send of a literal symbol is dispatched directly only while `send`
+   //finds Kernel's, which is what inlining the symbol's method assumes.
+   rb_call_info_t *sendCi = NULL;
+   if (node->getSymbolReference() == comp()->getSymRefTab()->getSymRef(RubyHelper_vm_send_symbol_without_block))
+      sendCi = (rb_call_info_t *) node->getChild(3)->getAddress();
+
+   static const char *maxTargetsEnv = feGetEnv("OMR_RUBY_MAX_POLYMORPHIC_TARGETS");
+   static const int32_t maxTargets  = maxTargetsEnv ? atoi(maxTargetsEnv) : 3;
+
+   TR_RubyInliningPolicy::SiteHotness hotness = TR_RubyInliningPolicy::getSiteHotness(ci);
+   if (hotness == TR_RubyInliningPolicy::ColdSite)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/notInlineable/cold_site"));
+      return false;
+      }
+
+   VALUE classes[MaxProfiledClasses];
+   int32_t numClasses = getProfiledClasses(ci, classes);
+
+   for (int32_t i = 0; i < numClasses && numTargets() < maxTargets; i++)
+      {
+      VALUE klass = classes[i];
+
+      if (sendCi && !isKernelSend(comp(), sendCi, klass))
+         continue;
+
+      if (checkInlineableClass(comp(), ci, klass) != InlineableTarget)
+         continue;
+
+      addClassTarget(inliner, callStack, ci, klass, hotness);
+      }
+
+   if (numTargets() > 1)
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/polymorphic/%d", numTargets()));
+
+   return numTargets() > 0;
+   }
+
+/**
+ * A callee runs without a frame of its own if nothing but its helper calls
+ * can observe the frame: no catch table to unwind to, locals of its own
+ * frame only, no block, and instructions whose slow paths are plain helper
+ * calls. Sends, yields and throws are left to framed inlining.
+ *
+ * The send must pass exactly the parameters of the callee, which its locals
+ * are initialized from. A send with the wrong number of arguments raises
+ * ArgumentError from the frame push that is skipped here.
+ */
+bool
+TR_Ruby_SendSimple_CallSite::checkFramelessCallee(TR::Compilation *comp, rb_call_info_t *ci, rb_iseq_t *iseq)
+   {
+   static const char *disableFrameless = feGetEnv("OMR_RUBY_DISABLE_FRAMELESS_INLINING");
+   if (disableFrameless)
+      return false;
+
+   if (iseq->catch_table != 0           ||
+       iseq->param.flags.has_opt        ||
+       iseq->param.flags.has_rest       ||
+       iseq->param.flags.has_post       ||
+       iseq->param.flags.has_block      ||
+       iseq->param.flags.has_kw         ||
+       iseq->param.flags.has_kwrest)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/framed/signature"));
+      return false;
+      }
+
+   if (iseq->param.lead_num != ci->orig_argc)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/framed/arity"));
+      return false;
+      }
+
+   const VALUE *insns = rb_iseq_original_iseq(iseq);
+   for (unsigned long i = 0; i < iseq->iseq_size; i += insn_len(insns[i]))
+      {
+      switch (insns[i])
+         {
+         case BIN(getlocal):
+         case BIN(setlocal):
+            if (insns[i + 2] == 0)
+               break;
+            TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/framed/outer_local"));
+            return false;
+
+         case BIN(nop):
+         case BIN(trace):
+         case BIN(getlocal_OP__WC__0):
+         case BIN(setlocal_OP__WC__0):
+         case BIN(getinstancevariable):
+         case BIN(setinstancevariable):
+         case BIN(putnil):
+         case BIN(putobject):
+         case BIN(putobject_OP_INT2FIX_O_0_C_):
+         case BIN(putobject_OP_INT2FIX_O_1_C_):
+         case BIN(putself):
+         case BIN(putstring):
+         case BIN(pop):
+         case BIN(dup):
+         case BIN(dupn):
+         case BIN(swap):
+         case BIN(reput):
+         case BIN(topn):
+         case BIN(setn):
+         case BIN(adjuststack):
+         case BIN(newarray):
+         case BIN(duparray):
+         case BIN(leave):
+         case BIN(jump):
+         case BIN(branchif):
+         case BIN(branchunless):
+         case BIN(opt_plus):
+         case BIN(opt_minus):
+         case BIN(opt_mult):
+         case BIN(opt_div):
+         case BIN(opt_mod):
+         case BIN(opt_eq):
+         case BIN(opt_neq):
+         case BIN(opt_lt):
+         case BIN(opt_le):
+         case BIN(opt_gt):
+         case BIN(opt_ge):
+         case BIN(opt_ltlt):
+         case BIN(opt_not):
+         case BIN(opt_aref):
+         case BIN(opt_aset):
+         case BIN(opt_aref_with):
+         case BIN(opt_aset_with):
+         case BIN(opt_length):
+         case BIN(opt_size):
+         case BIN(opt_empty_p):
+         case BIN(opt_succ):
+            break;
+
+         default:
+            TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/framed/%s", insn_name(insns[i])));
+            return false;
+         }
+      }
+
+   return true;
+   }
+
+/**
+ * Class#new allocates and then sends initialize through the interpreter. For
+ * a class using the default allocator, whose initialize can be inlined
+ * without a frame, the send is inlined as a call to rb_obj_alloc followed by
+ * the body of initialize instead.
+ *
+ * The receiver is the class itself, the single instance of the singleton
+ * class profiled at the site.
+ */
+rb_method_entry_t *
+TR_Ruby_SendSimple_CallSite::getInlineableInitialize(TR::Compilation *comp, rb_call_info_t *ci, VALUE klass, rb_method_entry_t *newMe,
+                                                     VALUE *instanceKlass, VALUE *definedClass)
+   {
+   static const char *disableClassNew = feGetEnv("OMR_RUBY_DISABLE_CLASS_NEW_INLINING");
+   if (disableClassNew || ci->blockiseq)
+      return NULL;
+
+   auto &callbacks = TR_RubyFE::instance()->getJitInterface()->callbacks;
+   const char *klassName  = callbacks.rb_class2name_f(newMe->klass);
+   const char *methodName = callbacks.rb_id2name_f(ci->mid);
+   if (!klassName || !methodName || strcmp(klassName, "Class") || strcmp(methodName, "new"))
+      return NULL;
+
+   if (!FL_TEST(klass, FL_SINGLETON))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/class_new/notInlineable/not_singleton"));
+      return NULL;
+      }
+
+   VALUE instance = callbacks.rb_attr_get_f(klass, callbacks.rb_intern_f("__attached__"));
+   if (!RB_TYPE_P(instance, T_CLASS))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/class_new/notInlineable/not_class"));
+      return NULL;
+      }
+
+   //Objects of other allocators may need initialization from C that the
+   //inlined initialize would not see.
+   VALUE objectClass = *TR_RubyFE::instance()->getJitInterface()->globals.ruby_rb_cObject_ptr;
+   if (callbacks.rb_get_alloc_func_f(instance) != callbacks.rb_get_alloc_func_f(objectClass))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/class_new/notInlineable/custom_allocator"));
+      return NULL;
+      }
+
+   VALUE defined_class;
+   rb_method_entry_t *me = (rb_method_entry_t*)callbacks.rb_method_entry_f(instance, callbacks.rb_intern_f("initialize"), &defined_class);
+   if (!me || me->def->type != VM_METHOD_TYPE_ISEQ)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/class_new/notInlineable/initialize_not_iseq"));
+      return NULL;
+      }
+
+   rb_iseq_t *iseq = me->def->body.iseq;
+   if (!checkFramelessCallee(comp, ci, iseq))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/class_new/notInlineable/initialize_not_frameless"));
+      return NULL;
+      }
+
+   if (instanceKlass)
+      *instanceKlass = instance;
+   if (definedClass)
+      *definedClass = defined_class;
+   return me;
+   }
+
+/**
+ * Add a target for sends of `ci` to receivers of class `klass`, if the
+ * inlining policy admits the callee.
+ */
+bool
+TR_Ruby_SendSimple_CallSite::addClassTarget(TR_InlinerBase* inliner, TR_CallStack *callStack, rb_call_info_t *ci, VALUE klass,
+                                            TR_RubyInliningPolicy::SiteHotness hotness)
+   {
    VALUE actual_klass;
    rb_method_entry_t *me = (rb_method_entry_t*)TR_RubyFE::instance()->getJitInterface()->callbacks.rb_method_entry_f(klass, ci->mid, &actual_klass);
-   rb_iseq_t *iseq_callee = me->def->body.iseq;
 
-   int32_t len =
-         RSTRING_LEN(iseq_callee->location.path) +
-         (sizeof(size_t) * 3) +                // first_lineno: estimate three decimal digits per byte
-         RSTRING_LEN(iseq_callee->location.label) +
-         3;                                    // two colons and a null terminator
+   //checkInlineableClass only admits C methods that are Class#new.
+   VALUE instanceKlass = 0;
+   if (me->def->type == VM_METHOD_TYPE_CFUNC)
+      me = getInlineableInitialize(comp(), ci, klass, me, &instanceKlass, &actual_klass);
 
-   char *name = (char*) comp()->trMemory()->allocateHeapMemory(len);
-   sprintf(name, "%s:%lld:%s",
-         (char*) RSTRING_PTR(iseq_callee->location.path),
-         FIX2LONG(iseq_callee->location.first_lineno),
-         (char*)RSTRING_PTR(iseq_callee->location.label));
+   if (!TR_RubyInliningPolicy::admitCallee(comp(), callStack, hotness, me->def->body.iseq))
+      return false;
+
+   ResolvedRubyMethod* callee_method = createCalleeMethod(comp(), me->def->body.iseq);
 
-   RubyMethodBlock* callee_mb = new (comp()->trPersistentMemory()) RubyMethodBlock(iseq_callee, name);
-   ResolvedRubyMethod* callee_method = new (comp()->trPersistentMemory()) ResolvedRubyMethod(*callee_mb);
-   TR::ResolvedMethodSymbol *calleeSymbol = TR::ResolvedMethodSymbol::createJittedMethodSymbol(comp()->trHeapMemory(), callee_method, comp());
+   //The most frequent class provides the initial callee.
+   if (!_initialCalleeMethod)
+      {
+      _initialCalleeMethod = callee_method;
+      _initialCalleeSymbol = TR::ResolvedMethodSymbol::createJittedMethodSymbol(comp()->trHeapMemory(), callee_method, comp());
+      }
 
-   //Set ResolvedMethod and ResolvedMethodSymbol.
-   _initialCalleeMethod = callee_method;
-   _initialCalleeSymbol = calleeSymbol;
+   //The initialize of Class#new runs on the object allocated for it.
+   if (instanceKlass)
+      {
+      TR_RubyVirtualFrame *frame = new (comp()->trHeapMemory()) TR_RubyVirtualFrame(me, actual_klass, me->def->body.iseq,
+                                                                                    comp()->getSymRefTab()->createTemporary(callStack->_methodSymbol, TR_RubyFE::slotType()),
+                                                                                    comp()->getSymRefTab()->getRubySendArgumentTempSymRefs(_callNode));
+      frame->_classTemp     = comp()->getSymRefTab()->getRubyInlinedReceiverTempSymRef(this);
+      frame->_instanceClass = instanceKlass;
+      frame->_classSerial   = TR_RubyFE::instance()->getJitInterface()->callbacks.rb_class_serial_f(instanceKlass);
+      frame->_methodState   = *TR_RubyFE::instance()->getJitInterface()->globals.ruby_vm_global_method_state_ptr;
+      comp()->getSymRefTab()->setRubyVirtualFrame(callee_method, frame);
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/class_new/inlineable"));
+      }
+   //Sends without a block kept their arguments in temps, so a leaf callee
+   //can run off them without a frame of its own.
+   else if ((_callNode->getSymbolReference() == comp()->getSymRefTab()->getSymRef(RubyHelper_vm_send_without_block) ||
+             _callNode->getSymbolReference() == comp()->getSymRefTab()->getSymRef(RubyHelper_vm_send_symbol_without_block)) &&
+            checkFramelessCallee(comp(), ci, me->def->body.iseq))
+      {
+      TR_RubyVirtualFrame *frame = new (comp()->trHeapMemory()) TR_RubyVirtualFrame(me, actual_klass, me->def->body.iseq,
+                                                                                    comp()->getSymRefTab()->getRubyInlinedReceiverTempSymRef(this),
+                                                                                    comp()->getSymRefTab()->getRubySendArgumentTempSymRefs(_callNode));
+      comp()->getSymRefTab()->setRubyVirtualFrame(callee_method, frame);
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/frameless"));
+      }
 
    //Add a target for inliner to process.
    TR_VirtualGuardSelection *guard = new (comp()->trHeapMemory()) TR_VirtualGuardSelection(TR_ProfiledGuard, TR_RubyInlineTest, (TR_OpaqueClassBlock *) klass);
@@ -193,8 +816,102 @@ TR_Ruby_SendSimple_CallSite::findCallSiteTarget (TR_CallStack* callStack, TR_Inl
    addTarget(comp()->trMemory(),
          inliner,
          guard,
-         _initialCalleeMethod,
-         _initialCalleeMethod->classOfMethod(),
+         callee_method,
+         callee_method->classOfMethod(),
          heapAlloc);
    return true;
    }
+
+/**
+ * The VM does not count sends per site, so a send is only known to be cold
+ * when neither its profile nor its inline cache has a receiver class: it was
+ * not reached before its method was compiled. Yields of literal blocks run on
+ * every iteration of their loop and are hot.
+ */
+TR_RubyInliningPolicy::SiteHotness
+TR_RubyInliningPolicy::getSiteHotness(rb_call_info_t *ci)
+   {
+   VALUE classes[TR_Ruby_SendSimple_CallSite::MaxProfiledClasses];
+   if (TR_Ruby_SendSimple_CallSite::getProfiledClasses(ci, classes) == 0)
+      return ColdSite;
+   return WarmSite;
+   }
+
+int32_t
+TR_RubyInliningPolicy::maxCalleeSize(SiteHotness hotness)
+   {
+   static const char *maxSizeEnv = feGetEnv("OMR_RUBY_INLINE_MAX_CALLEE_SIZE");
+   static const int32_t maxSize  = maxSizeEnv ? atoi(maxSizeEnv) : 100;
+   return hotness == HotSite ? maxSize * 4 : maxSize;
+   }
+
+int32_t
+TR_RubyInliningPolicy::maxDepth(SiteHotness hotness)
+   {
+   static const char *maxDepthEnv = feGetEnv("OMR_RUBY_INLINE_MAX_DEPTH");
+   static const int32_t depth     = maxDepthEnv ? atoi(maxDepthEnv) : 2;
+   return hotness == HotSite ? depth * 3 : depth;
+   }
+
+int32_t
+TR_RubyInliningPolicy::initialBudget()
+   {
+   static const char *budgetEnv = feGetEnv("OMR_RUBY_INLINE_BUDGET");
+   static const int32_t budget  = budgetEnv ? atoi(budgetEnv) : 1000;
+   return budget;
+   }
+
+/**
+ * The dumb inliner's bound on a callee, in IL nodes. It backs up the slot
+ * limits, which do not see how many trees an instruction expands into; the
+ * default leaves room for the larger callees hot sites admit.
+ */
+int32_t
+TR_RubyInliningPolicy::maxCalleeNodes()
+   {
+   static const char *maxNodesEnv = feGetEnv("OMR_RUBY_INLINE_MAX_NODES");
+   static const int32_t maxNodes  = maxNodesEnv ? atoi(maxNodesEnv) : 1600;
+   return maxNodes;
+   }
+
+bool
+TR_RubyInliningPolicy::admitCallee(TR::Compilation *comp, TR_CallStack *callStack, SiteHotness hotness, rb_iseq_t *callee)
+   {
+   const char *hotnessName = hotness == HotSite ? "hot" : "warm";
+   int32_t size = callee->iseq_size;
+
+   if (size > maxCalleeSize(hotness))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.inlining/rejected/%s/callee_too_large", hotnessName));
+      return false;
+      }
+
+   //The outermost entry of the call stack is the method being compiled.
+   int32_t depth = -1;
+   for (TR_CallStack *cs = callStack; cs; cs = cs->getNext())
+      depth++;
+   if (depth >= maxDepth(hotness))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.inlining/rejected/%s/too_deep", hotnessName));
+      return false;
+      }
+
+   if (size > comp->getInliningBudget())
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.inlining/rejected/%s/budget_exhausted", hotnessName));
+      return false;
+      }
+
+   TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.inlining/admitted/%s", hotnessName));
+   return true;
+   }
+
+/**
+ * Targets that fail to inline, or that the inliner does not use, are not
+ * charged, so that they do not starve the sites after them.
+ */
+void
+TR_RubyInliningPolicy::chargeInlinedCallee(TR::Compilation *comp, const rb_iseq_t *callee)
+   {
+   comp->setInliningBudget(comp->getInliningBudget() - callee->iseq_size);
+   }
@@ -22,6 +22,45 @@
 
 #include "optimizer/CallInfo.hpp"
 
+#include "vm_core.h"
+
+/**
+ * Profile driven inlining decisions.
+ *
+ * Call sites are classified by what the VM recorded at them. Cold sites were
+ * not reached before their method was compiled and are not inlined; hot sites
+ * may inline larger callees, more deeply. Each
+ * inlined callee is charged to a budget for the whole compilation. Sizes
+ * and the budget are measured in iseq slots.
+ */
+class TR_RubyInliningPolicy
+   {
+   public:
+      enum SiteHotness
+         {
+         ColdSite,
+         WarmSite,
+         HotSite,
+         };
+
+      static SiteHotness getSiteHotness(rb_call_info_t *ci);
+      static int32_t     maxCalleeSize(SiteHotness hotness);
+      static int32_t     maxDepth(SiteHotness hotness);
+      static int32_t     initialBudget();
+      static int32_t     maxCalleeNodes();
+
+      /**
+       * Decide whether `callee` may be inlined at a site of `hotness`.
+       */
+      static bool admitCallee(TR::Compilation *comp, TR_CallStack *callStack, SiteHotness hotness, rb_iseq_t *callee);
+
+      /**
+       * Charge the size of `callee` to the compilation's budget, once it is
+       * inlined.
+       */
+      static void chargeInlinedCallee(TR::Compilation *comp, const rb_iseq_t *callee);
+   };
+
 class TR_RubyCallSite : public  TR_CallSite
    {
    public:
@@ -30,28 +69,95 @@ class TR_RubyCallSite : public  TR_CallSite
 		virtual const char*  name () { return "TR_RubyCallSite"; }
    };
 
-class TR_Ruby_Send_CallSite : public  TR_RubyCallSite
+class TR_Ruby_SendSimple_CallSite : public  TR_RubyCallSite
    {
    public:
-      TR_CALLSITE_INHERIT_CONSTRUCTOR_AND_TR_ALLOC(TR_Ruby_Send_CallSite, TR_RubyCallSite)
+      TR_CALLSITE_INHERIT_CONSTRUCTOR_AND_TR_ALLOC(TR_Ruby_SendSimple_CallSite, TR_RubyCallSite)
       virtual bool findCallSiteTarget (TR_CallStack *callStack, TR_InlinerBase* inliner);
-		virtual const char*  name () { return "TR_Ruby_VM_Send_CallSite"; }
+		virtual const char*  name () { return "TR_Ruby_VM_SendSimple_CallSite"; }
+
+      static const int32_t MaxProfiledClasses = 2;
+
+      /**
+       * Fill `classes` with the receiver classes the VM recorded for `ci`,
+       * profiled class first, and return how many there are.
+       */
+      static int32_t getProfiledClasses(rb_call_info_t *ci, VALUE (&classes)[MaxProfiledClasses]);
+
+      /**
+       * Check whether a send of `ci` to a receiver of class `klass` can be
+       * inlined. Returns InlineableTarget or the reason it cannot be.
+       */
+      static int checkInlineableClass(TR::Compilation *comp, rb_call_info_t *ci, VALUE klass);
+
+      /**
+       * Check whether `iseq` can be inlined at a send of `ci` without pushing
+       * a control frame: it takes exactly the arguments passed, and its body
+       * reaches the VM only through calls around which Ruby::LowerMacroOps
+       * materializes one.
+       */
+      static bool checkFramelessCallee(TR::Compilation *comp, rb_call_info_t *ci, rb_iseq_t *iseq);
+
+      /**
+       * For a send of Class#new `newMe` to the class whose singleton class
+       * is `klass`, find the initialize to inline in its place. Returns its
+       * method entry, or NULL if the send cannot be inlined that way.
+       */
+      static rb_method_entry_t *getInlineableInitialize(TR::Compilation *comp, rb_call_info_t *ci, VALUE klass, rb_method_entry_t *newMe,
+                                                        VALUE *instanceKlass, VALUE *definedClass);
+
+      /**
+       * Check whether the send `sendCi` of a literal symbol, rewritten by
+       * ILGen into a direct send, finds Kernel's for receivers of `klass`.
+       */
+      static bool isKernelSend(TR::Compilation *comp, rb_call_info_t *sendCi, VALUE klass);
+
+   private:
+      bool addClassTarget(TR_InlinerBase* inliner, TR_CallStack *callStack, rb_call_info_t *ci, VALUE klass,
+                          TR_RubyInliningPolicy::SiteHotness hotness);
    };
 
-class TR_Ruby_SendSimple_CallSite : public  TR_RubyCallSite
+/**
+ * A send passing a literal block. Targets are chosen as for sends without a
+ * block; each inlined callee remembers the block so that its yields can be
+ * inlined too.
+ */
+class TR_Ruby_Send_CallSite : public  TR_Ruby_SendSimple_CallSite
    {
    public:
-      TR_CALLSITE_INHERIT_CONSTRUCTOR_AND_TR_ALLOC(TR_Ruby_SendSimple_CallSite, TR_RubyCallSite)
+      TR_CALLSITE_INHERIT_CONSTRUCTOR_AND_TR_ALLOC(TR_Ruby_Send_CallSite, TR_Ruby_SendSimple_CallSite)
       virtual bool findCallSiteTarget (TR_CallStack *callStack, TR_InlinerBase* inliner);
-		virtual const char*  name () { return "TR_Ruby_VM_SendSimple_CallSite"; }
+		virtual const char*  name () { return "TR_Ruby_VM_Send_CallSite"; }
    };
 
+/**
+ * A yield. It is inlined when its method has itself been inlined into a send
+ * passing a literal block, in which case the block is known.
+ */
 class TR_Ruby_InvokeBlock_CallSite : public  TR_RubyCallSite
    {
    public:
       TR_CALLSITE_INHERIT_CONSTRUCTOR_AND_TR_ALLOC(TR_Ruby_InvokeBlock_CallSite, TR_RubyCallSite)
       virtual bool findCallSiteTarget (TR_CallStack *callStack, TR_InlinerBase* inliner);
 		virtual const char*  name () { return "TR_Ruby_VM_InvokeBlock_CallSite"; }
+
+      /**
+       * Check whether the block `blockiseq` can be inlined at a yield of
+       * `argc` arguments. Returns InlineableTarget or the reason it cannot be.
+       */
+      static int checkInlineableBlock(TR::Compilation *comp, int32_t argc, rb_iseq_t *blockiseq);
+   };
+
+/**
+ * A yield of one argument to the literal block of a send, made by the loops
+ * the IL fastpather expands core iterators into.
+ */
+class TR_Ruby_YieldLiteralBlock_CallSite : public  TR_RubyCallSite
+   {
+   public:
+      TR_CALLSITE_INHERIT_CONSTRUCTOR_AND_TR_ALLOC(TR_Ruby_YieldLiteralBlock_CallSite, TR_RubyCallSite)
+      virtual bool findCallSiteTarget (TR_CallStack *callStack, TR_InlinerBase* inliner);
+		virtual const char*  name () { return "TR_Ruby_VM_YieldLiteralBlock_CallSite"; }
    };
 
 #endif /*RUBY_CALLINFO_INCL*/
@@ -0,0 +1,420 @@
+/*******************************************************************************
+ *
+ * (c) Copyright IBM Corp. 2000, 2016
+ *
+ *  This program and the accompanying materials are made available
+ *  under the terms of the Eclipse Public License v1.0 and
+ *  Apache License v2.0 which accompanies this distribution.
+ *
+ *      The Eclipse Public License is available at
+ *      http://www.eclipse.org/legal/epl-v10.html
+ *
+ *      The Apache License v2.0 is available at
+ *      http://www.opensource.org/licenses/apache2.0.php
+ *
+ * Contributors:
+ *    Multiple authors (IBM Corp.) - initial implementation and documentation
+ *******************************************************************************/
+
+
+#include "optimizer/RubyDeadStackStoreElimination.hpp"
+
+#include "il/Node.hpp"
+#include "il/Node_inlines.hpp"
+#include "il/Block.hpp"
+#include "il/TreeTop.hpp"
+#include "il/TreeTop_inlines.hpp"
+#include "infra/Cfg.hpp"
+#include "infra/CfgNode.hpp"
+#include "optimizer/Optimization_inlines.hpp"
+#include "compile/SymbolReferenceTable.hpp"
+#include "ras/DebugCounter.hpp"
+#include "ruby/env/RubyFE.hpp"
+#include "ruby/env/RubyMethod.hpp"
+
+#include "vm_core.h"
+
+#define OPT_DETAILS "O^O RUBYDEADSTACKSTOREELIMINATION: "
+
+Ruby::DeadStackStoreElimination::DeadStackStoreElimination(TR::OptimizationManager *manager)
+   : TR::Optimization(manager),
+     _slots(0, trMemory(), heapAlloc, growable),
+     _untrackedSlots(0, trMemory(), heapAlloc, growable),
+     _bases(0, trMemory(), heapAlloc, growable),
+     _slotBase(NULL)
+   {}
+
+
+/**
+ * Whether a method of this compilation, inlined or not, has a rescue or
+ * ensure catch entry. Those carry an iseq, and resume the interpreter at
+ * their cont with the stack up to their sp, after whichever helper raised:
+ * every slot below that sp is read by any helper that may raise.
+ */
+static bool
+hasHandlerCatchEntries(const rb_iseq_t *iseq)
+   {
+   for (int i = 0; iseq->catch_table && i < iseq->catch_table->size; i++)
+      {
+      if (iseq->catch_table->entries[i].iseq)
+         return true;
+      }
+   return false;
+   }
+
+bool
+Ruby::DeadStackStoreElimination::hasHandlerCatchEntries()
+   {
+   if (::hasHandlerCatchEntries(static_cast<ResolvedRubyMethodBase *>(comp()->getCurrentMethod())->getRubyMethodBlock().iseq()))
+      return true;
+
+   for (int32_t i = 0; i < comp()->getNumInlinedCallSites(); i++)
+      {
+      ResolvedRubyMethodBase *method = static_cast<ResolvedRubyMethodBase *>(comp()->getInlinedResolvedMethod(i));
+      if (::hasHandlerCatchEntries(method->getRubyMethodBlock().iseq()))
+         return true;
+      }
+   return false;
+   }
+
+int32_t
+Ruby::DeadStackStoreElimination::perform()
+   {
+   static const char *disableStackStoreElimination = feGetEnv("OMR_RUBY_DISABLE_STACK_STORE_ELIMINATION");
+   if (disableStackStoreElimination)
+      return 0;
+
+   if (hasHandlerCatchEntries())
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.deadStackStores/skipped/handler_catch_entry"));
+      return 0;
+      }
+
+   TR::SymbolReferenceTable *symRefTab = comp()->getSymRefTab();
+   int32_t numSymRefs = symRefTab->getNumSymRefs();
+
+   _slotBase = (int32_t *) trMemory()->allocateHeapMemory(numSymRefs * sizeof(int32_t));
+   for (int32_t i = 0; i < numSymRefs; i++)
+      _slotBase[i] = -1;
+
+   vcount_t visitCount = comp()->incVisitCount();
+   for (TR::TreeTop *tt = comp()->getStartTree(); tt; tt = tt->getNextTreeTop())
+      collectSlots(tt->getNode(), visitCount);
+
+   _slots -= _untrackedSlots;
+   if (_slots.isEmpty())
+      return 0;
+
+   TR_BitVectorIterator slots(_slots);
+   while (slots.hasMoreElements())
+      _bases.set(_slotBase[slots.getNextElement()]);
+
+   if (trace())
+      traceMsg(comp(), OPT_DETAILS "Analyzing %d stack slots in %s\n", _slots.elementCount(), comp()->signature());
+
+   // Backward liveness of the slots, to a fixed point. Live sets only grow.
+   int32_t numBlocks = cfg()->getNextNodeNumber();
+   TR_BitVector **liveIn = (TR_BitVector **) trMemory()->allocateHeapMemory(numBlocks * sizeof(TR_BitVector *));
+   for (int32_t i = 0; i < numBlocks; i++)
+      liveIn[i] = new (comp()->trHeapMemory()) TR_BitVector(numSymRefs, trMemory(), heapAlloc, growable);
+
+   bool changed = true;
+   while (changed)
+      {
+      changed = false;
+      for (TR::CFGNode *node = cfg()->getFirstNode(); node; node = node->getNext())
+         {
+         TR::Block *block = toBlock(node);
+         TR_BitVector live(numSymRefs, trMemory(), heapAlloc, growable);
+         TR_SuccessorIterator succs(block);
+         for (TR::CFGEdge *edge = succs.getFirst(); edge; edge = succs.getNext())
+            live |= *liveIn[edge->getTo()->getNumber()];
+
+         if (block->getEntry())
+            {
+            bool isDeadStore;
+            for (TR::TreeTop *tt = block->getExit()->getPrevTreeTop(); tt != block->getEntry(); tt = tt->getPrevTreeTop())
+               transferTree(tt->getNode(), live, isDeadStore);
+            }
+
+         live -= *liveIn[block->getNumber()];
+         if (!live.isEmpty())
+            {
+            *liveIn[block->getNumber()] |= live;
+            changed = true;
+            }
+         }
+      }
+
+   // Remove the stores to slots that are dead after them.
+   int32_t removed = 0;
+   for (TR::CFGNode *node = cfg()->getFirstNode(); node; node = node->getNext())
+      {
+      TR::Block *block = toBlock(node);
+      if (!block->getEntry())
+         continue;
+
+      TR_BitVector live(numSymRefs, trMemory(), heapAlloc, growable);
+      TR_SuccessorIterator succs(block);
+      for (TR::CFGEdge *edge = succs.getFirst(); edge; edge = succs.getNext())
+         live |= *liveIn[edge->getTo()->getNumber()];
+
+      TR::TreeTop *prev = NULL;
+      for (TR::TreeTop *tt = block->getExit()->getPrevTreeTop(); tt != block->getEntry(); tt = prev)
+         {
+         prev = tt->getPrevTreeTop();
+
+         bool isDeadStore;
+         transferTree(tt->getNode(), live, isDeadStore);
+         if (isDeadStore &&
+             performTransformation(comp(), "%s Removing dead store [%p] to YARV stack slot #%d\n", OPT_DETAILS, tt->getNode(), tt->getNode()->getSymbolReference()->getReferenceNumber()))
+            {
+            removeStore(tt);
+            removed++;
+            }
+         }
+      }
+
+   if (removed > 0)
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.deadStackStores/removed/%d", removed));
+
+   return removed;
+   }
+
+
+/**
+ * Find the stack slots of the method, and the private SP each is addressed
+ * off.
+ */
+void
+Ruby::DeadStackStoreElimination::collectSlots(TR::Node *node, vcount_t visitCount)
+   {
+   if (node->getVisitCount() == visitCount)
+      return;
+   node->setVisitCount(visitCount);
+
+   for (int32_t i = 0; i < node->getNumChildren(); i++)
+      collectSlots(node->getChild(i), visitCount);
+
+   if (node->getOpCode().hasSymbolReference() &&
+       comp()->getSymRefTab()->isRubyStackSlotSymRef(node->getSymbolReference()))
+      noteSlotAccess(node);
+   }
+
+
+void
+Ruby::DeadStackStoreElimination::noteSlotAccess(TR::Node *node)
+   {
+   int32_t slot = node->getSymbolReference()->getReferenceNumber();
+   TR::Node *base = node->getNumChildren() > 0 ? node->getFirstChild() : NULL;
+
+   if (!base ||
+       !(node->getOpCode().isLoadIndirect() || node->getOpCode().isStoreIndirect()) ||
+       !base->getOpCode().isLoadVarDirect() ||
+       !base->getSymbolReference()->getSymbol()->isAuto())
+      {
+      _untrackedSlots.set(slot);
+      return;
+      }
+
+   int32_t baseRef = base->getSymbolReference()->getReferenceNumber();
+   if (_slotBase[slot] == -1)
+      _slotBase[slot] = baseRef;
+   else if (_slotBase[slot] != baseRef)
+      _untrackedSlots.set(slot);
+
+   _slots.set(slot);
+   }
+
+
+/**
+ * Apply the effect of the tree `node` on the slots live after it, and say
+ * whether it stores to a slot that is dead after it.
+ */
+void
+Ruby::DeadStackStoreElimination::transferTree(TR::Node *node, TR_BitVector &live, bool &isDeadStore)
+   {
+   isDeadStore = false;
+
+   if (isTrackedStore(node))
+      {
+      int32_t slot = node->getSymbolReference()->getReferenceNumber();
+      isDeadStore = !live.isSet(slot);
+      live.reset(slot);
+      genLoads(node->getSecondChild(), live, comp()->incOrResetVisitCount());
+      return;
+      }
+
+   // The slots of a moved private SP are other locations.
+   if (node->getOpCode().isStoreDirect() &&
+       _bases.isSet(node->getSymbolReference()->getReferenceNumber()))
+      live |= _slots;
+
+   genLoads(node, live, comp()->incOrResetVisitCount());
+   }
+
+
+bool
+Ruby::DeadStackStoreElimination::isTrackedStore(TR::Node *node)
+   {
+   return node->getOpCode().isStoreIndirect() &&
+          _slots.isSet(node->getSymbolReference()->getReferenceNumber());
+   }
+
+
+/**
+ * Make live the slots read by the loads and calls under `node`.
+ */
+void
+Ruby::DeadStackStoreElimination::genLoads(TR::Node *node, TR_BitVector &live, vcount_t visitCount)
+   {
+   if (node->getVisitCount() == visitCount)
+      return;
+   node->setVisitCount(visitCount);
+
+   for (int32_t i = 0; i < node->getNumChildren(); i++)
+      genLoads(node->getChild(i), live, visitCount);
+
+   if (node->getOpCode().isCall())
+      {
+      genCall(node, live);
+      }
+   else if (node->getOpCode().isLoadIndirect() &&
+            comp()->getSymRefTab()->isRubyStackSlotSymRef(node->getSymbolReference()))
+      {
+      int32_t slot = node->getSymbolReference()->getReferenceNumber();
+      if (!_slots.isSet(slot))
+         {
+         live |= _slots;
+         return;
+         }
+
+      live.set(slot);
+      genOtherBases(_slotBase[slot], live);
+      }
+   }
+
+
+/**
+ * Make live the slots a call may read: those from the receiver of a send
+ * up, if ILGen recorded where they start, or else every slot.
+ */
+void
+Ruby::DeadStackStoreElimination::genCall(TR::Node *node, TR_BitVector &live)
+   {
+   TR::SymbolReferenceTable *symRefTab = comp()->getSymRefTab();
+   if (symRefTab->isRubyHelperSymRef(node->getSymbolReference()) && !readsStack(node))
+      return;
+
+   TR::SymbolReference *arguments = symRefTab->getRubySendStackArgumentsSymRef(node);
+   if (!arguments || !_slots.isSet(arguments->getReferenceNumber()))
+      {
+      live |= _slots;
+      return;
+      }
+
+   int32_t base = _slotBase[arguments->getReferenceNumber()];
+   TR_BitVectorIterator bvi(_slots);
+   while (bvi.hasMoreElements())
+      {
+      int32_t slot = bvi.getNextElement();
+      if (_slotBase[slot] != base ||
+          symRefTab->getSymRef(slot)->getOffset() >= arguments->getOffset())
+         live.set(slot);
+      }
+   }
+
+
+/**
+ * A slot of another method may be the same word of the YARV stack as one of
+ * this base: an inlined callee's stack starts where its caller's SP was.
+ */
+void
+Ruby::DeadStackStoreElimination::genOtherBases(int32_t base, TR_BitVector &live)
+   {
+   TR_BitVectorIterator bvi(_slots);
+   while (bvi.hasMoreElements())
+      {
+      int32_t slot = bvi.getNextElement();
+      if (_slotBase[slot] != base)
+         live.set(slot);
+      }
+   }
+
+
+/**
+ * The helpers that take a receiver and arguments, or a whole frame, off the
+ * YARV stack of their caller, and those handed an address into it. Other
+ * helpers only push above the SP, and leave the slots below it alone.
+ */
+bool
+Ruby::DeadStackStoreElimination::readsStack(TR::Node *node)
+   {
+   static const TR_RuntimeHelper stackReaders[] =
+      {
+      RubyHelper_vm_send,
+      RubyHelper_vm_send_without_block,
+      RubyHelper_vm_send_symbol_without_block,
+      RubyHelper_vm_send_jit_inline_frame,
+      RubyHelper_vm_send_woblock_jit_inline_frame,
+      RubyHelper_vm_invokesuper,
+      RubyHelper_vm_invokeblock,
+      RubyHelper_vm_invokeblock_jit_inline_frame,
+      RubyHelper_vm_yield_literal_block,
+      RubyHelper_vm_yield_literal_block_jit_inline_frame,
+      RubyHelper_vm_call_symbol_block,
+      RubyHelper_jit_dispatch,
+      RubyHelper_vm_exec_core,
+      };
+
+   TR::SymbolReference *symRef = node->getSymbolReference();
+   for (size_t i = 0; i < sizeof(stackReaders) / sizeof(stackReaders[0]); i++)
+      {
+      if (symRef == comp()->getSymRefTab()->getSymRef(stackReaders[i]))
+         return true;
+      }
+
+   for (int32_t i = 0; i < node->getNumChildren(); i++)
+      {
+      if (addressesStack(node->getChild(i)))
+         return true;
+      }
+
+   return false;
+   }
+
+
+/**
+ * Whether `node` computes an address off a private SP. Values loaded
+ * through one are not addresses into the stack.
+ */
+bool
+Ruby::DeadStackStoreElimination::addressesStack(TR::Node *node)
+   {
+   if (node->getOpCode().isLoadVarDirect())
+      return _bases.isSet(node->getSymbolReference()->getReferenceNumber());
+
+   if (node->getOpCode().isLoadIndirect() || node->getOpCode().isCall())
+      return false;
+
+   for (int32_t i = 0; i < node->getNumChildren(); i++)
+      {
+      if (addressesStack(node->getChild(i)))
+         return true;
+      }
+   return false;
+   }
+
+
+/**
+ * Remove a dead store, keeping its value evaluated where it was if anything
+ * else refers to it.
+ */
+void
+Ruby::DeadStackStoreElimination::removeStore(TR::TreeTop *tt)
+   {
+   TR::Node *value = tt->getNode()->getSecondChild();
+   if (value->getReferenceCount() > 1 || value->getNumChildren() > 0)
+      tt->insertBefore(TR::TreeTop::create(comp(), TR::Node::create(TR::treetop, 1, value)));
+   tt->unlink(true);
+   }
@@ -0,0 +1,107 @@
+/*******************************************************************************
+ *
+ * (c) Copyright IBM Corp. 2000, 2016
+ *
+ *  This program and the accompanying materials are made available
+ *  under the terms of the Eclipse Public License v1.0 and
+ *  Apache License v2.0 which accompanies this distribution.
+ *
+ *      The Eclipse Public License is available at
+ *      http://www.eclipse.org/legal/epl-v10.html
+ *
+ *      The Apache License v2.0 is available at
+ *      http://www.opensource.org/licenses/apache2.0.php
+ *
+ * Contributors:
+ *    Multiple authors (IBM Corp.) - initial implementation and documentation
+ *******************************************************************************/
+
+
+#ifndef RUBYDEADSTACKSTOREELIMINATION_INCL
+#define RUBYDEADSTACKSTOREELIMINATION_INCL
+
+#include "optimizer/Optimization.hpp"
+#include "infra/BitVector.hpp"
+
+
+namespace Ruby
+{
+
+/**
+ * Remove stores to the YARV stack that nothing reads.
+ *
+ * ILGen writes pending values to the YARV stack at block boundaries and
+ * before sends, for the benefit of whoever may look at them. A slot is only
+ * read by a load of its shadow, or by the helpers that take their receiver
+ * and arguments off the stack. A store to a slot that is overwritten, or that
+ * the method returns without reading, is removed.
+ *
+ * This is a backward liveness analysis over the stack slot shadows created
+ * by Ruby::SymbolReferenceTable::createRubyStackSlotSymRef. Each slot belongs
+ * to one method, inlined or not, and is addressed off its private SP.
+ * Anything the analysis does not understand makes every slot live.
+ *
+ * A rescue or ensure handler resumes the interpreter with the stack below
+ * its sp, after any helper that raises. The pass is skipped in compilations
+ * with such catch entries rather than keep those slots live across every
+ * helper.
+ */
+class DeadStackStoreElimination : public TR::Optimization
+   {
+   public:
+
+   DeadStackStoreElimination(TR::OptimizationManager *manager);
+
+   /**
+    * Optimization factory method
+    */
+   static TR::Optimization *create(TR::OptimizationManager *manager)
+      {
+      return new (manager->allocator()) DeadStackStoreElimination(manager);
+      }
+
+   TR::CFG * cfg() { return comp()->getFlowGraph(); }
+
+   virtual int32_t perform();
+
+   private:
+
+   bool         hasHandlerCatchEntries();
+   void         collectSlots(TR::Node *, vcount_t);
+   void         noteSlotAccess(TR::Node *);
+   void         transferTree(TR::Node *, TR_BitVector &, bool &isDeadStore);
+   void         genLoads(TR::Node *, TR_BitVector &, vcount_t);
+   void         genCall(TR::Node *, TR_BitVector &);
+   void         genOtherBases(int32_t base, TR_BitVector &);
+   bool         readsStack(TR::Node *);
+   bool         addressesStack(TR::Node *);
+   bool         isTrackedStore(TR::Node *);
+   void         removeStore(TR::TreeTop *);
+
+   /**
+    * The stack slot shadows whose stores can be removed: those always
+    * addressed off the same private SP temp.
+    */
+   TR_BitVector _slots;
+
+   /**
+    * The stack slot shadows addressed some other way, which are never
+    * removed, and whose loads may read any slot.
+    */
+   TR_BitVector _untrackedSlots;
+
+   /**
+    * The private SP temps the slots are addressed off.
+    */
+   TR_BitVector _bases;
+
+   /**
+    * For each slot, the reference number of its private SP temp.
+    */
+   int32_t     *_slotBase;
+   };
+
+}
+
+
+#endif
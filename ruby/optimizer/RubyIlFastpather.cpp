@@ -18,7 +18,10 @@
 
 
 #include "optimizer/RubyIlFastpather.hpp"
+#include "optimizer/RubyTypePropagation.hpp"
 
+#include <limits.h>
+#include <string.h>
 #include "env/RubyFE.hpp"
 #include "il/Node.hpp"
 #include "il/Node_inlines.hpp"
@@ -27,10 +30,22 @@
 #include "il/TreeTop_inlines.hpp"
 #include "infra/Annotations.hpp"
 #include "optimizer/Optimization_inlines.hpp"
+#include "ras/DebugCounter.hpp"
 #include "ruby/version.h"
 
+extern "C" {
+#include "internal.h"                          // for struct RStruct
+#include "iseq.h"                              // for rb_iseq_original_iseq
+}
+/* Ruby */
+#include "insns.inc"
+#include "insns_info.inc"
+
 #define OPT_DETAILS "O^O RUBYILFASTPATHER: "
 
+// Longest chain of plus and minus sends fastpathed behind a single region.
+#define MAX_ARITHMETIC_CHAIN 8
+
 static
 char* getBOPName(int32_t bop)
    {
@@ -54,6 +69,50 @@ char* getBOPName(int32_t bop)
       }
    }
 
+/**
+ * C methods whose sends are expanded in place, behind the method cache
+ * guards. Entries are matched on the name of the class defining the cached
+ * method entry, the method name and the argument count; only CFUNC entries
+ * are considered, so a redefinition in Ruby never matches.
+ *
+ * Intrinsics with a helper call it directly, skipping the method dispatch
+ * and the cfunc frame. The others are open coded by fastpathIntrinsic.
+ * Block intrinsics only match sends passing a literal block, and are
+ * expanded into loops by fastpathBlockIntrinsic.
+ */
+static const struct RubyIntrinsic
+   {
+   const char                    *klass;
+   const char                    *method;
+   int32_t                        argc;
+   Ruby::IlFastpather::Intrinsic  intrinsic;
+   TR_RuntimeHelper               helper;
+   } rubyIntrinsics[] =
+   {
+   { "Array",  "first",    0, Ruby::IlFastpather::ArrayFirst,   TR_numRuntimeHelpers        },
+   { "Array",  "last",     0, Ruby::IlFastpather::ArrayLast,    TR_numRuntimeHelpers        },
+   { "Array",  "push",     1, Ruby::IlFastpather::HelperCall,   RubyHelper_rb_ary_push      },
+   { "Array",  "<<",       1, Ruby::IlFastpather::HelperCall,   RubyHelper_rb_ary_push      },
+   { "Hash",   "key?",     1, Ruby::IlFastpather::HelperCall,   RubyHelper_rb_hash_has_key  },
+   { "Hash",   "has_key?", 1, Ruby::IlFastpather::HelperCall,   RubyHelper_rb_hash_has_key  },
+   { "Hash",   "include?", 1, Ruby::IlFastpather::HelperCall,   RubyHelper_rb_hash_has_key  },
+   { "Hash",   "member?",  1, Ruby::IlFastpather::HelperCall,   RubyHelper_rb_hash_has_key  },
+   { "Hash",   "fetch",    1, Ruby::IlFastpather::HashFetch,    RubyHelper_rb_hash_lookup2  },
+   { "String", "==",       1, Ruby::IlFastpather::HelperCall,   RubyHelper_rb_str_equal     },
+   { "String", "===",      1, Ruby::IlFastpather::HelperCall,   RubyHelper_rb_str_equal     },
+   { "Integer", "times",   0, Ruby::IlFastpather::IntegerTimes, TR_numRuntimeHelpers        },
+   { "Range",  "each",     0, Ruby::IlFastpather::RangeEach,    TR_numRuntimeHelpers        },
+   { "Array",  "each",     0, Ruby::IlFastpather::ArrayEach,    TR_numRuntimeHelpers        },
+   { "Array",  "map",      0, Ruby::IlFastpather::ArrayMap,     TR_numRuntimeHelpers        },
+   { "Array",  "collect",  0, Ruby::IlFastpather::ArrayMap,     TR_numRuntimeHelpers        },
+   { "Fixnum", "&",        1, Ruby::IlFastpather::FixnumAnd,    TR_numRuntimeHelpers        },
+   { "Fixnum", "|",        1, Ruby::IlFastpather::FixnumOr,     TR_numRuntimeHelpers        },
+   { "Fixnum", "^",        1, Ruby::IlFastpather::FixnumXor,    TR_numRuntimeHelpers        },
+   { "Fixnum", "~",        0, Ruby::IlFastpather::FixnumNot,    TR_numRuntimeHelpers        },
+   { "Fixnum", ">>",       1, Ruby::IlFastpather::FixnumRShift, TR_numRuntimeHelpers        },
+   { "Fixnum", "<<",       1, Ruby::IlFastpather::FixnumLShift, TR_numRuntimeHelpers        },
+   };
+
 Ruby::IlFastpather::IlFastpather(TR::OptimizationManager *manager)
    : TR::Optimization(manager) 
    {
@@ -136,6 +195,11 @@ Ruby::IlFastpather::perform()
       performOnTreeTop(tt); 
       }
 
+   // Fold the guards of the new fast paths that are already known to hold,
+   // or to fail.
+   Ruby::TypePropagation typePropagation(manager());
+   typePropagation.perform();
+
    return 0;
    } 
 
@@ -149,6 +213,12 @@ Ruby::IlFastpather::performOnTreeTop(TR::TreeTop* tt)
    if (node->getOpCodeValue() == TR::treetop) 
       node = node->getFirstChild(); 
    
+   if (isConstantCacheCheck(node))
+      {
+      foldConstantCache(tt, node);
+      return;
+      }
+
    if (node->getOpCode().isCall() && 
           node->getSymbol()->castToMethodSymbol()->isHelper())
       {
@@ -161,7 +231,24 @@ Ruby::IlFastpather::performOnTreeTop(TR::TreeTop* tt)
 
          case RubyHelper_vm_opt_plus:
          case RubyHelper_vm_opt_minus:
-            fastpathPlusMinus(tt, node, refNum == RubyHelper_vm_opt_plus ); 
+            if (!fastpathArithmeticChain(tt, node))
+               fastpathPlusMinus(tt, node, refNum == RubyHelper_vm_opt_plus ); 
+            break;
+
+         case RubyHelper_vm_getivar:
+            fastpathGetIvar(tt, node);
+            break;
+
+         case RubyHelper_vm_setivar:
+            fastpathSetIvar(tt, node);
+            break;
+
+         case RubyHelper_vm_send_without_block:
+            fastpathSendWithoutBlock(tt, node);
+            break;
+
+         case RubyHelper_vm_opt_ltlt:
+            fastpathOptLtlt(tt, node);
             break;
          default:
             return; 
@@ -221,6 +308,7 @@ Ruby::IlFastpather::fastpathTrace(TR::TreeTop *tt, TR::Node *node)
    //Create new call node for if branch, loading from temps. 
    auto new_call_node = TR::Node::create(node->getOpCodeValue(), node->getNumChildren());
    new_call_node->setSymbolReference(node->getSymbolReference()); 
+   new_call_node->setByteCodeInfo(node->getByteCodeInfo()); 
    new_call_node->setAndIncChild(0, TR::Node::createLoad(tempThread)); 
    new_call_node->setAndIncChild(1, TR::Node::createLoad(tempFlag)); 
 
@@ -280,51 +368,12 @@ Ruby::IlFastpather::fastpathPlusMinus(TR::TreeTop *tt, TR::Node *node, bool isPl
    TR::Node::genTreeTop(ifBFixnum, B2);
    ifBFixnum->setBranchDestination(Bslow->getEntry());
 
-   TR::Node *ifOverflow;
-   if (isPlus)
-      {
-      // if (a + (b-1) ) overflows ->
-      ifOverflow = TR::Node::createif(TR::iflcmno,
-                                       a,
-                                       TR::Node::xsub(
-                                          b,
-                                          TR::Node::xconst(1)));
-      }
-   else
-      {
-      // if (a - b) overflows ->
-      ifOverflow = TR::Node::createif(TR::iflcmpo,
-                                       a,
-                                       b);
-      }
+   auto operand    = genPlusMinusOperand(b, isPlus);
+   auto ifOverflow = genPlusMinusOverflowTest(a, operand, isPlus);
    TR::Node::genTreeTop(ifOverflow, B3);
    ifOverflow->setBranchDestination(Bslow->getEntry());
 
-   // FIXME: it would be nice to be able to combine the overflow test with this ad//subtract
-   // we will need a new fused opcode for that modeled over the condCode opcode
-   TR::Node *result;
-   if (isPlus)
-      {
-      result =
-         TR::Node::xadd(
-            a,
-            TR::Node::xsub(
-               b,
-               TR::Node::xconst(1)));
-      }
-   else
-      {
-      // Note that we want to do: (a - b) | 1, however since we know that the bottom bit
-      // of (a - b) is necessarily 0, we can do (a - b) + 1 instead. This is more
-      // optimizable than the or/sub combo
-      result =
-         TR::Node::xadd(
-            TR::Node::xsub(
-               a,
-               b),
-            TR::Node::xconst(1));
-      }
-   TR::SymbolReference *tempResult = TR::Node::storeToTemp(result, Bfast);
+   TR::SymbolReference *tempResult = TR::Node::storeToTemp(genPlusMinusResult(a, operand, isPlus), Bfast);
 
    // TODO: Generate a call to vm_call_simple in Bslow
    // That is cumbersome, it is easier to keep the call going to vm_opt_minus
@@ -335,6 +384,7 @@ Ruby::IlFastpather::fastpathPlusMinus(TR::TreeTop *tt, TR::Node *node, bool isPl
                                                         TR::Node::aconst(ciConst->getAddress()),
                                                         TR::Node::createLoad(tempA),
                                                         TR::Node::createLoad(tempB));
+   newCall->setByteCodeInfo(node->getByteCodeInfo());
    TR::Node::genTreeTop(TR::Node::createStore(tempResult, newCall),
               Bslow);
    TR::Node *gotoNode = TR::Node::create(TR::Goto, 0);
@@ -354,6 +404,1870 @@ Ruby::IlFastpather::fastpathPlusMinus(TR::TreeTop *tt, TR::Node *node, bool isPl
    // comp()->verifyCFG();
    }
 
+/**
+ * The right operand of the untagged add or subtract of the tagged fixnums a
+ * and b: b - 1 for a plus, b itself for a minus. The overflow test and the
+ * result share it, so that they see the same add or subtract of the same
+ * operands, which the code generator may then compute once.
+ */
+TR::Node *
+Ruby::IlFastpather::genPlusMinusOperand(TR::Node *b, bool isPlus)
+   {
+   if (isPlus)
+      return TR::Node::xsub(b, TR::Node::xconst(1));
+   return b;
+   }
+
+/**
+ * Generate the branch taken if the fixnum sum or difference of a and the
+ * operand generated by genPlusMinusOperand overflows.
+ */
+TR::Node *
+Ruby::IlFastpather::genPlusMinusOverflowTest(TR::Node *a, TR::Node *operand, bool isPlus)
+   {
+   if (isPlus)
+      {
+      // if (a + (b-1) ) overflows ->
+      return TR::Node::createif(TR::iflcmno,
+                                a,
+                                operand);
+      }
+
+   // if (a - b) overflows ->
+   return TR::Node::createif(TR::iflcmpo,
+                             a,
+                             operand);
+   }
+
+/**
+ * Compute the tagged fixnum sum or difference of a and the operand
+ * generated by genPlusMinusOperand.
+ */
+TR::Node *
+Ruby::IlFastpather::genPlusMinusResult(TR::Node *a, TR::Node *operand, bool isPlus)
+   {
+   // There is no fused opcode to add or subtract and branch on overflow, so
+   // the result repeats the add or subtract of the overflow test. The x86
+   // evaluators compute it once, with the add or sub whose flags they test.
+   if (isPlus)
+      {
+      return
+         TR::Node::xadd(
+            a,
+            operand);
+      }
+
+   // Note that we want to do: (a - b) | 1, however since we know that the bottom bit
+   // of (a - b) is necessarily 0, we can do (a - b) + 1 instead. This is more
+   // optimizable than the or/sub combo
+   return
+      TR::Node::xadd(
+         TR::Node::xsub(
+            a,
+            operand),
+         TR::Node::xconst(1));
+   }
+
+bool
+Ruby::IlFastpather::isPlusMinusCall(TR::Node *node)
+   {
+   return node->getOpCode().isCall() &&
+          (node->getSymbolReference()->getReferenceNumber() == RubyHelper_vm_opt_plus ||
+           node->getSymbolReference()->getReferenceNumber() == RubyHelper_vm_opt_minus);
+   }
+
+/**
+ * Recognize the store of the pc ILGen generates ahead of a helper call.
+ */
+bool
+Ruby::IlFastpather::isPCStore(TR::Node *node)
+   {
+   return node->getOpCode().isStoreIndirect() &&
+          comp()->getSymRefTab()->isRubyPCSymRef(node->getSymbolReference()) &&
+          node->getSecondChild()->getOpCode().isLoadConst() &&
+          isMovableOperand(node->getFirstChild());
+   }
+
+/**
+ * Whether `node` is a tree of loads and arithmetic, that may be evaluated
+ * ahead of the fast paths before it and again after the calls of the slow
+ * paths.
+ */
+bool
+Ruby::IlFastpather::isMovableOperand(TR::Node *node)
+   {
+   if (node->getOpCode().isCall()   ||
+       node->getOpCode().isStore()  ||
+       node->getOpCode().isBranch() ||
+       node->getOpCode().isCheck())
+      return false;
+
+   for (int32_t i = 0; i < node->getNumChildren(); i++)
+      {
+      if (!isMovableOperand(node->getChild(i)))
+         return false;
+      }
+   return true;
+   }
+
+/**
+ * Find the plus and minus sends following the one at `tt` that take the
+ * result of the previous one as their receiver, separated only by pc
+ * stores. `pcStores[i]` is the pc store ahead of `chain[i]`, if any.
+ *
+ * \return The length of the chain, including the send at `tt`.
+ */
+int32_t
+Ruby::IlFastpather::collectArithmeticChain(TR::TreeTop *tt, TR::TreeTop **chain, TR::TreeTop **pcStores)
+   {
+   int32_t length = 0;
+   chain[length]    = tt;
+   pcStores[length] = NULL;
+   length++;
+
+   TR::Node    *prev    = tt->getNode()->getFirstChild();
+   TR::TreeTop *pcStore = NULL;
+   for (TR::TreeTop *next = tt->getNextTreeTop(); next && length < MAX_ARITHMETIC_CHAIN; next = next->getNextTreeTop())
+      {
+      TR::Node *node = next->getNode();
+      if (!pcStore && isPCStore(node))
+         {
+         pcStore = next;
+         continue;
+         }
+
+      if (node->getOpCodeValue() != TR::treetop || !isPlusMinusCall(node->getFirstChild()))
+         break;
+
+      TR::Node *call = node->getFirstChild();
+      TR::Node *arg  = call->getChild(3);
+      if (call->getChild(2) != prev || arg->getReferenceCount() != 1 || !isMovableOperand(arg))
+         break;
+
+      chain[length]    = next;
+      pcStores[length] = pcStore;
+      length++;
+      prev    = call;
+      pcStore = NULL;
+      }
+
+   return length;
+   }
+
+/**
+ * Fastpath a chain of plus and minus sends, each taking the result of the
+ * previous one as its receiver, such as `a + b - c + 1`, behind a single
+ * guarded region:
+ *
+ *     B..Bk:  if (redefined_flag[BOP_PLUS])               -> Bslow
+ *             if (redefined_flag[BOP_MINUS])              -> Bslow
+ *             if (a is not a fixnum)                      -> Bslow
+ *             if (b is not a fixnum)                      -> Bslow
+ *             if (a + b overflows)                        -> Bslow
+ *             if (c is not a fixnum)                      -> Bslow
+ *             if ((a + b) - c overflows)                  -> Bslow
+ *             ...
+ *     Bfast:  r0 = a + b; r1 = r0 - c; ...
+ *     Btail:  ... uses of r0, r1, ...
+ *     Bslow:  r0 = vm_opt_plus(a, b)
+ *             r1 = vm_opt_minus(r0, c)
+ *             ...
+ *             goto Btail
+ *
+ * The slow path runs the whole chain generically, so the operands of the
+ * later sends must be loads that can be evaluated ahead of the region, and
+ * again after the calls on the slow path.
+ *
+ * \return false if there is no chain at `tt`, which is then left alone.
+ */
+bool
+Ruby::IlFastpather::fastpathArithmeticChain(TR::TreeTop *tt, TR::Node *node)
+   {
+   static auto *disableChains = feGetEnv("OMR_RUBY_DISABLE_FASTPATH_CHAINS");
+   if (disableChains)
+      return false;
+
+   TR::TreeTop *chain[MAX_ARITHMETIC_CHAIN];
+   TR::TreeTop *pcStores[MAX_ARITHMETIC_CHAIN];
+   int32_t length = collectArithmeticChain(tt, chain, pcStores);
+   if (length < 2)
+      return false;
+
+   auto* block = tt->getEnclosingBlock();
+
+   if (!performTransformation(comp(), "%s Fastpathing chain of %d plus/minus on TT %p\n", OPT_DETAILS, length, tt))
+      return false;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.fastpath/arithmetic_chain/%d", length));
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.fastpath/arithmeticChain/%d", length));
+
+   TR::Node            *ops[MAX_ARITHMETIC_CHAIN];
+   TR::Node            *args[MAX_ARITHMETIC_CHAIN];
+   TR::Node            *slowArgs[MAX_ARITHMETIC_CHAIN];
+   TR::Node            *slowPCStores[MAX_ARITHMETIC_CHAIN];
+   TR::SymbolReference *helpers[MAX_ARITHMETIC_CHAIN];
+   TR::SymbolReference *results[MAX_ARITHMETIC_CHAIN];
+   uintptrj_t           cis[MAX_ARITHMETIC_CHAIN];
+   TR_ByteCodeInfo      bcis[MAX_ARITHMETIC_CHAIN];
+   bool                 isPlus[MAX_ARITHMETIC_CHAIN];
+   bool                 usesPlus  = false;
+   bool                 usesMinus = false;
+
+   for (int32_t i = 0; i < length; i++)
+      {
+      ops[i]          = chain[i]->getNode()->getFirstChild();
+      args[i]         = ops[i]->getChild(3);
+      helpers[i]      = ops[i]->getSymbolReference();
+      cis[i]          = ops[i]->getChild(1)->getAddress();
+      bcis[i]         = ops[i]->getByteCodeInfo();
+      isPlus[i]       = helpers[i]->getReferenceNumber() == RubyHelper_vm_opt_plus;
+      results[i]      = comp()->getSymRefTab()->createTemporary(comp()->getMethodSymbol(), TR_RubyFE::slotType());
+      slowArgs[i]     = i > 0 ? args[i]->duplicateTree() : NULL;
+      slowPCStores[i] = pcStores[i] ? pcStores[i]->getNode()->duplicateTree() : NULL;
+      usesPlus       |= isPlus[i];
+      usesMinus      |= !isPlus[i];
+      }
+
+   // Anchor the operands ahead of the chain, so that the guards can use
+   // them across the control flow.
+   auto a = ops[0]->getChild(2);
+   TR::Node::anchorBefore(a, tt);
+   for (int32_t i = 0; i < length; i++)
+      TR::Node::anchorBefore(args[i], tt);
+
+   // The later sends become loads of their results.
+   for (int32_t i = 1; i < length; i++)
+      {
+      TR::Node *op = TR::Node::recreate(ops[i],
+         TR::Node::xloadOp(static_cast<TR_RubyFE*>(TR::comp()->fe())));
+      op->setSymbolReference(results[i]);
+      op->removeAllChildren();
+      }
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   // A tag test and an overflow test per operand, after those of the flags.
+   uint32_t numTests = (usesPlus ? 1 : 0) + (usesMinus ? 1 : 0) + 1 + 2 * length;
+   createMultiDiamond(tt, block, numTests - 1, Bfast, Bslow, Btail, intermediateBlocks);
+
+   TR::SymbolReference *tempA = TR::Node::storeToTemp(a,       block);
+   TR::SymbolReference *tempB = TR::Node::storeToTemp(args[0], block);
+
+   uint32_t next = 0;
+   TR::Block *testBlock = block;
+   if (usesPlus)
+      {
+      TR::Node::genTreeTop(genRedefinedTest(BOP_PLUS, FIXNUM_REDEFINED_OP_FLAG, Bslow->getEntry()), testBlock);
+      testBlock = intermediateBlocks[next++];
+      }
+   if (usesMinus)
+      {
+      TR::Node::genTreeTop(genRedefinedTest(BOP_MINUS, FIXNUM_REDEFINED_OP_FLAG, Bslow->getEntry()), testBlock);
+      testBlock = intermediateBlocks[next++];
+      }
+
+   auto ifAFixnum = genFixNumTest(a);
+   TR::Node::genTreeTop(ifAFixnum, testBlock);
+   ifAFixnum->setBranchDestination(Bslow->getEntry());
+
+   TR::Node *result = a;
+   for (int32_t i = 0; i < length; i++)
+      {
+      auto ifArgFixnum = genFixNumTest(args[i]);
+      TR::Node::genTreeTop(ifArgFixnum, intermediateBlocks[next++]);
+      ifArgFixnum->setBranchDestination(Bslow->getEntry());
+
+      auto operand    = genPlusMinusOperand(args[i], isPlus[i]);
+      auto ifOverflow = genPlusMinusOverflowTest(result, operand, isPlus[i]);
+      TR::Node::genTreeTop(ifOverflow, intermediateBlocks[next++]);
+      ifOverflow->setBranchDestination(Bslow->getEntry());
+
+      result = genPlusMinusResult(result, operand, isPlus[i]);
+      TR::Node::genTreeTop(TR::Node::createStore(results[i], result), Bfast);
+      }
+   TR_ASSERT(next == numTests - 1, "Intermediate blocks left unused");
+
+   for (int32_t i = 0; i < length; i++)
+      {
+      if (slowPCStores[i])
+         TR::Node::genTreeTop(slowPCStores[i], Bslow);
+
+      TR::Node *newCall = TR::Node::createCallNode(TR::Node::xcallOp(),
+                                                   helpers[i],
+                                                   4,
+                                                   TR::Node::loadThread(optimizer()->getMethodSymbol()),
+                                                   TR::Node::aconst(cis[i]),
+                                                   TR::Node::createLoad(i == 0 ? tempA : results[i - 1]),
+                                                   i == 0 ? TR::Node::createLoad(tempB) : slowArgs[i]);
+      newCall->setByteCodeInfo(bcis[i]);
+      TR::Node::genTreeTop(TR::Node::createStore(results[i], newCall), Bslow);
+      }
+   TR::Node *gotoNode = TR::Node::create(TR::Goto, 0);
+   TR::Node::genTreeTop(gotoNode, Bslow);
+   gotoNode->setBranchDestination(Btail->getEntry());
+
+   // Now change the first send in Btail to be a load
+   node = TR::Node::recreate(node,
+      TR::Node::xloadOp(static_cast<TR_RubyFE*>(TR::comp()->fe())));
+
+   node->setSymbolReference(results[0]);
+   node->removeAllChildren();
+   return true;
+   }
+
+/**
+ * Recognize the inline cache check generated for getinlinecache:
+ *
+ *     xternary
+ *       xcmpeq
+ *         xloadi ic->ic_serial
+ *           aconst ic
+ *         xload ruby_vm_global_constant_state
+ *       xloadi ic->ic_value
+ *         ==> aconst ic
+ *       xconst Qnil
+ */
+bool
+Ruby::IlFastpather::isConstantCacheCheck(TR::Node *node)
+   {
+   auto *symRefTab = comp()->getSymRefTab();
+   if (node->getOpCodeValue() != TR::Node::xternaryOp() ||
+       node->getFirstChild()->getOpCodeValue() != TR::Node::xcmpeqOp())
+      return false;
+
+   auto *hit = node->getFirstChild();
+   return hit->getFirstChild()->getOpCode().isLoadIndirect() &&
+          hit->getFirstChild()->getSymbolReference() == symRefTab->findOrCreateRubyICSerialSymRef() &&
+          hit->getFirstChild()->getFirstChild()->getOpCodeValue() == TR::aconst &&
+          hit->getSecondChild()->getOpCode().isLoadDirect() &&
+          hit->getSecondChild()->getSymbolReference() == symRefTab->findOrCreateRubyGlobalConstantStateSymRef() &&
+          node->getSecondChild()->getOpCode().isLoadIndirect() &&
+          node->getSecondChild()->getSymbolReference() == symRefTab->findOrCreateRubyICValueSymRef();
+   }
+
+/**
+ * Fold constant references that are already resolved at compile time.
+ *
+ * If the inline cache is valid now, the constant is embedded as an
+ * immediate, guarded only by a compare of the global constant state against
+ * the state the cache was filled under:
+ *
+ *     B:     if (ruby_vm_global_constant_state != <state>) -> Bslow
+ *     Bfast: value = <constant>; hit = 1
+ *     Btail: ... uses of value and hit ...
+ *     Bslow: hit   = ic->ic_serial == ruby_vm_global_constant_state
+ *            value = hit ? ic->ic_value : Qnil
+ *            goto Btail
+ *
+ * Any constant definition or removal bumps the global constant state, which
+ * invalidates every folded value of the body at once. Once that happens the
+ * body keeps working off the inline cache, which the VM refills as usual.
+ *
+ * @TODO: Patch the guards out of line instead, when the JIT gets code
+ *        patching support.
+ */
+void
+Ruby::IlFastpather::foldConstantCache(TR::TreeTop *tt, TR::Node *node)
+   {
+   auto *hit = node->getFirstChild();
+   auto *ic  = reinterpret_cast<IC>(hit->getFirstChild()->getFirstChild()->getAddress());
+   auto state = *static_cast<TR_RubyFE*>(fe())->getJitInterface()->globals.ruby_vm_global_constant_state_ptr;
+
+   // Nothing to fold if the cache has not been filled under the current state.
+   if (ic->ic_serial != state)
+      return;
+
+   VALUE value = ic->ic_value.value;
+
+   auto* block = tt->getEnclosingBlock();
+
+   if (!performTransformation(comp(), "%s Folding constant %p from IC %p on TT %p\n", OPT_DETAILS, (void *)value, ic, tt))
+      return;
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   auto *symRefTab = comp()->getSymRefTab();
+
+   createMultiDiamond(tt, block, 0, Bfast, Bslow, Btail, intermediateBlocks);
+
+   auto ifStateChanged = TR::Node::ifxcmpne(TR::Node::createLoad(symRefTab->findOrCreateRubyGlobalConstantStateSymRef()),
+                                            TR::Node::xconst(state));
+   TR::Node::genTreeTop(ifStateChanged, block);
+   ifStateChanged->setBranchDestination(Bslow->getEntry());
+
+   TR::SymbolReference *tempValue = TR::Node::storeToTemp(TR::Node::xconst(value), Bfast);
+   TR::SymbolReference *tempHit   = symRefTab->createTemporary(comp()->getMethodSymbol(), TR::Int32);
+   TR::Node::genTreeTop(TR::Node::createStore(tempHit, TR::Node::iconst(1)), Bfast);
+
+   auto slowHit = TR::Node::xcmpeq(TR::Node::xloadi(symRefTab->findOrCreateRubyICSerialSymRef(), TR::Node::aconst((uintptr_t)ic), fe()),
+                                   TR::Node::createLoad(symRefTab->findOrCreateRubyGlobalConstantStateSymRef()));
+   TR::Node::genTreeTop(TR::Node::createStore(tempHit, slowHit), Bslow);
+   auto slowValue = TR::Node::xternary(TR::Node::createLoad(tempHit),
+                                       TR::Node::xloadi(symRefTab->findOrCreateRubyICValueSymRef(), TR::Node::aconst((uintptr_t)ic), fe()),
+                                       TR::Node::xconst(Qnil));
+   TR::Node::genTreeTop(TR::Node::createStore(tempValue, slowValue), Bslow);
+   TR::Node *gotoNode = TR::Node::create(TR::Goto, 0);
+   TR::Node::genTreeTop(gotoNode, Bslow);
+   gotoNode->setBranchDestination(Btail->getEntry());
+
+   // The hit test is also used by the branch to the end of the constant
+   // lookup, so change it into a load of its temp before the ternary
+   // releases it.
+   hit = TR::Node::recreate(hit, TR::iload);
+   hit->setSymbolReference(tempHit);
+   hit->removeAllChildren();
+
+   node = TR::Node::recreate(node,
+      TR::Node::xloadOp(static_cast<TR_RubyFE*>(TR::comp()->fe())));
+
+   node->setSymbolReference(tempValue);
+   node->removeAllChildren();
+   }
+
+/**
+ * Generate the guards shared by the instance variable fast paths. These
+ * mirror the cache check in vm_getivar/vm_setivar:
+ *
+ *     B:  if (obj & RUBY_IMMEDIATE_MASK)                           -> Bslow
+ *     B1: if (!RTEST(obj))                                         -> Bslow
+ *     B2: if ((RBASIC(obj)->flags & typeMask) != T_OBJECT)         -> Bslow
+ *     B3: if (RCLASS_SERIAL(RBASIC(obj)->klass) != serial)         -> Bslow
+ *     B4: if (index >= ROBJECT_NUMIV(obj))                         -> Bslow
+ *
+ * where B is the block being split, and B1..B4 are the first four
+ * intermediate blocks. `serial` and `index` come from the inline cache,
+ * either loaded from it or folded at compile time. `typeMask` lets the
+ * store paths fold the frozen check into the type check.
+ *
+ * \return A node computing the address of the ivar slot, which may be used
+ *         in any block extending B4.
+ */
+TR::Node *
+Ruby::IlFastpather::genIvarGuards(TR::Node *obj,
+                                  TR::Node *serial,
+                                  TR::Node *index,
+                                  uintptr_t typeMask,
+                                  TR::Block *B,
+                                  CS2::ArrayOf<TR::Block *, TR::Allocator> &intermediateBlocks,
+                                  TR::Block *Bslow)
+   {
+   auto *symRefTab = comp()->getSymRefTab();
+   auto *objAddr   = TR::Node::x2a(obj);
+
+   auto ifImmediate = TR::Node::ifxcmpne(TR::Node::xand(obj, TR::Node::xconst(RUBY_IMMEDIATE_MASK)),
+                                         TR::Node::xconst(0));
+   TR::Node::genTreeTop(ifImmediate, B);
+   ifImmediate->setBranchDestination(Bslow->getEntry());
+
+   auto ifFalsy = TR::Node::ifxcmpeq(TR::Node::xand(obj, TR::Node::xconst(~Qnil)),
+                                     TR::Node::xconst(0));
+   TR::Node::genTreeTop(ifFalsy, intermediateBlocks[0]);
+   ifFalsy->setBranchDestination(Bslow->getEntry());
+
+   auto flags = TR::Node::xloadi(symRefTab->findOrCreateRubyBasicFlagsSymRef(), objAddr, fe());
+   auto ifNotObject = TR::Node::ifxcmpne(TR::Node::xand(flags, TR::Node::xconst(typeMask)),
+                                         TR::Node::xconst(T_OBJECT));
+   TR::Node::genTreeTop(ifNotObject, intermediateBlocks[1]);
+   ifNotObject->setBranchDestination(Bslow->getEntry());
+
+   auto klass    = TR::Node::xloadi(symRefTab->findOrCreateRubyBasicKlassSymRef(), objAddr, fe());
+   auto classExt = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                              TR::Node::x2a(klass),
+                                              symRefTab->findOrCreateRubyClassExtSymRef());
+   auto ifSerialMiss = TR::Node::ifxcmpne(TR::Node::xloadi(symRefTab->findOrCreateRubyClassSerialSymRef(), classExt, fe()),
+                                          serial);
+   TR::Node::genTreeTop(ifSerialMiss, intermediateBlocks[2]);
+   ifSerialMiss->setBranchDestination(Bslow->getEntry());
+
+   // Both arms of a ternary are evaluated. For an embedded object the heap
+   // loads read the inline ivars instead, which is harmless.
+   auto embedded = TR::Node::xcmpne(TR::Node::xand(flags, TR::Node::xconst(ROBJECT_EMBED)),
+                                    TR::Node::xconst(0));
+   auto numiv    = TR::Node::xternary(embedded,
+                                      TR::Node::xconst(ROBJECT_EMBED_LEN_MAX),
+                                      TR::Node::xloadi(symRefTab->findOrCreateRubyObjectNumIVSymRef(), objAddr, fe()));
+   auto ifOutOfBounds = TR::Node::ifxcmpge(index, numiv);
+   TR::Node::genTreeTop(ifOutOfBounds, intermediateBlocks[3]);
+   ifOutOfBounds->setBranchDestination(Bslow->getEntry());
+
+   auto ivptr = TR::Node::xternary(embedded,
+                                   TR::Node::xadd(obj, TR::Node::xconst(offsetof(struct RObject, as.ary))),
+                                   TR::Node::a2x(TR::Node::createWithSymRef(TR::aloadi, 1, 1, objAddr,
+                                                                            symRefTab->findOrCreateRubyObjectIVPtrSymRef())));
+   return TR::Node::x2a(TR::Node::xadd(ivptr,
+                                       TR::Node::xmul(index, TR::Node::xconst(TR_RubyFE::SLOTSIZE))));
+   }
+
+TR::Node *
+Ruby::IlFastpather::loadICSerial(TR::Node *ic)
+   {
+   return TR::Node::xloadi(comp()->getSymRefTab()->findOrCreateRubyICSerialSymRef(),
+                           TR::Node::x2a(ic),
+                           fe());
+   }
+
+TR::Node *
+Ruby::IlFastpather::loadICIndex(TR::Node *ic)
+   {
+   return TR::Node::xloadi(comp()->getSymRefTab()->findOrCreateRubyICValueSymRef(),
+                           TR::Node::x2a(ic),
+                           fe());
+   }
+
+/**
+ * Fastpath calls to vm_getivar.
+ *
+ * When the receiver is a T_OBJECT whose class serial matches the inline
+ * cache, the ivar is read directly out of the embedded or heap ivar table.
+ * Misses, and reads of unset ivars (which may warn), still go to vm_getivar,
+ * which refills the cache.
+ */
+void
+Ruby::IlFastpather::fastpathGetIvar(TR::TreeTop *tt, TR::Node *node)
+   {
+   TR_ASSERT(node->getNumChildren() == 5, "Wrong arg count on vm_getivar call");
+
+   auto* block = tt->getEnclosingBlock();
+
+   if (!performTransformation(comp(), "%s Fastpathing %s on TT %p\n", OPT_DETAILS, "getivar", tt))
+      return;
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   auto obj = node->getChild(0);
+   auto ic  = node->getChild(2);
+   TR::Node::anchorBefore(obj, tt);
+
+   createMultiDiamond(tt, block, 5, Bfast, Bslow, Btail, intermediateBlocks);
+
+   TR::SymbolReference *tempObj = TR::Node::storeToTemp(obj, block);
+
+   auto slot = genIvarGuards(obj, loadICSerial(ic), loadICIndex(ic), T_MASK, block, intermediateBlocks, Bslow);
+
+   // An unset ivar reads as Qundef; leave the nil conversion (and the
+   // warning) to the helper.
+   TR::Block *B5 = intermediateBlocks[4];
+   auto value = TR::Node::xloadi(comp()->getSymRefTab()->findOrCreateRubyObjectSlotSymRef(), slot, fe());
+   TR::SymbolReference *tempResult = TR::Node::storeToTemp(value, B5);
+   auto ifUndef = TR::Node::ifxcmpeq(value, TR::Node::xconst(Qundef));
+   TR::Node::genTreeTop(ifUndef, B5);
+   ifUndef->setBranchDestination(Bslow->getEntry());
+
+   TR::Node *newCall = TR::Node::createCallNode(node->getOpCodeValue(),
+                                                node->getSymbolReference(),
+                                                5,
+                                                TR::Node::createLoad(tempObj),
+                                                node->getChild(1)->duplicateTree(),
+                                                ic->duplicateTree(),
+                                                node->getChild(3)->duplicateTree(),
+                                                node->getChild(4)->duplicateTree());
+   newCall->setByteCodeInfo(node->getByteCodeInfo());
+   TR::Node::genTreeTop(TR::Node::createStore(tempResult, newCall), Bslow);
+   TR::Node *gotoNode = TR::Node::create(TR::Goto, 0);
+   TR::Node::genTreeTop(gotoNode, Bslow);
+   gotoNode->setBranchDestination(Btail->getEntry());
+
+   // Now change the original call node in Btail to be a load
+   node = TR::Node::recreate(node,
+      TR::Node::xloadOp(static_cast<TR_RubyFE*>(TR::comp()->fe())));
+
+   node->setSymbolReference(tempResult);
+   node->removeAllChildren();
+   }
+
+/**
+ * Fastpath calls to vm_setivar.
+ *
+ * The guards are those of the read path, with the frozen check folded into
+ * the type check. Stores of heap objects are followed by a generational
+ * write barrier, as RB_OBJ_WRITE does.
+ */
+void
+Ruby::IlFastpather::fastpathSetIvar(TR::TreeTop *tt, TR::Node *node)
+   {
+   TR_ASSERT(node->getNumChildren() == 6, "Wrong arg count on vm_setivar call");
+
+   auto* block = tt->getEnclosingBlock();
+
+   if (!performTransformation(comp(), "%s Fastpathing %s on TT %p\n", OPT_DETAILS, "setivar", tt))
+      return;
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   auto obj   = node->getChild(0);
+   auto value = node->getChild(2);
+   auto ic    = node->getChild(3);
+   TR::Node::anchorBefore(obj,   tt);
+   TR::Node::anchorBefore(value, tt);
+
+   createMultiDiamond(tt, block, 4, Bfast, Bslow, Btail, intermediateBlocks);
+
+   TR::SymbolReference *tempObj   = TR::Node::storeToTemp(obj,   block);
+   TR::SymbolReference *tempValue = TR::Node::storeToTemp(value, block);
+
+   auto slot = genIvarGuards(obj, loadICSerial(ic), loadICIndex(ic), T_MASK | FL_FREEZE, block, intermediateBlocks, Bslow);
+
+   TR::Node::genTreeTop(TR::Node::xstorei(comp()->getSymRefTab()->findOrCreateRubyObjectSlotSymRef(),
+                                          slot,
+                                          value,
+                                          static_cast<TR_RubyFE*>(fe())),
+                        Bfast);
+   genWriteBarrier(obj, value, Bfast, Btail);
+
+   TR::Node *newCall = TR::Node::createCallNode(node->getOpCodeValue(),
+                                                node->getSymbolReference(),
+                                                6,
+                                                TR::Node::createLoad(tempObj),
+                                                node->getChild(1)->duplicateTree(),
+                                                TR::Node::createLoad(tempValue),
+                                                ic->duplicateTree(),
+                                                node->getChild(4)->duplicateTree(),
+                                                node->getChild(5)->duplicateTree());
+   newCall->setByteCodeInfo(node->getByteCodeInfo());
+   TR::Node::genTreeTop(newCall, Bslow);
+   TR::Node *gotoNode = TR::Node::create(TR::Goto, 0);
+   TR::Node::genTreeTop(gotoNode, Bslow);
+   gotoNode->setBranchDestination(Btail->getEntry());
+
+   // vm_setivar has no result. Turn the original call into a load of the
+   // stored value, which dead trees elimination will remove.
+   node = TR::Node::recreate(node,
+      TR::Node::xloadOp(static_cast<TR_RubyFE*>(TR::comp()->fe())));
+
+   node->setSymbolReference(tempValue);
+   node->removeAllChildren();
+   }
+
+/**
+ * Return the method entry the call info of a send was last dispatched
+ * through, if its cache is still valid and the send is one the fast paths
+ * below can take over.
+ */
+const rb_method_entry_t *
+Ruby::IlFastpather::getCachedMethodEntry(rb_call_info_t *ci)
+   {
+   auto *jitInterface = static_cast<TR_RubyFE*>(fe())->getJitInterface();
+
+   if (!ci->me || !ci->klass ||
+       ci->method_state != *jitInterface->globals.ruby_vm_global_method_state_ptr ||
+       ci->class_serial != jitInterface->callbacks.rb_class_serial_f(ci->klass))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/notDirect/stale_cache"));
+      return NULL;
+      }
+
+   if (ci->flag & (VM_CALL_ARGS_SPLAT | VM_CALL_ARGS_BLOCKARG))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/notDirect/splat_or_blockarg"));
+      return NULL;
+      }
+
+   //Same restriction as the inliner: only the default dispatch flags.
+   if (ci->me->flag != 0 && ci->me->flag != 0x8)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/notDirect/unsupported_method_entry_flag"));
+      return NULL;
+      }
+
+   return ci->me;
+   }
+
+/**
+ * Check that an ISEQ callee can be entered through
+ * vm_send_woblock_jit_inline_frame.
+ */
+bool
+Ruby::IlFastpather::isDirectSendTarget(rb_call_info_t *ci, rb_iseq_t *iseq)
+   {
+   if (ci->orig_argc != iseq->param.lead_num)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/notDirect/arity_mismatch"));
+      return false;
+      }
+
+   if (iseq->param.flags.has_opt    ||
+       iseq->param.flags.has_rest   ||
+       iseq->param.flags.has_post   ||
+       iseq->param.flags.has_block  ||
+       iseq->param.flags.has_kw     ||
+       iseq->param.flags.has_kwrest ||
+       iseq->catch_table != 0)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/notDirect/complex_callee"));
+      return false;
+      }
+
+   return true;
+   }
+
+/**
+ * Recognize the accessors Struct defines for its members. These are ISEQs
+ * of the shape
+ *
+ *     putself
+ *     putobject <member index>
+ *     [getlocal <value>]
+ *     opt_call_c_function rb_vm_opt_struct_aref / rb_vm_opt_struct_aset
+ *     leave
+ *
+ * possibly with trace instructions in between.
+ *
+ * \return The member index, or -1 if `iseq` is not a Struct accessor.
+ */
+int32_t
+Ruby::IlFastpather::getStructMemberIndex(rb_iseq_t *iseq, bool &isSet)
+   {
+   auto &callbacks = static_cast<TR_RubyFE*>(fe())->getJitInterface()->callbacks;
+   const VALUE *insns = rb_iseq_original_iseq(iseq);
+
+   VALUE member = Qundef;
+   VALUE func   = 0;
+   for (unsigned long i = 0; i < iseq->iseq_size; i += insn_len(insns[i]))
+      {
+      switch (insns[i])
+         {
+         case BIN(trace):
+         case BIN(putself):
+         case BIN(getlocal):
+         case BIN(getlocal_OP__WC__0):
+         case BIN(leave):
+            break;
+         case BIN(putobject):
+            member = insns[i + 1];
+            break;
+         case BIN(opt_call_c_function):
+            func = insns[i + 1];
+            break;
+         default:
+            return -1;
+         }
+      }
+
+   if (!FIXNUM_P(member))
+      return -1;
+
+   if (func == (VALUE)callbacks.rb_vm_opt_struct_aref_f)
+      isSet = false;
+   else if (func == (VALUE)callbacks.rb_vm_opt_struct_aset_f)
+      isSet = true;
+   else
+      return -1;
+
+   return FIX2LONG(member);
+   }
+
+/**
+ * Generate the guards proving that a send would be dispatched to the method
+ * entry cached in `ci`:
+ *
+ *     B:  if (recv & RUBY_IMMEDIATE_MASK)                             -> Bslow
+ *     B1: if (!RTEST(recv))                                           -> Bslow
+ *     B2: if (RCLASS_SERIAL(RBASIC(recv)->klass) != <class_serial>)   -> Bslow
+ *     B3: if (ruby_vm_global_method_state != <method_state>)          -> Bslow
+ *
+ * where B is the block being split, and B1..B3 are the first three
+ * intermediate blocks. The class serial identifies the receiver's class and
+ * its method table, so together with the method state it proves that
+ * lookup would find the cached entry again.
+ */
+void
+Ruby::IlFastpather::genSendCacheGuards(TR::Node *recv,
+                                       rb_call_info_t *ci,
+                                       TR::Block *B,
+                                       CS2::ArrayOf<TR::Block *, TR::Allocator> &intermediateBlocks,
+                                       TR::Block *Bslow)
+   {
+   auto *symRefTab = comp()->getSymRefTab();
+
+   auto ifImmediate = TR::Node::ifxcmpne(TR::Node::xand(recv, TR::Node::xconst(RUBY_IMMEDIATE_MASK)),
+                                         TR::Node::xconst(0));
+   TR::Node::genTreeTop(ifImmediate, B);
+   ifImmediate->setBranchDestination(Bslow->getEntry());
+
+   auto ifFalsy = TR::Node::ifxcmpeq(TR::Node::xand(recv, TR::Node::xconst(~Qnil)),
+                                     TR::Node::xconst(0));
+   TR::Node::genTreeTop(ifFalsy, intermediateBlocks[0]);
+   ifFalsy->setBranchDestination(Bslow->getEntry());
+
+   auto klass    = TR::Node::xloadi(symRefTab->findOrCreateRubyBasicKlassSymRef(),
+                                    TR::Node::x2a(recv),
+                                    fe());
+   auto classExt = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                              TR::Node::x2a(klass),
+                                              symRefTab->findOrCreateRubyClassExtSymRef());
+   auto ifClassMiss = TR::Node::ifxcmpne(TR::Node::xloadi(symRefTab->findOrCreateRubyClassSerialSymRef(), classExt, fe()),
+                                         TR::Node::xconst(ci->class_serial));
+   TR::Node::genTreeTop(ifClassMiss, intermediateBlocks[1]);
+   ifClassMiss->setBranchDestination(Bslow->getEntry());
+
+   genMethodStateGuard(ci, intermediateBlocks[2], Bslow);
+   }
+
+void
+Ruby::IlFastpather::genMethodStateGuard(rb_call_info_t *ci, TR::Block *B, TR::Block *Bslow)
+   {
+   auto ifMethodStateChanged = TR::Node::ifxcmpne(TR::Node::createLoad(comp()->getSymRefTab()->findOrCreateRubyGlobalMethodStateSymRef()),
+                                                  TR::Node::xconst(ci->method_state));
+   TR::Node::genTreeTop(ifMethodStateChanged, B);
+   ifMethodStateChanged->setBranchDestination(Bslow->getEntry());
+   }
+
+/**
+ * Fastpath sends whose call info holds a valid monomorphic cache, according
+ * to the kind of method cached:
+ *
+ * - attr_reader and attr_writer methods become ivar accesses.
+ * - Struct member accessors become member accesses.
+ * - C methods of the intrinsic table are expanded in place.
+ * - Other ISEQ methods are called directly through their compiled body.
+ */
+void
+Ruby::IlFastpather::fastpathSendWithoutBlock(TR::TreeTop *tt, TR::Node *node)
+   {
+   TR_ASSERT(node->getNumChildren() == 3 &&
+             node->getSecondChild()->getOpCodeValue() == TR::aconst,
+             "Unexpected children of vm_send_without_block call");
+
+   auto *ci = reinterpret_cast<rb_call_info_t *>(node->getSecondChild()->getAddress());
+   auto *me = getCachedMethodEntry(ci);
+   if (!me)
+      return;
+
+   static auto *disableAccessors  = feGetEnv("OMR_DISABLE_ACCESSOR_FASTPATH");
+   static auto *disableDirectSend = feGetEnv("OMR_DISABLE_DIRECT_SEND");
+
+   switch (me->def->type)
+      {
+      case VM_METHOD_TYPE_IVAR:
+         // ci->aux.index holds the ivar index + 1 once the accessor has
+         // found the ivar in the cached class.
+         if (!disableAccessors && ci->orig_argc == 0 && ci->aux.index > 0)
+            fastpathAttrAccessor(tt, node, ci, false);
+         break;
+
+      case VM_METHOD_TYPE_ATTRSET:
+         if (!disableAccessors && ci->orig_argc == 1 && ci->aux.index > 0)
+            fastpathAttrAccessor(tt, node, ci, true);
+         break;
+
+      case VM_METHOD_TYPE_ISEQ:
+         {
+         rb_iseq_t *iseq = me->def->body.iseq;
+         bool isSet = false;
+         int32_t member = getStructMemberIndex(iseq, isSet);
+         if (member >= 0)
+            {
+            if (!disableAccessors && ci->orig_argc == (isSet ? 1 : 0))
+               fastpathStructAccessor(tt, node, ci, member, isSet);
+            }
+         else if (!disableDirectSend && isDirectSendTarget(ci, iseq))
+            {
+            fastpathDirectSend(tt, node, ci, iseq);
+            }
+         }
+         break;
+
+      case VM_METHOD_TYPE_CFUNC:
+         {
+         static auto *disableIntrinsics = feGetEnv("OMR_DISABLE_INTRINSICS");
+         const RubyIntrinsic *intrinsic = disableIntrinsics ? NULL : findIntrinsic(ci, me);
+         if (!intrinsic)
+            break;
+
+         if (isFixnumIntrinsic(intrinsic->intrinsic))
+            {
+            TR::Node *arg = NULL;
+            if (ci->orig_argc == 1)
+               {
+               auto *tempArg = comp()->getSymRefTab()->getRubySendArgumentTempSymRef(node);
+               if (!tempArg)
+                  break;
+               arg = TR::Node::createLoad(tempArg);
+               }
+            fastpathFixnumIntrinsic(tt, node, ci, intrinsic->intrinsic, node->getChild(2), arg);
+            }
+         else
+            {
+            fastpathIntrinsic(tt, node, ci, intrinsic->intrinsic, intrinsic->helper);
+            }
+         }
+         break;
+
+      default:
+         break;
+      }
+   }
+
+/**
+ * Look up the cfunc cached for a send in the intrinsic table.
+ */
+const RubyIntrinsic *
+Ruby::IlFastpather::findIntrinsic(rb_call_info_t *ci, const rb_method_entry_t *me, bool withBlock)
+   {
+   auto &callbacks = static_cast<TR_RubyFE*>(fe())->getJitInterface()->callbacks;
+   const char *klassName  = callbacks.rb_class2name_f(me->klass);
+   const char *methodName = callbacks.rb_id2name_f(ci->mid);
+   if (!klassName || !methodName)
+      return NULL;
+
+   for (size_t i = 0; i < sizeof(rubyIntrinsics) / sizeof(rubyIntrinsics[0]); i++)
+      {
+      const RubyIntrinsic &entry = rubyIntrinsics[i];
+      if (entry.argc == ci->orig_argc &&
+          isBlockIntrinsic(entry.intrinsic) == withBlock &&
+          !strcmp(entry.klass, klassName) &&
+          !strcmp(entry.method, methodName))
+         return &entry;
+      }
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/%s/notIntrinsic/%s/%s",
+                                                                                     withBlock ? "send" : "send_without_block", klassName, methodName));
+   return NULL;
+   }
+
+/**
+ * Expand a send to a C method of the intrinsic table:
+ *
+ *     B..B3: genSendCacheGuards                                   -> Bslow
+ *     B4:    ArrayFirst, ArrayLast:
+ *               if (RARRAY_LEN(recv) == 0)                        -> Bslow
+ *            HashFetch:
+ *               result = rb_hash_lookup2(recv, arg, Qundef)
+ *               if (result == Qundef)                             -> Bslow
+ *     Bfast: ArrayFirst: result = RARRAY_CONST_PTR(recv)[0]
+ *            ArrayLast:  result = RARRAY_CONST_PTR(recv)[len - 1]
+ *            HelperCall: result = helper(recv[, arg])
+ *     Bslow: result = vm_send_without_block(th, ci, recv)
+ *            goto Btail
+ *
+ * Hash#fetch yields to its block or raises KeyError for a missing key. The
+ * block it sees is that of its caller's frame, which a direct call would
+ * not push, so missing keys are left to the send.
+ */
+void
+Ruby::IlFastpather::fastpathIntrinsic(TR::TreeTop *tt, TR::Node *node, rb_call_info_t *ci, Intrinsic intrinsic, TR_RuntimeHelper helper)
+   {
+   auto *symRefTab = comp()->getSymRefTab();
+
+   TR::SymbolReference *tempArg = NULL;
+   if (ci->orig_argc == 1)
+      {
+      tempArg = symRefTab->getRubySendArgumentTempSymRef(node);
+      if (!tempArg)
+         return;
+      }
+
+   auto* block = tt->getEnclosingBlock();
+
+   if (!performTransformation(comp(), "%s Expanding intrinsic %s on TT %p\n", OPT_DETAILS,
+                              TR_RubyFE::instance()->getJitInterface()->callbacks.rb_id2name_f(ci->mid), tt))
+      return;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/intrinsic/%s",
+                                                                                     TR_RubyFE::instance()->getJitInterface()->callbacks.rb_id2name_f(ci->mid)));
+
+   bool isArrayElement = intrinsic == ArrayFirst || intrinsic == ArrayLast;
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   auto recv = node->getChild(2);
+   TR::Node::anchorBefore(recv, tt);
+
+   createMultiDiamond(tt, block, isArrayElement || intrinsic == HashFetch ? 4 : 3, Bfast, Bslow, Btail, intermediateBlocks);
+
+   TR::SymbolReference *tempRecv = TR::Node::storeToTemp(recv, block);
+
+   genSendCacheGuards(recv, ci, block, intermediateBlocks, Bslow);
+
+   TR::SymbolReference *tempResult;
+   if (isArrayElement)
+      {
+      auto len = genArrayLength(recv);
+
+      // Empty arrays answer nil; leave those to the send.
+      auto ifEmpty = TR::Node::ifxcmpeq(len, TR::Node::xconst(0));
+      TR::Node::genTreeTop(ifEmpty, intermediateBlocks[3]);
+      ifEmpty->setBranchDestination(Bslow->getEntry());
+
+      auto ptr = genArrayPointer(recv);
+      TR::Node *offset = intrinsic == ArrayFirst ?
+         TR::Node::xconst(0) :
+         TR::Node::xmul(TR::Node::xsub(len, TR::Node::xconst(1)),
+                        TR::Node::xconst(TR_RubyFE::SLOTSIZE));
+      auto slot = TR::Node::x2a(TR::Node::xadd(ptr, offset));
+      tempResult = TR::Node::storeToTemp(TR::Node::xloadi(symRefTab->findOrCreateRubyObjectSlotSymRef(), slot, fe()),
+                                         Bfast);
+      }
+   else if (intrinsic == HashFetch)
+      {
+      auto *helperSymRef = symRefTab->findOrCreateRubyHelperSymbolRef(helper, true, true, false);
+      TR::Node *call = TR::Node::createCallNode(node->getOpCodeValue(), helperSymRef, 3,
+                                                recv,
+                                                TR::Node::createLoad(tempArg),
+                                                TR::Node::xconst(Qundef));
+      tempResult = TR::Node::storeToTemp(call, intermediateBlocks[3]);
+
+      auto ifMissing = TR::Node::ifxcmpeq(TR::Node::createLoad(tempResult), TR::Node::xconst(Qundef));
+      TR::Node::genTreeTop(ifMissing, intermediateBlocks[3]);
+      ifMissing->setBranchDestination(Bslow->getEntry());
+      }
+   else
+      {
+      auto *helperSymRef = symRefTab->findOrCreateRubyHelperSymbolRef(helper, true, true, false);
+      TR::Node *call = tempArg ?
+         TR::Node::createCallNode(node->getOpCodeValue(), helperSymRef, 2, recv, TR::Node::createLoad(tempArg)) :
+         TR::Node::createCallNode(node->getOpCodeValue(), helperSymRef, 1, recv);
+      tempResult = TR::Node::storeToTemp(call, Bfast);
+      }
+
+   genSlowSend(node, ci, tempRecv, tempResult, Bslow, Btail);
+   }
+
+/**
+ * RARRAY_LEN(ary).
+ *
+ * Both arms of the ternary are evaluated. For an embedded array the heap
+ * load reads the inline elements instead, which is harmless.
+ */
+TR::Node *
+Ruby::IlFastpather::genArrayLength(TR::Node *ary)
+   {
+   auto *symRefTab = comp()->getSymRefTab();
+   auto aryAddr  = TR::Node::x2a(ary);
+   auto flags    = TR::Node::xloadi(symRefTab->findOrCreateRubyBasicFlagsSymRef(), aryAddr, fe());
+   auto embedded = TR::Node::xcmpne(TR::Node::xand(flags, TR::Node::xconst(RARRAY_EMBED_FLAG)),
+                                    TR::Node::xconst(0));
+   return TR::Node::xternary(embedded,
+                             TR::Node::xshr(TR::Node::xand(flags, TR::Node::xconst(RARRAY_EMBED_LEN_MASK)),
+                                            TR::Node::iconst(RARRAY_EMBED_LEN_SHIFT)),
+                             TR::Node::xloadi(symRefTab->findOrCreateRubyArrayLenSymRef(), aryAddr, fe()));
+   }
+
+/**
+ * RARRAY_CONST_PTR(ary), as an integer.
+ */
+TR::Node *
+Ruby::IlFastpather::genArrayPointer(TR::Node *ary)
+   {
+   auto *symRefTab = comp()->getSymRefTab();
+   auto aryAddr  = TR::Node::x2a(ary);
+   auto flags    = TR::Node::xloadi(symRefTab->findOrCreateRubyBasicFlagsSymRef(), aryAddr, fe());
+   auto embedded = TR::Node::xcmpne(TR::Node::xand(flags, TR::Node::xconst(RARRAY_EMBED_FLAG)),
+                                    TR::Node::xconst(0));
+   return TR::Node::xternary(embedded,
+                             TR::Node::xadd(ary, TR::Node::xconst(offsetof(struct RArray, as.ary))),
+                             TR::Node::a2x(TR::Node::createWithSymRef(TR::aloadi, 1, 1, aryAddr,
+                                                                      symRefTab->findOrCreateRubyArrayPtrSymRef())));
+   }
+
+/**
+ * opt_ltlt only handles String and Array receivers itself; for anything
+ * else vm_opt_ltlt sends <<, filling the call info's cache. Once that cache
+ * holds Fixnum#<<, expand the shift like the send.
+ */
+void
+Ruby::IlFastpather::fastpathOptLtlt(TR::TreeTop *tt, TR::Node *node)
+   {
+   TR_ASSERT(node->getNumChildren() == 4 &&
+             node->getSecondChild()->getOpCodeValue() == TR::aconst,
+             "Unexpected children of vm_opt_ltlt call");
+
+   static auto *disableIntrinsics = feGetEnv("OMR_DISABLE_INTRINSICS");
+   if (disableIntrinsics)
+      return;
+
+   auto *ci = reinterpret_cast<rb_call_info_t *>(node->getSecondChild()->getAddress());
+   auto *me = getCachedMethodEntry(ci);
+   if (!me || me->def->type != VM_METHOD_TYPE_CFUNC)
+      return;
+
+   const RubyIntrinsic *intrinsic = findIntrinsic(ci, me);
+   if (intrinsic && intrinsic->intrinsic == FixnumLShift)
+      fastpathFixnumIntrinsic(tt, node, ci, FixnumLShift, node->getChild(2), node->getChild(3));
+   }
+
+/**
+ * Expand a Fixnum bitwise operator on tagged values (2n + 1):
+ *
+ *     B:     if (!FIXNUM_P(recv))                                 -> Bslow
+ *     B1:    if (!FIXNUM_P(arg))                                  -> Bslow   (binary operators)
+ *     B2:    if (RCLASS_SERIAL(rb_cFixnum) != <class_serial>)     -> Bslow
+ *     B3:    if (ruby_vm_global_method_state != <method_state>)   -> Bslow
+ *     B4:    if ((unsigned)FIX2LONG(arg) >= 63)                   -> Bslow   (shifts)
+ *     B5:    if (((recv - 1) << n) >> n != recv - 1)              -> Bslow   (left shift)
+ *     Bfast: a & b, a | b, (a ^ b) | 1, a ^ ~1, (a >> n) | 1 or ((a - 1) << n) | 1
+ *     Bslow: the original call
+ *            goto Btail
+ *
+ * The class serial of Fixnum changes when any of its methods is redefined,
+ * which is the redefinition guard. Negative and large shift counts, and
+ * left shifts that overflow into a Bignum, are left to the original call.
+ */
+void
+Ruby::IlFastpather::fastpathFixnumIntrinsic(TR::TreeTop *tt,
+                                            TR::Node *node,
+                                            rb_call_info_t *ci,
+                                            Intrinsic intrinsic,
+                                            TR::Node *recv,
+                                            TR::Node *arg)
+   {
+   auto* block = tt->getEnclosingBlock();
+
+   if (!performTransformation(comp(), "%s Expanding Fixnum intrinsic %s on TT %p\n", OPT_DETAILS,
+                              TR_RubyFE::instance()->getJitInterface()->callbacks.rb_id2name_f(ci->mid), tt))
+      return;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/intrinsic/Fixnum/%s",
+                                                                                     TR_RubyFE::instance()->getJitInterface()->callbacks.rb_id2name_f(ci->mid)));
+
+   auto *symRefTab = comp()->getSymRefTab();
+   bool isShift    = intrinsic == FixnumLShift || intrinsic == FixnumRShift;
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   TR::Node::anchorBefore(recv, tt);
+   if (arg)
+      TR::Node::anchorBefore(arg, tt);
+
+   uint32_t numIntermediateBlocks = 2 + (arg ? 1 : 0) + (isShift ? 1 : 0) + (intrinsic == FixnumLShift ? 1 : 0);
+   createMultiDiamond(tt, block, numIntermediateBlocks, Bfast, Bslow, Btail, intermediateBlocks);
+
+   TR::SymbolReference *tempRecv = TR::Node::storeToTemp(recv, block);
+   TR::SymbolReference *tempArg  = arg ? TR::Node::storeToTemp(arg, block) : NULL;
+
+   uint32_t next = 0;
+
+   auto ifRecvNotFixnum = genFixNumTest(recv);
+   TR::Node::genTreeTop(ifRecvNotFixnum, block);
+   ifRecvNotFixnum->setBranchDestination(Bslow->getEntry());
+
+   if (arg)
+      {
+      auto ifArgNotFixnum = genFixNumTest(arg);
+      TR::Node::genTreeTop(ifArgNotFixnum, intermediateBlocks[next++]);
+      ifArgNotFixnum->setBranchDestination(Bslow->getEntry());
+      }
+
+   auto classExt = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                              TR::Node::aconst((uintptr_t)ci->klass),
+                                              symRefTab->findOrCreateRubyClassExtSymRef());
+   auto ifClassChanged = TR::Node::ifxcmpne(TR::Node::xloadi(symRefTab->findOrCreateRubyClassSerialSymRef(), classExt, fe()),
+                                            TR::Node::xconst(ci->class_serial));
+   TR::Node::genTreeTop(ifClassChanged, intermediateBlocks[next++]);
+   ifClassChanged->setBranchDestination(Bslow->getEntry());
+
+   genMethodStateGuard(ci, intermediateBlocks[next++], Bslow);
+
+   TR::Node *count = NULL;
+   if (isShift)
+      {
+      // An unsigned compare also sends negative counts to the slow path.
+      auto n = TR::Node::xshr(arg, TR::Node::iconst(1));
+      auto ifCountOutOfRange = TR::Node::ifxucmpge(n, TR::Node::xconst(sizeof(VALUE) * CHAR_BIT - 1));
+      TR::Node::genTreeTop(ifCountOutOfRange, intermediateBlocks[next++]);
+      ifCountOutOfRange->setBranchDestination(Bslow->getEntry());
+      count = TR::Node::x2i(n);
+      }
+
+   TR::Node *result = NULL;
+   switch (intrinsic)
+      {
+      case FixnumAnd:
+         result = TR::Node::xand(recv, arg);
+         break;
+      case FixnumOr:
+         result = TR::Node::xior(recv, arg);
+         break;
+      case FixnumXor:
+         result = TR::Node::xior(TR::Node::xxor(recv, arg),
+                                 TR::Node::xconst(1));
+         break;
+      case FixnumNot:
+         result = TR::Node::xxor(recv, TR::Node::xconst(~(VALUE)1));
+         break;
+      case FixnumRShift:
+         result = TR::Node::xior(TR::Node::xshr(recv, count),
+                                 TR::Node::xconst(1));
+         break;
+      case FixnumLShift:
+         {
+         auto untagged = TR::Node::xsub(recv, TR::Node::xconst(1));
+         auto shifted  = TR::Node::xshl(untagged, count);
+         auto ifOverflow = TR::Node::ifxcmpne(TR::Node::xshr(shifted, count), untagged);
+         TR::Node::genTreeTop(ifOverflow, intermediateBlocks[next++]);
+         ifOverflow->setBranchDestination(Bslow->getEntry());
+         result = TR::Node::xior(shifted, TR::Node::xconst(1));
+         }
+         break;
+      default:
+         TR_ASSERT(0, "Not a Fixnum intrinsic");
+         break;
+      }
+   TR_ASSERT(next == numIntermediateBlocks, "Intermediate blocks left unused");
+
+   TR::SymbolReference *tempResult = TR::Node::storeToTemp(result, Bfast);
+
+   if (node->getSymbolReference()->getReferenceNumber() == RubyHelper_vm_opt_ltlt)
+      {
+      TR::Node *newCall = TR::Node::createCallNode(node->getOpCodeValue(),
+                                                   node->getSymbolReference(),
+                                                   4,
+                                                   TR::Node::loadThread(optimizer()->getMethodSymbol()),
+                                                   TR::Node::aconst((uintptr_t)ci),
+                                                   TR::Node::createLoad(tempRecv),
+                                                   TR::Node::createLoad(tempArg));
+      newCall->setByteCodeInfo(node->getByteCodeInfo());
+      TR::Node::genTreeTop(TR::Node::createStore(tempResult, newCall), Bslow);
+      TR::Node *gotoNode = TR::Node::create(TR::Goto, 0);
+      TR::Node::genTreeTop(gotoNode, Bslow);
+      gotoNode->setBranchDestination(Btail->getEntry());
+
+      node = TR::Node::recreate(node,
+         TR::Node::xloadOp(static_cast<TR_RubyFE*>(TR::comp()->fe())));
+
+      node->setSymbolReference(tempResult);
+      node->removeAllChildren();
+      }
+   else
+      {
+      genSlowSend(node, ci, tempRecv, tempResult, Bslow, Btail);
+      }
+   }
+
+/**
+ * Replace the slow path send in Bslow, and the original call in Btail, once
+ * the fast path has stored its result to `tempResult`.
+ */
+void
+Ruby::IlFastpather::genSlowSend(TR::Node *node,
+                                rb_call_info_t *ci,
+                                TR::SymbolReference *tempRecv,
+                                TR::SymbolReference *tempResult,
+                                TR::Block *Bslow,
+                                TR::Block *Btail)
+   {
+   TR::Node *newCall = TR::Node::createCallNode(node->getOpCodeValue(),
+                                                node->getSymbolReference(),
+                                                3,
+                                                TR::Node::loadThread(optimizer()->getMethodSymbol()),
+                                                TR::Node::aconst((uintptr_t)ci),
+                                                TR::Node::createLoad(tempRecv));
+   newCall->setByteCodeInfo(node->getByteCodeInfo());
+   TR::Node::genTreeTop(TR::Node::createStore(tempResult, newCall), Bslow);
+   TR::Node *gotoNode = TR::Node::create(TR::Goto, 0);
+   TR::Node::genTreeTop(gotoNode, Bslow);
+   gotoNode->setBranchDestination(Btail->getEntry());
+
+   // Now change the original call node in Btail to be a load
+   node = TR::Node::recreate(node,
+      TR::Node::xloadOp(static_cast<TR_RubyFE*>(TR::comp()->fe())));
+
+   node->setSymbolReference(tempResult);
+   node->removeAllChildren();
+   }
+
+/**
+ * Expand the sends to core iterators with a literal block, or a literal
+ * &:sym block, ahead of inlining. Only the sends ILGen kept the receiver of
+ * are considered.
+ */
+int32_t
+Ruby::IlFastpather::expandBlockIntrinsics()
+   {
+   static auto *disableIntrinsics = feGetEnv("OMR_DISABLE_INTRINSICS");
+   if (disableIntrinsics || !shouldPerform())
+      return 0;
+
+   auto lastTT = cfg()->findLastTreeTop();
+   for (auto tt = comp()->getMethodSymbol()->getFirstTreeTop();
+        tt != lastTT;
+        tt = tt->getNextTreeTop())
+      {
+      if (tt->getEnclosingBlock()->isCold())
+         continue;
+
+      auto *node = tt->getNode();
+      if (node->getOpCodeValue() == TR::treetop)
+         node = node->getFirstChild();
+
+      if (!node->getOpCode().isCall() ||
+          !node->getSymbol()->castToMethodSymbol()->isHelper() ||
+          node->getSymbolReference()->getReferenceNumber() != RubyHelper_vm_send)
+         continue;
+
+      if (!comp()->getSymRefTab()->getRubySendReceiverTempSymRef(node))
+         continue;
+
+      auto *ci = reinterpret_cast<rb_call_info_t *>(node->getSecondChild()->getAddress());
+      auto *me = getCachedMethodEntry(ci);
+      if (!me || me->def->type != VM_METHOD_TYPE_CFUNC)
+         continue;
+
+      // A &:sym block is only sent directly while Symbol#to_proc is the
+      // builtin, whose procs send the symbol.
+      rb_call_info_t *symbolCi = comp()->getSymRefTab()->getRubySendSymbolBlockCallInfo(node);
+      if (symbolCi && !isBuiltinSymbolToProc())
+         {
+         TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send/intrinsic/symbolBlock/redefined_to_proc"));
+         continue;
+         }
+
+      const RubyIntrinsic *intrinsic = findIntrinsic(ci, me, true /* withBlock */);
+      if (intrinsic)
+         fastpathBlockIntrinsic(tt, node, ci, intrinsic->intrinsic);
+      }
+
+   return 0;
+   }
+
+bool
+Ruby::BlockIntrinsicExpander::shouldPerform()
+   {
+   return IlFastpather::shouldPerform() &&
+          comp()->getMethodSymbol()->mayHaveInlineableCall() &&
+          !comp()->isDisabled(OMR::inlining);
+   }
+
+/**
+ * Whether Symbol#to_proc is still the builtin, as it is checked at compile
+ * time. Redefining it later changes the class serial of Symbol, which the
+ * expanded loops guard on.
+ */
+bool
+Ruby::IlFastpather::isBuiltinSymbolToProc()
+   {
+   auto *jitInterface = TR_RubyFE::instance()->getJitInterface();
+   VALUE symbolClass = *jitInterface->globals.ruby_rb_cSymbol_ptr;
+
+   VALUE definedClass;
+   rb_method_entry_t *me = (rb_method_entry_t*)jitInterface->callbacks.rb_method_entry_f(symbolClass, jitInterface->callbacks.rb_intern_f("to_proc"), &definedClass);
+   return me && me->def->type == VM_METHOD_TYPE_CFUNC && me->klass == symbolClass;
+   }
+
+/**
+ * Expand a send to a core iterator passing a literal block into a counted
+ * loop yielding to the block from compiled code:
+ *
+ *     B..B3: genSendCacheGuards, or for Integer#times a Fixnum
+ *            receiver and the class serial of Fixnum             -> Bslow
+ *     B4,B5: (RangeEach) if (!FIXNUM_P(beg) || !FIXNUM_P(end))   -> Bslow
+ *     Bsym:  (&:sym) if (RCLASS_SERIAL(rb_cSymbol) != serial)     -> Bslow
+ *     Bfast: i = 0, or FIX2LONG(beg) for Range#each
+ *            (ArrayMap) collect = rb_ary_new_capa(RARRAY_LEN(recv))
+ *     Bhead: if (i >= limit)                                      -> Bexit
+ *     Bbody: v = vm_yield_literal_block(th, ci, arg)
+ *            or for &:sym, v = vm_call_symbol_block(th, symbolCi, arg)
+ *            (ArrayMap) rb_ary_push(collect, v)
+ *            i = i + 1
+ *            asynccheck
+ *            goto Bhead
+ *     Bexit: result = recv, or collect for Array#map
+ *     Bslow: result = vm_send(th, ci, cfp)
+ *            goto Btail
+ *
+ * For Integer#times the limit is FIX2LONG(recv) and arg is LONG2FIX(i). For
+ * Range#each it is FIX2LONG(end), plus one unless the range excludes its
+ * end. For Array#each and Array#map it is RARRAY_LEN(recv), reloaded on
+ * every iteration as the block may resize the array, and arg is
+ * RARRAY_AREF(recv, i). This is what int_dotimes, range_each, rb_ary_each
+ * and rb_ary_collect do for these receivers.
+ *
+ * A &:sym block sends the symbol to each value through the inline cache of
+ * `symbolCi`, which ILGen made for the site, rather than through a proc.
+ *
+ * The inliner then inlines the block at the yields it can; `next` is a
+ * jump to the end of the block. Blocks that break are yielded to out of
+ * line, and the break unwinds to the catch table entry of the send just as
+ * it does from the C method.
+ */
+void
+Ruby::IlFastpather::fastpathBlockIntrinsic(TR::TreeTop *tt, TR::Node *node, rb_call_info_t *ci, Intrinsic intrinsic)
+   {
+   auto *symRefTab = comp()->getSymRefTab();
+
+   TR::SymbolReference *tempRecv = symRefTab->getRubySendReceiverTempSymRef(node);
+   TR_ASSERT(tempRecv, "Expanding a send whose receiver ILGen did not keep");
+
+   auto* block = tt->getEnclosingBlock();
+
+   const char *methodName = TR_RubyFE::instance()->getJitInterface()->callbacks.rb_id2name_f(ci->mid);
+   if (!performTransformation(comp(), "%s Expanding block intrinsic %s into a loop on TT %p\n", OPT_DETAILS, methodName, tt))
+      return;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send/intrinsic/%s", methodName));
+
+   bool isArray = intrinsic == ArrayEach || intrinsic == ArrayMap;
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   auto cfp = node->getChild(2);
+   TR::Node::anchorBefore(cfp, tt);
+
+   rb_call_info_t *symbolCi = symRefTab->getRubySendSymbolBlockCallInfo(node);
+
+   uint32_t numIntermediateBlocks = intrinsic == IntegerTimes ? 2 : (intrinsic == RangeEach ? 5 : 3);
+   uint32_t symbolGuardBlock      = numIntermediateBlocks;
+   if (symbolCi)
+      numIntermediateBlocks++;
+   createMultiDiamond(tt, block, numIntermediateBlocks, Bfast, Bslow, Btail, intermediateBlocks);
+
+   TR::SymbolReference *tempCFP = TR::Node::storeToTemp(cfp, block);
+
+   auto recv = TR::Node::createLoad(tempRecv);
+   if (intrinsic == IntegerTimes)
+      {
+      auto ifRecvNotFixnum = genFixNumTest(recv);
+      TR::Node::genTreeTop(ifRecvNotFixnum, block);
+      ifRecvNotFixnum->setBranchDestination(Bslow->getEntry());
+
+      auto classExt = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                                 TR::Node::aconst((uintptr_t)ci->klass),
+                                                 symRefTab->findOrCreateRubyClassExtSymRef());
+      auto ifClassChanged = TR::Node::ifxcmpne(TR::Node::xloadi(symRefTab->findOrCreateRubyClassSerialSymRef(), classExt, fe()),
+                                               TR::Node::xconst(ci->class_serial));
+      TR::Node::genTreeTop(ifClassChanged, intermediateBlocks[0]);
+      ifClassChanged->setBranchDestination(Bslow->getEntry());
+
+      genMethodStateGuard(ci, intermediateBlocks[1], Bslow);
+      }
+   else
+      {
+      genSendCacheGuards(recv, ci, block, intermediateBlocks, Bslow);
+      }
+
+   if (symbolCi)
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send/intrinsic/symbolBlock/%s", methodName));
+
+      auto *jitInterface = static_cast<TR_RubyFE*>(fe())->getJitInterface();
+      VALUE symbolClass  = *jitInterface->globals.ruby_rb_cSymbol_ptr;
+      VALUE symbolSerial = jitInterface->callbacks.rb_class_serial_f(symbolClass);
+      auto classExt = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                                 TR::Node::aconst((uintptr_t)symbolClass),
+                                                 symRefTab->findOrCreateRubyClassExtSymRef());
+      auto ifToProcChanged = TR::Node::ifxcmpne(TR::Node::xloadi(symRefTab->findOrCreateRubyClassSerialSymRef(), classExt, fe()),
+                                                TR::Node::xconst(symbolSerial));
+      TR::Node::genTreeTop(ifToProcChanged, intermediateBlocks[symbolGuardBlock]);
+      ifToProcChanged->setBranchDestination(Bslow->getEntry());
+      }
+
+   TR::SymbolReference *tempIndex   = symRefTab->createTemporary(comp()->getMethodSymbol(), TR_RubyFE::slotType());
+   TR::SymbolReference *tempLimit   = NULL;
+   TR::SymbolReference *tempCollect = NULL;
+   switch (intrinsic)
+      {
+      case IntegerTimes:
+         TR::Node::genTreeTop(TR::Node::createStore(tempIndex, TR::Node::xconst(0)), Bfast);
+         tempLimit = TR::Node::storeToTemp(TR::Node::xshr(recv, TR::Node::iconst(1)), Bfast);
+         break;
+
+      case RangeEach:
+         {
+         // A Range is a Struct with its begin, end and exclude_end members
+         // embedded.
+         auto member = [&](int32_t i)
+            {
+            auto slot = TR::Node::x2a(TR::Node::xadd(recv, TR::Node::xconst(offsetof(struct RStruct, as.ary) + i * TR_RubyFE::SLOTSIZE)));
+            return TR::Node::xloadi(symRefTab->findOrCreateRubyObjectSlotSymRef(), slot, fe());
+            };
+         auto beg  = member(0);
+         auto end  = member(1);
+         auto excl = member(2);
+
+         auto ifBegNotFixnum = genFixNumTest(beg);
+         TR::Node::genTreeTop(ifBegNotFixnum, intermediateBlocks[3]);
+         ifBegNotFixnum->setBranchDestination(Bslow->getEntry());
+
+         auto ifEndNotFixnum = genFixNumTest(end);
+         TR::Node::genTreeTop(ifEndNotFixnum, intermediateBlocks[4]);
+         ifEndNotFixnum->setBranchDestination(Bslow->getEntry());
+
+         auto inclusive = TR::Node::xcmpeq(TR::Node::xand(excl, TR::Node::xconst(~Qnil)),
+                                           TR::Node::xconst(0));
+         TR::Node::genTreeTop(TR::Node::createStore(tempIndex, TR::Node::xshr(beg, TR::Node::iconst(1))), Bfast);
+         tempLimit = TR::Node::storeToTemp(TR::Node::xadd(TR::Node::xshr(end, TR::Node::iconst(1)),
+                                                          TR::Node::i2x(inclusive)),
+                                           Bfast);
+         }
+         break;
+
+      case ArrayMap:
+         {
+         auto *newSymRef = symRefTab->findOrCreateRubyHelperSymbolRef(RubyHelper_rb_ary_new_capa, true, true, false);
+         tempCollect = TR::Node::storeToTemp(TR::Node::createCallNode(node->getOpCodeValue(), newSymRef, 1, genArrayLength(recv)),
+                                             Bfast);
+         }
+         // fall through
+      case ArrayEach:
+         TR::Node::genTreeTop(TR::Node::createStore(tempIndex, TR::Node::xconst(0)), Bfast);
+         break;
+
+      default:
+         TR_ASSERT(0, "Unexpected block intrinsic %d", intrinsic);
+         break;
+      }
+
+   TR::Block *Bhead = TR::Block::createEmptyBlock(comp());
+   TR::Block *Bbody = TR::Block::createEmptyBlock(comp());
+   TR::Block *Bexit = TR::Block::createEmptyBlock(comp());
+   cfg()->addNode(Bhead);
+   cfg()->addNode(Bbody);
+   cfg()->addNode(Bexit);
+   Bfast->getExit()->join(Bhead->getEntry());
+   Bhead->getExit()->join(Bbody->getEntry());
+   Bbody->getExit()->join(Bexit->getEntry());
+   Bexit->getExit()->join(Btail->getEntry());
+   cfg()->addEdge(Bfast, Bhead);
+   cfg()->addEdge(Bhead, Bbody);
+   cfg()->addEdge(Bhead, Bexit);
+   cfg()->addEdge(Bbody, Bhead);
+   cfg()->addEdge(Bexit, Btail);
+   cfg()->removeEdge(Bfast, Btail);   // replaced
+
+   auto limit  = isArray ? genArrayLength(TR::Node::createLoad(tempRecv)) : TR::Node::createLoad(tempLimit);
+   auto ifDone = TR::Node::ifxcmpge(TR::Node::createLoad(tempIndex), limit);
+   TR::Node::genTreeTop(ifDone, Bhead);
+   ifDone->setBranchDestination(Bexit->getEntry());
+
+   TR::Node *arg;
+   if (isArray)
+      {
+      auto offset = TR::Node::xmul(TR::Node::createLoad(tempIndex), TR::Node::xconst(TR_RubyFE::SLOTSIZE));
+      auto slot   = TR::Node::x2a(TR::Node::xadd(genArrayPointer(TR::Node::createLoad(tempRecv)), offset));
+      arg = TR::Node::xloadi(symRefTab->findOrCreateRubyObjectSlotSymRef(), slot, fe());
+      }
+   else
+      {
+      arg = TR::Node::xior(TR::Node::xshl(TR::Node::createLoad(tempIndex), TR::Node::iconst(1)),
+                           TR::Node::xconst(1));
+      }
+
+   // The yield is a treetop of its own, where the inliner looks for calls.
+   auto *yieldSymRef = symRefTab->findOrCreateRubyHelperSymbolRef(symbolCi ? RubyHelper_vm_call_symbol_block : RubyHelper_vm_yield_literal_block,
+                                                                  true, true, false);
+   auto yield = TR::Node::createCallNode(node->getOpCodeValue(), yieldSymRef, 3,
+                                         TR::Node::loadThread(optimizer()->getMethodSymbol()),
+                                         TR::Node::aconst((uintptr_t)(symbolCi ? symbolCi : ci)),
+                                         arg);
+   TR::Node::genTreeTop(yield, Bbody);
+   if (tempCollect)
+      {
+      auto *pushSymRef = symRefTab->findOrCreateRubyHelperSymbolRef(RubyHelper_rb_ary_push, true, true, false);
+      TR::Node::genTreeTop(TR::Node::createCallNode(node->getOpCodeValue(), pushSymRef, 2,
+                                                    TR::Node::createLoad(tempCollect), yield),
+                           Bbody);
+      }
+   TR::Node::genTreeTop(TR::Node::createStore(tempIndex,
+                                              TR::Node::xadd(TR::Node::createLoad(tempIndex), TR::Node::xconst(1))),
+                        Bbody);
+   TR::Node::genTreeTop(TR::Node::createWithSymRef(TR::asynccheck, 0,
+                                                   symRefTab->findOrCreateAsyncCheckSymbolRef(comp()->getMethodSymbol())),
+                        Bbody);
+   TR::Node *gotoNode = TR::Node::create(TR::Goto, 0);
+   TR::Node::genTreeTop(gotoNode, Bbody);
+   gotoNode->setBranchDestination(Bhead->getEntry());
+
+   TR::SymbolReference *tempResult = TR::Node::storeToTemp(TR::Node::createLoad(tempCollect ? tempCollect : tempRecv), Bexit);
+
+   // The third child of vm_send is the cfp rather than the receiver.
+   genSlowSend(node, ci, tempCFP, tempResult, Bslow, Btail);
+   }
+
+/**
+ * Turn a send to an ISEQ method into a direct call to its compiled body:
+ *
+ *     B..B3: genSendCacheGuards                                   -> Bslow
+ *     B4:    body = <iseq>->jit.body_info
+ *            if (body == NULL)                                    -> Bslow
+ *     Bfast: vm_send_woblock_jit_inline_frame(th, ci, recv)
+ *            result = jit_dispatch(th, body->startPC)
+ *     Bslow: result = vm_send_without_block(th, ci, recv)
+ *            goto Btail
+ *
+ * The frame is pushed the way the inliner pushes it, and the callee's body
+ * pops it on return.
+ *
+ * The body is read through the iseq on every call, so a callee that is
+ * compiled (or recompiled) after this body picks up the direct call without
+ * any patching. Until then the send takes the slow path, where the VM may
+ * decide to compile it.
+ */
+void
+Ruby::IlFastpather::fastpathDirectSend(TR::TreeTop *tt, TR::Node *node, rb_call_info_t *ci, rb_iseq_t *iseq)
+   {
+   auto* block = tt->getEnclosingBlock();
+
+   if (!performTransformation(comp(), "%s Direct send to iseq %p for ci %p on TT %p\n", OPT_DETAILS, iseq, ci, tt))
+      return;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/direct"));
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   auto *symRefTab = comp()->getSymRefTab();
+
+   auto recv = node->getChild(2);
+   TR::Node::anchorBefore(recv, tt);
+
+   createMultiDiamond(tt, block, 4, Bfast, Bslow, Btail, intermediateBlocks);
+
+   TR::SymbolReference *tempRecv = TR::Node::storeToTemp(recv, block);
+
+   genSendCacheGuards(recv, ci, block, intermediateBlocks, Bslow);
+
+   TR::Block *B4 = intermediateBlocks[3];
+   auto body = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                          TR::Node::aconst((uintptr_t)iseq),
+                                          symRefTab->findOrCreateRubyISeqJitBodyInfoSymRef());
+   TR::SymbolReference *tempBody = TR::Node::storeToTemp(body, B4);
+   auto ifNotCompiled = TR::Node::createif(TR::ifacmpeq, body, TR::Node::aconst(0));
+   TR::Node::genTreeTop(ifNotCompiled, B4);
+   ifNotCompiled->setBranchDestination(Bslow->getEntry());
+
+   auto *frameSymRef    = symRefTab->findOrCreateRubyHelperSymbolRef(RubyHelper_vm_send_woblock_jit_inline_frame,
+                                                                     true, true, false);
+   auto *dispatchSymRef = symRefTab->findOrCreateRubyHelperSymbolRef(RubyHelper_jit_dispatch,
+                                                                     true, true, false);
+   TR::Node::genTreeTop(TR::Node::createCallNode(node->getOpCodeValue(),
+                                                 frameSymRef,
+                                                 3,
+                                                 TR::Node::loadThread(optimizer()->getMethodSymbol()),
+                                                 TR::Node::aconst((uintptr_t)ci),
+                                                 TR::Node::createLoad(tempRecv)),
+                        Bfast);
+   auto startPC = TR::Node::createWithSymRef(TR::aloadi, 1, 1,
+                                             TR::Node::createLoad(tempBody),
+                                             symRefTab->findOrCreateRubyJitStartPCSymRef());
+   TR::Node *directCall = TR::Node::createCallNode(node->getOpCodeValue(),
+                                                   dispatchSymRef,
+                                                   2,
+                                                   TR::Node::loadThread(optimizer()->getMethodSymbol()),
+                                                   startPC);
+   TR::SymbolReference *tempResult = TR::Node::storeToTemp(directCall, Bfast);
+
+   genSlowSend(node, ci, tempRecv, tempResult, Bslow, Btail);
+   }
+
+/**
+ * Turn a send to an attr_reader or attr_writer method into the ivar access
+ * it performs, as vm_call_ivar/vm_call_attrset would:
+ *
+ *     B..B4: genIvarGuards, against the cached class and ivar index -> Bslow
+ *     B5:    genMethodStateGuard                                    -> Bslow
+ *     Bfast: reader: result = slot == Qundef ? Qnil : slot
+ *            writer: slot = value; write barrier; result = value
+ *     Bslow: result = vm_send_without_block(th, ci, recv)
+ *            goto Btail
+ *
+ * The writer's argument is found through the temp the IL generator stores
+ * one-argument sends' argument to.
+ */
+void
+Ruby::IlFastpather::fastpathAttrAccessor(TR::TreeTop *tt, TR::Node *node, rb_call_info_t *ci, bool isSet)
+   {
+   auto *symRefTab = comp()->getSymRefTab();
+
+   TR::SymbolReference *tempValue = NULL;
+   if (isSet)
+      {
+      tempValue = symRefTab->getRubySendArgumentTempSymRef(node);
+      if (!tempValue)
+         return;
+      }
+
+   auto* block = tt->getEnclosingBlock();
+
+   if (!performTransformation(comp(), "%s Fastpathing %s on TT %p\n", OPT_DETAILS, isSet ? "attr_writer" : "attr_reader", tt))
+      return;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/%s", isSet ? "attr_writer" : "attr_reader"));
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   auto recv = node->getChild(2);
+   TR::Node::anchorBefore(recv, tt);
+
+   createMultiDiamond(tt, block, 5, Bfast, Bslow, Btail, intermediateBlocks);
+
+   TR::SymbolReference *tempRecv = TR::Node::storeToTemp(recv, block);
+
+   auto slot = genIvarGuards(recv,
+                             TR::Node::xconst(ci->class_serial),
+                             TR::Node::xconst(ci->aux.index - 1),
+                             isSet ? T_MASK | FL_FREEZE : T_MASK,
+                             block, intermediateBlocks, Bslow);
+   genMethodStateGuard(ci, intermediateBlocks[4], Bslow);
+
+   TR::SymbolReference *tempResult;
+   if (isSet)
+      {
+      auto value = TR::Node::createLoad(tempValue);
+      TR::Node::genTreeTop(TR::Node::xstorei(symRefTab->findOrCreateRubyObjectSlotSymRef(),
+                                             slot,
+                                             value,
+                                             static_cast<TR_RubyFE*>(fe())),
+                           Bfast);
+      tempResult = TR::Node::storeToTemp(value, Bfast);
+      genWriteBarrier(recv, value, Bfast, Btail);
+      }
+   else
+      {
+      // An unset ivar reads as nil, without the warning getinstancevariable gives.
+      auto value = TR::Node::xloadi(symRefTab->findOrCreateRubyObjectSlotSymRef(), slot, fe());
+      auto isUndef = TR::Node::xcmpeq(value, TR::Node::xconst(Qundef));
+      tempResult = TR::Node::storeToTemp(TR::Node::xternary(isUndef, TR::Node::xconst(Qnil), value), Bfast);
+      }
+
+   genSlowSend(node, ci, tempRecv, tempResult, Bslow, Btail);
+   }
+
+/**
+ * Turn a send to a Struct member accessor into the member access:
+ *
+ *     B..B3: genSendCacheGuards                                   -> Bslow
+ *     B4:    (setter only) if (RBASIC(recv)->flags & FL_FREEZE)   -> Bslow
+ *     Bfast: ptr = embedded ? RSTRUCT(recv)->as.ary : RSTRUCT(recv)->as.heap.ptr
+ *            getter: result = ptr[member]
+ *            setter: ptr[member] = value; write barrier; result = value
+ *     Bslow: result = vm_send_without_block(th, ci, recv)
+ *            goto Btail
+ *
+ * All instances of a Struct class have the same members, so the class
+ * guard also proves that the member index is in range.
+ */
+void
+Ruby::IlFastpather::fastpathStructAccessor(TR::TreeTop *tt, TR::Node *node, rb_call_info_t *ci, int32_t member, bool isSet)
+   {
+   auto *symRefTab = comp()->getSymRefTab();
+
+   TR::SymbolReference *tempValue = NULL;
+   if (isSet)
+      {
+      tempValue = symRefTab->getRubySendArgumentTempSymRef(node);
+      if (!tempValue)
+         return;
+      }
+
+   auto* block = tt->getEnclosingBlock();
+
+   if (!performTransformation(comp(), "%s Fastpathing %s of member %d on TT %p\n", OPT_DETAILS, isSet ? "struct aset" : "struct aref", member, tt))
+      return;
+
+   TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/%s", isSet ? "struct_aset" : "struct_aref"));
+
+   TR::Block *Bfast, *Bslow, *Btail;
+   CS2::ArrayOf<TR::Block *, TR::Allocator> intermediateBlocks(comp()->allocator());
+
+   auto recv = node->getChild(2);
+   TR::Node::anchorBefore(recv, tt);
+
+   createMultiDiamond(tt, block, isSet ? 4 : 3, Bfast, Bslow, Btail, intermediateBlocks);
+
+   TR::SymbolReference *tempRecv = TR::Node::storeToTemp(recv, block);
+
+   genSendCacheGuards(recv, ci, block, intermediateBlocks, Bslow);
+
+   auto recvAddr = TR::Node::x2a(recv);
+   auto flags    = TR::Node::xloadi(symRefTab->findOrCreateRubyBasicFlagsSymRef(), recvAddr, fe());
+   if (isSet)
+      {
+      auto ifFrozen = TR::Node::ifxcmpne(TR::Node::xand(flags, TR::Node::xconst(FL_FREEZE)),
+                                         TR::Node::xconst(0));
+      TR::Node::genTreeTop(ifFrozen, intermediateBlocks[3]);
+      ifFrozen->setBranchDestination(Bslow->getEntry());
+      }
+
+   // Both arms of a ternary are evaluated. For an embedded struct the heap
+   // pointer load reads the first member instead, which is harmless.
+   auto embedded = TR::Node::xcmpne(TR::Node::xand(flags, TR::Node::xconst(RSTRUCT_EMBED_LEN_MASK)),
+                                    TR::Node::xconst(0));
+   auto ptr  = TR::Node::xternary(embedded,
+                                  TR::Node::xadd(recv, TR::Node::xconst(offsetof(struct RStruct, as.ary))),
+                                  TR::Node::a2x(TR::Node::createWithSymRef(TR::aloadi, 1, 1, recvAddr,
+                                                                           symRefTab->findOrCreateRubyStructHeapPtrSymRef())));
+   auto slot = TR::Node::x2a(TR::Node::xadd(ptr, TR::Node::xconst(member * TR_RubyFE::SLOTSIZE)));
+
+   TR::SymbolReference *tempResult;
+   if (isSet)
+      {
+      auto value = TR::Node::createLoad(tempValue);
+      TR::Node::genTreeTop(TR::Node::xstorei(symRefTab->findOrCreateRubyObjectSlotSymRef(),
+                                             slot,
+                                             value,
+                                             static_cast<TR_RubyFE*>(fe())),
+                           Bfast);
+      tempResult = TR::Node::storeToTemp(value, Bfast);
+      genWriteBarrier(recv, value, Bfast, Btail);
+      }
+   else
+      {
+      tempResult = TR::Node::storeToTemp(TR::Node::xloadi(symRefTab->findOrCreateRubyObjectSlotSymRef(), slot, fe()),
+                                         Bfast);
+      }
+
+   genSlowSend(node, ci, tempRecv, tempResult, Bslow, Btail);
+   }
+
+/**
+ * Generate the generational write barrier for storing `value` into `obj`,
+ * after the trees already in `B`:
+ *
+ *     B:   if (value & RUBY_IMMEDIATE_MASK) -> Btail
+ *     Bi:  if (!RTEST(value))               -> Btail
+ *     Bwb: rb_gc_writebarrier(obj, value)
+ *     Btail:
+ *
+ * `B` must be the block immediately preceding `Btail`, and `obj` and `value`
+ * must be usable in B.
+ */
+void
+Ruby::IlFastpather::genWriteBarrier(TR::Node *obj, TR::Node *value, TR::Block *B, TR::Block *Btail)
+   {
+   auto ifImmediate = TR::Node::ifxcmpne(TR::Node::xand(value, TR::Node::xconst(RUBY_IMMEDIATE_MASK)),
+                                         TR::Node::xconst(0));
+   TR::Node::genTreeTop(ifImmediate, B);
+   ifImmediate->setBranchDestination(Btail->getEntry());
+
+   TR::Block *Bi = appendBlockAfter(B, Btail);
+   auto ifFalsy = TR::Node::ifxcmpeq(TR::Node::xand(value, TR::Node::xconst(~Qnil)),
+                                     TR::Node::xconst(0));
+   TR::Node::genTreeTop(ifFalsy, Bi);
+   ifFalsy->setBranchDestination(Btail->getEntry());
+
+   TR::Block *Bwb = appendBlockAfter(Bi, Btail);
+   auto *barrierSymRef = comp()->getSymRefTab()->findOrCreateRubyHelperSymbolRef(RubyHelper_rb_gc_writebarrier,
+                                                                                 true, true, false);
+   TR::Node::genTreeTop(TR::Node::createCallNode(TR::call, barrierSymRef, 2, obj, value), Bwb);
+   }
+
+/**
+ * Insert a new, empty block between `Bprev` and its fall through successor
+ * `Bnext`, as an extension of `Bprev`. Any existing edge from `Bprev` to
+ * `Bnext` is kept, as it is assumed to be used by a branch.
+ */
+TR::Block *
+Ruby::IlFastpather::appendBlockAfter(TR::Block *Bprev, TR::Block *Bnext)
+   {
+   TR::Block *Bi = TR::Block::createEmptyBlock(comp());
+   cfg()->addNode(Bi);
+   cfg()->addEdge(Bprev, Bi);
+   cfg()->addEdge(Bi, Bnext);
+   Bprev->getExit()->join(Bi->getEntry());
+   Bi->getExit()->join(Bnext->getEntry());
+   Bi->setIsExtensionOfPreviousBlock();
+   return Bi;
+   }
+
 /**
  * Originally:
  *
@@ -27,6 +27,8 @@
 #include "vm_insnhelper.h" // For BOP_MINUS and FIXNUM_REDEFINED_OP_FLAG etc.
 
 
+struct RubyIntrinsic;
+
 namespace Ruby
 {
 /**
@@ -51,6 +53,40 @@ class IlFastpather : public TR::Optimization
 
    TR::CFG * cfg() { return comp()->getFlowGraph(); } 
 
+   /**
+    * How an entry of the intrinsic table is expanded.
+    */
+   enum Intrinsic
+      {
+      ArrayFirst,
+      ArrayLast,
+      HelperCall,
+      HashFetch,
+      IntegerTimes,
+      RangeEach,
+      ArrayEach,
+      ArrayMap,
+      FixnumAnd,
+      FixnumOr,
+      FixnumXor,
+      FixnumNot,
+      FixnumRShift,
+      FixnumLShift,
+      };
+
+   static bool isFixnumIntrinsic(Intrinsic intrinsic) { return intrinsic >= FixnumAnd; }
+
+   /**
+    * Iterators expanded into loops at sends passing a literal block.
+    */
+   static bool isBlockIntrinsic(Intrinsic intrinsic) { return intrinsic >= IntegerTimes && intrinsic <= ArrayMap; }
+
+   /**
+    * Expand sends to the core iterators into loops yielding to their
+    * literal block; see BlockIntrinsicExpander.
+    */
+   int32_t expandBlockIntrinsics();
+
    virtual int32_t      perform(); 
    virtual bool         shouldPerform() { 
       static auto * disableIlFastpather = feGetEnv("OMR_DISABLE_FASTPATH"); 
@@ -69,8 +105,50 @@ class IlFastpather : public TR::Optimization
 
    TR::TreeTop * genTreeTop(TR::Node*, TR::Block*); 
 
+   TR::Node *genPlusMinusOperand(TR::Node *, bool);
+   TR::Node *genPlusMinusOverflowTest(TR::Node *, TR::Node *, bool);
+   TR::Node *genPlusMinusResult(TR::Node *, TR::Node *, bool);
+   bool      isPlusMinusCall(TR::Node *);
+   bool      isPCStore(TR::Node *);
+   bool      isMovableOperand(TR::Node *);
+   int32_t   collectArithmeticChain(TR::TreeTop *, TR::TreeTop **, TR::TreeTop **);
+
    void fastpathPlusMinus(TR::TreeTop *, TR::Node *,  bool);
+   bool fastpathArithmeticChain(TR::TreeTop *, TR::Node *);
    void fastpathGE       (TR::TreeTop *, TR::Node *);
+   void fastpathGetIvar  (TR::TreeTop *, TR::Node *);
+   void fastpathSetIvar  (TR::TreeTop *, TR::Node *);
+   void fastpathSendWithoutBlock(TR::TreeTop *, TR::Node *);
+   void fastpathDirectSend    (TR::TreeTop *, TR::Node *, rb_call_info_t *, rb_iseq_t *);
+   void fastpathAttrAccessor  (TR::TreeTop *, TR::Node *, rb_call_info_t *, bool);
+   void fastpathStructAccessor(TR::TreeTop *, TR::Node *, rb_call_info_t *, int32_t, bool);
+   void fastpathIntrinsic     (TR::TreeTop *, TR::Node *, rb_call_info_t *, Intrinsic, TR_RuntimeHelper);
+   void fastpathFixnumIntrinsic(TR::TreeTop *, TR::Node *, rb_call_info_t *, Intrinsic, TR::Node *, TR::Node *);
+   void fastpathOptLtlt       (TR::TreeTop *, TR::Node *);
+   void fastpathBlockIntrinsic(TR::TreeTop *, TR::Node *, rb_call_info_t *, Intrinsic);
+   void foldConstantCache(TR::TreeTop *, TR::Node *);
+
+   const rb_method_entry_t *getCachedMethodEntry(rb_call_info_t *);
+   bool                     isDirectSendTarget(rb_call_info_t *, rb_iseq_t *);
+   int32_t                  getStructMemberIndex(rb_iseq_t *, bool &);
+   const RubyIntrinsic     *findIntrinsic(rb_call_info_t *, const rb_method_entry_t *, bool withBlock = false);
+   bool                     isBuiltinSymbolToProc();
+
+   bool isConstantCacheCheck(TR::Node *);
+
+   TR::Node *genIvarGuards(TR::Node *, TR::Node *, TR::Node *, uintptr_t, TR::Block *,
+                           CS2::ArrayOf<TR::Block *, TR::Allocator> &, TR::Block *);
+   TR::Node *loadICSerial(TR::Node *);
+   TR::Node *loadICIndex (TR::Node *);
+   void      genSendCacheGuards(TR::Node *, rb_call_info_t *, TR::Block *,
+                                CS2::ArrayOf<TR::Block *, TR::Allocator> &, TR::Block *);
+   void      genMethodStateGuard(rb_call_info_t *, TR::Block *, TR::Block *);
+   void      genSlowSend(TR::Node *, rb_call_info_t *, TR::SymbolReference *, TR::SymbolReference *,
+                         TR::Block *, TR::Block *);
+   void      genWriteBarrier(TR::Node *, TR::Node *, TR::Block *, TR::Block *);
+   TR::Node *genArrayLength(TR::Node *);
+   TR::Node *genArrayPointer(TR::Node *);
+   TR::Block *appendBlockAfter(TR::Block *, TR::Block *);
 
    // There is also an implementation of this function inside the pythonFE
    // that uses STL containers. We ought to common with that version. 
@@ -86,6 +164,32 @@ class IlFastpather : public TR::Optimization
 
    };
 
+/**
+ * Optimization class that expands the sends to core iterators passing a
+ * literal block into loops, with the fast paths of the IlFastpather. It
+ * runs ahead of the inliner, which then inlines the block at the yields of
+ * the loops, and only where the inliner runs.
+ */
+class BlockIntrinsicExpander : public IlFastpather
+   {
+   public:
+
+   BlockIntrinsicExpander(TR::OptimizationManager * manager)
+      : IlFastpather(manager)
+      {}
+
+   /**
+    * Optimization factory method
+    */
+   static TR::Optimization *create(TR::OptimizationManager *manager)
+      {
+      return new (manager->allocator()) BlockIntrinsicExpander(manager);
+      }
+
+   virtual int32_t      perform() { return expandBlockIntrinsics(); }
+   virtual bool         shouldPerform();
+   };
+
 }
 
 
@@ -107,133 +107,80 @@ TR_InlinerBase::checkInlineableWithoutInitialCalleeSymbol (TR_CallSite* callSite
    {
    TR::Node* node = callSite->_callNode;
 
-   if(node->getSymbolReference() != comp->getSymRefTab()->getSymRef(RubyHelper_vm_send_without_block))
-       return Ruby_unsupported_calltype;
-
-  //Ensure that ILGen hasn't changed the children's layout we expect.
-  TR_ASSERT(  ((node->getNumChildren() == 3) &&
-       node->getSecondChild() &&
-       node->getSecondChild()->getOpCodeValue() == TR::aconst), "Unexpected children in hierarchy of vm_send_without_block when creating callsite target.");
-/*
- * Preconditions:
- *     true == (ci->me->def->type == VM_METHOD_TYPE_ISEQ)
- *             If its not a proper Ruby method, all bets are off.
- *     true == (iseq->arg_simple & 0x01)
- *             Have simple args, otherwise in vm_callee_setup_arg we have to handle (ci->aux.opt_pc != 0)
- *             And that requires multiple method entry.
- *     false == (ci->flag & VM_CALL_TAILCALL)
- *             Here we're handling the case of normal calls via vm_call_iseq_setup_normal.
- *             For TailCalls we will need to work with vm_call_iseq_setup_tailcall.
- *             The JIT currently doesn't compile methods of type VM_CALL_TAILCALL.
- */
-
-   rb_call_info_t *ci = (rb_call_info_t *) node->getSecondChild()->getAddress();
-
-
-#ifdef OMR_JIT_PROFILE
-   VALUE klass = ci->profiled_klass;
-#else
-   VALUE klass = Qundef;
-#endif
-   if(klass == Qnil || klass == Qundef)
+   //Yields are inlined only when the block is known, which
+   //TR_Ruby_InvokeBlock_CallSite::findCallSiteTarget decides.
+   if(node->getSymbolReference() == comp->getSymRefTab()->getSymRef(RubyHelper_vm_invokeblock))
      {
-     if(klass == Qnil)
-        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/ambiguious_profiled_klass/Qnil"));
-     else
-        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/ambiguious_profiled_klass/Qundef"));
-     return Ruby_ambiguious_profiled_klass;
+     rb_call_info_t *ci = (rb_call_info_t *) node->getSecondChild()->getAddress();
+     if (ci->flag & (VM_CALL_ARGS_SPLAT | VM_CALL_ARGS_BLOCKARG))
+        {
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/invokeblock/notInlineable/splat"));
+        return Ruby_unsupported_calltype;
+        }
+     return InlineableTarget;
      }
 
-#ifdef OMR_RUBY_VALID_CLASS
-   if(!TR_RubyFE::instance()->getJitInterface()->callbacks.ruby_omr_is_valid_object_f(klass))
-#endif
-      {
-      TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/invalid_klass"));
-      return Ruby_invalid_klass;
-      }
-
-   VALUE actual_klass;
-   rb_method_entry_t *me = (rb_method_entry_t*)TR_RubyFE::instance()->getJitInterface()->callbacks.rb_method_entry_f(klass, ci->mid, &actual_klass);
-
-   if(!me)
-     {
-     TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/missing_method_entry"));
-     return Ruby_missing_method_entry;
-     }
+   //Yields of the loops expanded from core iterators go to the send's own
+   //literal block.
+   if(node->getSymbolReference() == comp->getSymRefTab()->getSymRef(RubyHelper_vm_yield_literal_block))
+     return InlineableTarget;
 
-   //Ruby dispatch favours me->flag values, 0x0(NOEX_PUBLIC) and 0x8(NOEX_BASIC)
-   //TODO: investigate the other values.
-   if(me->flag != 0 && me->flag != 0x8)
+   //Sends with a block are inlined only for literal blocks, whose receiver
+   //ILGen kept in a temporary.
+   if(node->getSymbolReference() == comp->getSymRefTab()->getSymRef(RubyHelper_vm_send))
      {
-     char flag[15];
-     snprintf(flag, 15, "0x%x", me->flag);
-     TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/unsupported_method_entry_flag/%s", flag));
-     return Ruby_unsupported_method_entry_flag;
+     if (!comp->getSymRefTab()->getRubyInlinedReceiverTempSymRef(callSite))
+        {
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send/notInlineable/not_literal_block"));
+        return Ruby_unsupported_calltype;
+        }
+     //A literal &:sym block is dispatched directly by the fastpather's
+     //loops, but there is no block iseq to inline the callee with.
+     rb_call_info_t *ci = (rb_call_info_t *) node->getSecondChild()->getAddress();
+     if (ci->flag & VM_CALL_ARGS_BLOCKARG)
+        {
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send/notInlineable/block_arg"));
+        return Ruby_unsupported_calltype;
+        }
      }
+   else if(node->getSymbolReference() != comp->getSymRefTab()->getSymRef(RubyHelper_vm_send_without_block) &&
+           node->getSymbolReference() != comp->getSymRefTab()->getSymRef(RubyHelper_vm_send_symbol_without_block))
+       return Ruby_unsupported_calltype;
 
-   char methodName[64];
-   snprintf(methodName, 64, "%s", TR_RubyFE::instance()->getJitInterface()->callbacks.rb_id2name_f(ci->mid));
-   char klassName[64];
-   snprintf(klassName, 64, "%s", TR_RubyFE::instance()->getJitInterface()->callbacks.rb_class2name_f(klass));
+  //Ensure that ILGen hasn't changed the children's layout we expect.
+  TR_ASSERT(  ((node->getNumChildren() >= 3) &&
+       node->getSecondChild() &&
+       node->getSecondChild()->getOpCodeValue() == TR::aconst), "Unexpected children in hierarchy of vm_send_without_block when creating callsite target.");
 
-   //If this isn't a proper Ruby method, don't inline.
-   switch(me->def->type)
-      {
-      case VM_METHOD_TYPE_ISEQ:
-         break;
-      case VM_METHOD_TYPE_CFUNC:
-         TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/inlining_cfunc/%s/%s", klassName,methodName));
-         return Ruby_inlining_cfunc;
-      default:
-         TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/inlining_non_iseq_method/%s/%s", klassName,methodName));
-         return Ruby_non_iseq_method;
-      }
+   rb_call_info_t *ci = (rb_call_info_t *) node->getSecondChild()->getAddress();
 
-   rb_iseq_t *iseq_callee = me->def->body.iseq;
-
-
-   //Check if the callee has optional arguments.
-   //We do not support inlining such callees yet.
-   bool check_arg_opts     = (iseq_callee->param.flags.has_opt    != 0);
-   bool check_arg_rest     = (iseq_callee->param.flags.has_rest   != 0);
-   bool check_arg_post_len = (iseq_callee->param.flags.has_post   != 0);
-   bool check_arg_block    = (iseq_callee->param.flags.has_block  != 0);
-   bool check_arg_keywords = (iseq_callee->param.flags.has_kw     != 0);
-   bool check_arg_kwrest   = (iseq_callee->param.flags.has_kwrest != 0);
-
-   if ( check_arg_opts      ||
-       check_arg_rest      ||
-       check_arg_post_len  ||
-       check_arg_block     ||
-       check_arg_keywords ||
-       check_arg_kwrest
-       )
+   VALUE classes[TR_Ruby_SendSimple_CallSite::MaxProfiledClasses];
+   int32_t numClasses = TR_Ruby_SendSimple_CallSite::getProfiledClasses(ci, classes);
+   if (numClasses == 0)
      {
-     if (check_arg_kwrest)
-        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_kwrest"));
-     if (check_arg_opts)
-        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_opts"));
-     if (check_arg_rest)
-        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_rest"));
-     if (check_arg_post_len)
-        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_post_len"));
-     if (check_arg_block)
-        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_block"));
-     if (check_arg_keywords)
-        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/has_opt_args/arg_keywords"));
-
-     return Ruby_has_opt_args;
+     TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/ambiguious_profiled_klass/unprofiled"));
+     return Ruby_ambiguious_profiled_klass;
      }
 
-   if(iseq_callee->catch_table != 0)
+   //The site is worth looking at if any of its receiver classes is inlineable;
+   //findCallSiteTarget picks which ones. Otherwise report the reason for the
+   //profiled class.
+   int firstReason = InlineableTarget;
+   for (int32_t i = 0; i < numClasses; i++)
      {
-     TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/notInlineable/non_zero_catchtable"));
-     return Ruby_non_zero_catchtable;
+     int reason = TR_Ruby_SendSimple_CallSite::checkInlineableClass(comp, ci, classes[i]);
+     if (reason == InlineableTarget)
+        {
+        TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/inlineable"));
+        if (numClasses > 1)
+           TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/inlineable/polymorphic"));
+        return InlineableTarget;
+        }
+     if (i == 0)
+        firstReason = reason;
      }
 
-   //Ok everything looks good.
-   TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.callSites/send_without_block/inlineable"));
-   return InlineableTarget;
+   return firstReason;
    }
 
 Ruby::InlinerUtil::InlinerUtil(TR::Compilation *comp)
@@ -246,7 +193,7 @@ Ruby::InlinerUtil::calleeTreeTopPreMergeActions(TR::ResolvedMethodSymbol *callee
    TR::Node* send_without_block_call_Node = callSite->_callNode;
 
   //Ensure that ILGen hasn't changed the children's layout we expect.
-  TR_ASSERT(  ((send_without_block_call_Node->getNumChildren() == 3) &&
+  TR_ASSERT(  ((send_without_block_call_Node->getNumChildren() >= 2) &&
        send_without_block_call_Node->getSecondChild() &&
        send_without_block_call_Node->getSecondChild()->getOpCodeValue() == TR::aconst), "Unexpected children in hierarchy of vm_send_without_block.");
 
@@ -254,21 +201,86 @@ Ruby::InlinerUtil::calleeTreeTopPreMergeActions(TR::ResolvedMethodSymbol *callee
 
    TR::TreeTop * startOfInlinedCall = calleeResolvedMethodSymbol->getFirstTreeTop()->getNextTreeTop();
 
+   const rb_iseq_t *iseq = static_cast<ResolvedRubyMethodBase *>(calleeResolvedMethodSymbol->getResolvedMethod())->getRubyMethodBlock().iseq();
+   TR_RubyInliningPolicy::chargeInlinedCallee(comp(), iseq);
+
+   //A callee inlined without a frame runs off the temps its IL was
+   //generated against; LowerMacroOps materializes its frame where needed.
+   if (comp()->getSymRefTab()->getRubyVirtualFrame(calleeResolvedMethodSymbol->getResolvedMethod()))
+      {
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/inlined_frameless"));
+      return;
+      }
+
    //Need Ruby Thread:
    TR::ParameterSymbol *parmSymbol = comp()->getMethodSymbol()->getParameterList().getListHead()->getData();
    TR::SymbolReference *threadSymRef = comp()->getSymRefTab()->findOrCreateAutoSymbol(comp()->getMethodSymbol(), parmSymbol->getSlot(), parmSymbol->getDataType(), true, false, true, false);
 
    TR::ILOpCodes callOpCode = TR_RubyFE::SLOTSIZE == 8 ? TR::lcall : TR::icall;
 
-   TR::SymbolReference* receiverTempSymRef = comp()->getSymRefTab()->getRubyInlinedReceiverTempSymRef(callSite);
-   TR_ASSERT(receiverTempSymRef != NULL, "NULL receiverTempSymRef, findCallSiteTarget didn't store receiver to a temporary.");
-
-   TR::TreeTop* vm_frame_setup_call_TT = genCall(comp(), RubyHelper_vm_send_woblock_jit_inline_frame, callOpCode, 3,
-                                                   TR::Node::createLoad(threadSymRef),
-                                                   TR::Node::aconst((uintptr_t)ci),
-                                                   TR::Node::createLoad(receiverTempSymRef)
-                                                   );
+   TR::TreeTop* vm_frame_setup_call_TT;
+   if (send_without_block_call_Node->getSymbolReference() == comp()->getSymRefTab()->getSymRef(RubyHelper_vm_invokeblock))
+      {
+      //The block frame takes its self and outer EP from the block in the
+      //yielding method's frame; the arguments are already on the stack.
+      vm_frame_setup_call_TT = genCall(comp(), RubyHelper_vm_invokeblock_jit_inline_frame, callOpCode, 2,
+                                       TR::Node::createLoad(threadSymRef),
+                                       TR::Node::aconst((uintptr_t)ci)
+                                       );
+      }
+   else if (send_without_block_call_Node->getSymbolReference() == comp()->getSymRefTab()->getSymRef(RubyHelper_vm_yield_literal_block))
+      {
+      //As above, with the block taken from the send's call info and the
+      //yielded value passed in. The block is inlined without a guard, so the
+      //yield is still in place: store the value ahead of it, now that the
+      //target is accepted.
+      TR::SymbolReference* argumentTempSymRef = TR::Node::storeToTemp(send_without_block_call_Node->getThirdChild(), callSite->_callNodeTreeTop);
+      TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/yield_literal_block/inlined"));
+
+      vm_frame_setup_call_TT = genCall(comp(), RubyHelper_vm_yield_literal_block_jit_inline_frame, callOpCode, 3,
+                                       TR::Node::createLoad(threadSymRef),
+                                       TR::Node::aconst((uintptr_t)ci),
+                                       TR::Node::createLoad(argumentTempSymRef)
+                                       );
+      }
+   else
+      {
+      TR::SymbolReference* receiverTempSymRef = comp()->getSymRefTab()->getRubyInlinedReceiverTempSymRef(callSite);
+      TR_ASSERT(receiverTempSymRef != NULL, "NULL receiverTempSymRef, findCallSiteTarget didn't store receiver to a temporary.");
+
+      //vm_send_jit_inline_frame also hands the caller's literal block to the callee frame.
+      TR_RuntimeHelper frameHelper =
+         send_without_block_call_Node->getSymbolReference() == comp()->getSymRefTab()->getSymRef(RubyHelper_vm_send) ?
+         RubyHelper_vm_send_jit_inline_frame : RubyHelper_vm_send_woblock_jit_inline_frame;
+
+      vm_frame_setup_call_TT = genCall(comp(), frameHelper, callOpCode, 3,
+                                       TR::Node::createLoad(threadSymRef),
+                                       TR::Node::aconst((uintptr_t)ci),
+                                       TR::Node::createLoad(receiverTempSymRef)
+                                       );
+      }
    startOfInlinedCall->insertBefore(vm_frame_setup_call_TT);
+
+   //A callee with optional parameters starts at the entry for the number of
+   //arguments passed, which is known here: fold the selector of its entry
+   //switch, the only lookup ILGen generates.
+   if (iseq->param.flags.has_opt &&
+       send_without_block_call_Node->getSymbolReference() != comp()->getSymRefTab()->getSymRef(RubyHelper_vm_invokeblock) &&
+       send_without_block_call_Node->getSymbolReference() != comp()->getSymRefTab()->getSymRef(RubyHelper_vm_yield_literal_block))
+      {
+      VALUE opt_pc = iseq->param.opt_table[ci->orig_argc - iseq->param.lead_num];
+      for (TR::TreeTop *tt = calleeResolvedMethodSymbol->getFirstTreeTop(); tt; tt = tt->getNextTreeTop())
+         {
+         TR::Node *switchNode = tt->getNode();
+         if (switchNode->getOpCodeValue() != TR::lookup)
+            continue;
+
+         switchNode->getFirstChild()->recursivelyDecReferenceCount();
+         switchNode->setAndIncChild(0, TR::Node::create(TR::l2a, 1, TR::Node::lconst(TR_RubyFE::SLOTSIZE * opt_pc)));
+         TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.callSites/send_without_block/inlined_opt_entry"));
+         break;
+         }
+      }
   }
 
 
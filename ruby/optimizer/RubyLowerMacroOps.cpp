@@ -18,6 +18,7 @@
 
 
 #include "optimizer/RubyLowerMacroOps.hpp"
+#include "optimizer/RubyDeadStackStoreElimination.hpp"
 
 #include "il/Node.hpp"
 #include "il/Node_inlines.hpp"
@@ -25,6 +26,20 @@
 #include "il/TreeTop.hpp"
 #include "il/TreeTop_inlines.hpp"
 #include "optimizer/Optimization_inlines.hpp"
+#include "compile/SymbolReferenceTable.hpp"
+#include "ras/DebugCounter.hpp"
+#include "ruby/env/RubyFE.hpp"
+
+#ifdef RUBY_PROJECT_SPECIFIC
+#include "ruby/config.h" 
+#endif
+
+extern "C" {
+#include "iseq.h"                              // for rb_iseq_original_iseq
+}
+/* Ruby */
+#include "insns.inc"
+#include "insns_info.inc"
 
 #define OPT_DETAILS "O^O RUBYLOWERMACROOPS: "
 
@@ -46,6 +61,14 @@ Ruby::LowerMacroOps::perform()
    if (trace())
       traceMsg(comp(), OPT_DETAILS "Processing method: %s\n", comp()->signature());
 
+   // Drop the stores to the YARV stack nobody reads before the helper calls
+   // lowered below are added; they read none of it.
+   if (comp()->getMethodHotness() > noOpt)
+      {
+      Ruby::DeadStackStoreElimination deadStackStores(manager());
+      deadStackStores.perform();
+      }
+
    auto lastTT = cfg()->findLastTreeTop();
    for (auto tt = comp()->getMethodSymbol()->getFirstTreeTop();
         tt != lastTT;
@@ -69,11 +92,21 @@ Ruby::LowerMacroOps::lowerTreeTop(TR::TreeTop* tt)
    if (node->getOpCodeValue() == TR::treetop) 
       node = node->getFirstChild(); 
    
+   if (node->getOpCode().isStore() && node->getNumChildren() == 1)
+      node = node->getFirstChild(); 
+
    switch (node->getOpCodeValue()) 
       {
       case TR::asynccheck: 
          lowerAsyncCheck(node, tt); 
+         break; 
       default: 
+         if (node->getOpCode().isCall())
+            {
+            materializeVirtualFrame(node, tt); 
+            writeBackPromotedLocals(node, tt);
+            refreshFrameEPs(node, tt);
+            }
          break; 
       }
             
@@ -144,6 +177,7 @@ Ruby::LowerMacroOps::lowerAsyncCheck(TR::Node *asynccheckNode, TR::TreeTop *asyn
    auto threadLoadNode              = TR::Node::loadThread(comp->getMethodSymbol());
    auto callNode                    = TR::Node::create(TR::call, 2, threadLoadNode, TR::Node::iconst(0));
    callNode->setSymbolReference(callSymRef);
+   callNode->setByteCodeInfo(asynccheckNode->getByteCodeInfo());
    auto callTree                    = TR::TreeTop::create(comp, TR::Node::create(TR::treetop, 1, callNode));
 
    TR::Node       *valueNode   =   pendingInterruptsNode();
@@ -170,7 +204,235 @@ Ruby::LowerMacroOps::lowerAsyncCheck(TR::Node *asynccheckNode, TR::TreeTop *asyn
    cfg->addEdge(callBlock, remainderBlock);
 
    ifNode->setBranchDestination(callBlock->getEntry());
+
+   materializeVirtualFrame(callNode, callTree);
+   writeBackPromotedLocals(callNode, callTree);
+   refreshFrameEPs(callNode, callTree);
    
    return;
    }
 
+
+/**
+ * Helpers that neither look at the current control frame nor call back into
+ * Ruby code, and so run fine while a frame is virtual.
+ */
+static bool
+isFrameTransparent(TR::Compilation *comp, TR::SymbolReference *symRef)
+   {
+   static const TR_RuntimeHelper transparentHelpers[] =
+      {
+      RubyHelper_vm_jit_materialize_frame,
+      RubyHelper_vm_jit_dematerialize_frame,
+      RubyHelper_rb_str_resurrect,
+      RubyHelper_rb_ary_resurrect,
+      RubyHelper_rb_ary_new_from_values,
+      RubyHelper_rb_gc_writebarrier,
+      RubyHelper_rb_obj_alloc,
+      };
+
+   for (size_t i = 0; i < sizeof(transparentHelpers) / sizeof(transparentHelpers[0]); i++)
+      {
+      if (symRef == comp->getSymRefTab()->getSymRef(transparentHelpers[i]))
+         return true;
+      }
+   return false;
+   }
+
+/**
+ * Materialize the control frame of a callee inlined without one around a
+ * call of its body, if the call may observe it.
+ *
+ * The frame is pushed from its TR_RubyVirtualFrame description, with the
+ * locals passed in a stack array and the pc of the instruction following the
+ * call's, as the interpreter would have left it. Popping it afterwards copies
+ * the locals back, and they are reloaded into their temps. An exception
+ * raised by the call unwinds the materialized frame like any other.
+ *
+ * GC does not need the frame: the temps are scanned with the rest of the
+ * JIT frame, and the callee's YARV stack lies below the caller's sp.
+ *
+ * ILGen aliased the temps with the helpers with frame effects, so they are
+ * still right around the call when this runs after the other optimizations.
+ * A frame the call could observe is required, and is not subject to
+ * performTransformation.
+ */
+void
+Ruby::LowerMacroOps::materializeVirtualFrame(TR::Node *callNode, TR::TreeTop *callTree)
+   {
+   int32_t siteIndex = callNode->getInlinedSiteIndex();
+   if (siteIndex < 0)
+      return;
+
+   TR_RubyVirtualFrame *frame = comp()->getSymRefTab()->getRubyVirtualFrame(comp()->getInlinedResolvedMethod(siteIndex));
+   if (!frame || isFrameTransparent(comp(), callNode->getSymbolReference()))
+      return;
+
+   //The only rb_funcallv of a frameless body sends initialize on the slow
+   //path of an inlined Class#new, in place of the frame being inlined.
+   if (frame->_classTemp && callNode->getSymbolReference() == comp()->getSymRefTab()->getSymRef(RubyHelper_rb_funcallv))
+      return;
+
+   TR::Compilation *comp = TR::comp();
+
+   TR::Node *locals = TR::Node::aconst(0);
+   TR::SymbolReference *localArray = NULL;
+   if (frame->_numLocals > 0)
+      {
+      localArray = comp->getSymRefTab()->createLocalPrimArray(TR_RubyFE::SLOTSIZE * frame->_numLocals, comp->getMethodSymbol(), 8 /*FIXME: JVM-specific - byte*/);
+      localArray->setStackAllocatedArrayAccess();
+      locals = TR::Node::createWithSymRef(TR::loadaddr, 0, localArray);
+
+      for (int32_t i = 0; i < frame->_numLocals; i++)
+         {
+         TR::SymbolReference *shadow = comp->getSymRefTab()->findOrCreateGenericIntShadowSymbolReference(i * TR_RubyFE::SLOTSIZE, true /*allocUseDefBitVector*/);
+         TR::Node *store = TR::Node::createWithSymRef(TR::astorei, 2, 2, locals, TR::Node::createLoad(frame->_localTemps[i]), shadow);
+         callTree->insertBefore(TR::TreeTop::create(comp, store));
+         }
+      }
+
+   int32_t bcIndex = callNode->getByteCodeIndex();
+   const VALUE *insns = rb_iseq_original_iseq(frame->_iseq);
+   VALUE *pc = &frame->_iseq->iseq_encoded[bcIndex + insn_len(insns[bcIndex])];
+
+   TR::Node *materialize = TR::Node::create(TR::call, 6,
+                                            TR::Node::loadThread(comp->getMethodSymbol()),
+                                            TR::Node::aconst((uintptr_t)frame->_me),
+                                            TR::Node::xconst(frame->_definedClass),
+                                            TR::Node::createLoad(frame->_receiverTemp),
+                                            TR::Node::aconst((uintptr_t)pc),
+                                            locals);
+   materialize->setSymbolReference(comp->getSymRefTab()->findOrCreateRubyHelperSymbolRef(RubyHelper_vm_jit_materialize_frame, true, true, false));
+   materialize->setByteCodeInfo(callNode->getByteCodeInfo());
+   callTree->insertBefore(TR::TreeTop::create(comp, TR::Node::create(TR::treetop, 1, materialize)));
+
+   TR::Node *dematerialize = TR::Node::create(TR::call, 2,
+                                              TR::Node::loadThread(comp->getMethodSymbol()),
+                                              localArray ? TR::Node::createWithSymRef(TR::loadaddr, 0, localArray) : TR::Node::aconst(0));
+   dematerialize->setSymbolReference(comp->getSymRefTab()->findOrCreateRubyHelperSymbolRef(RubyHelper_vm_jit_dematerialize_frame, true, true, false));
+   dematerialize->setByteCodeInfo(callNode->getByteCodeInfo());
+   TR::TreeTop *lastTree = callTree->insertAfter(TR::TreeTop::create(comp, TR::Node::create(TR::treetop, 1, dematerialize)));
+
+   for (int32_t i = 0; i < frame->_numLocals; i++)
+      {
+      TR::SymbolReference *shadow = comp->getSymRefTab()->findOrCreateGenericIntShadowSymbolReference(i * TR_RubyFE::SLOTSIZE, true /*allocUseDefBitVector*/);
+      TR::Node *reload = TR::Node::xloadi(shadow, TR::Node::createWithSymRef(TR::loadaddr, 0, localArray), fe());
+      lastTree = lastTree->insertAfter(TR::TreeTop::create(comp, TR::Node::createStore(frame->_localTemps[i], reload)));
+      }
+
+   TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.lowerMacroOps/materializedFrames"));
+   }
+
+/**
+ * Write the locals ILGen promoted to temporaries back to the environment
+ * before the calls that may read it, and reload them afterwards.
+ *
+ * In a method passing no block, these are:
+ *
+ *   - vm_exec_core, which resumes the method in the interpreter;
+ *   - vm_trace, whose hooks can take the binding of the frame, and set
+ *     locals through it.
+ *
+ * No other call can see the locals; see RubyIlGenerator::canPromoteLocals.
+ *
+ * A method passing literal blocks has them run out of line by any call that
+ * was not inlined, or turned into procs that later calls run. Its locals
+ * are written back around every call that may run Ruby code, at any inlining
+ * depth, and the EP is reloaded after each, as turning a block into a proc
+ * moves the environment to the heap.
+ *
+ * Since this runs after the fastpather, these stores only happen on the
+ * paths that actually make such a call. The earlier optimizations keep the
+ * temporaries right across these calls as ILGen aliased them with the
+ * calls; see RubyIlGenerator::createPromotedLocalTemp. The trees are needed
+ * for correctness, and are not subject to performTransformation.
+ */
+void
+Ruby::LowerMacroOps::writeBackPromotedLocals(TR::Node *callNode, TR::TreeTop *callTree)
+   {
+   TR_RubyPromotedLocals *locals = comp()->getSymRefTab()->getRubyPromotedLocals();
+   if (!locals)
+      return;
+
+   TR::SymbolReference *symRef = callNode->getSymbolReference();
+   if (locals->_cfpTemp)
+      {
+      if (isFrameTransparent(comp(), symRef))
+         return;
+      }
+   else if (callNode->getInlinedSiteIndex() >= 0 ||
+            (symRef != comp()->getSymRefTab()->getSymRef(RubyHelper_vm_exec_core) &&
+             symRef != comp()->getSymRefTab()->getSymRef(RubyHelper_vm_trace)))
+      {
+      return;
+      }
+
+   TR::Compilation *comp = TR::comp();
+
+   for (int32_t i = 0; i < locals->_numLocals; i++)
+      {
+      TR::Node *store = TR::Node::xstorei(locals->_localShadows[i],
+                                          TR::Node::createLoad(locals->_epTemp),
+                                          TR::Node::createLoad(locals->_localTemps[i]),
+                                          fe());
+      callTree->insertBefore(TR::TreeTop::create(comp, store));
+      }
+
+   TR::TreeTop *lastTree = callTree;
+   if (locals->_cfpTemp)
+      {
+      TR::Node *ep = TR::Node::createWithSymRef(TR::aloadi, 1, 1, TR::Node::createLoad(locals->_cfpTemp), locals->_epShadow);
+      lastTree = lastTree->insertAfter(TR::TreeTop::create(comp, TR::Node::createStore(locals->_epTemp, ep)));
+      }
+
+   for (int32_t i = 0; i < locals->_numLocals; i++)
+      {
+      TR::Node *reload = TR::Node::xloadi(locals->_localShadows[i], TR::Node::createLoad(locals->_epTemp), fe());
+      lastTree = lastTree->insertAfter(TR::TreeTop::create(comp, TR::Node::createStore(locals->_localTemps[i], reload)));
+      }
+
+   TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.lowerMacroOps/promotedLocalsWriteBack"));
+   }
+
+/**
+ * Reload the EP of the method or block being compiled, and walk its EP chain
+ * again, after a call that may run Ruby code, at any inlining depth. Making a
+ * proc or binding moves the environment of the frame and those enclosing it
+ * to the heap, and the EPs ILGen loaded on entry are stale from then on.
+ * Other calls keep the temporaries, so locals are accessed without going
+ * through th->cfp. The CFP and self never change while the frame is live.
+ *
+ * ILGen aliased the EP temporaries with the calls refreshed here, so nothing
+ * before this pass reuses an EP across them; the refresh itself is needed
+ * for correctness, and is not subject to performTransformation.
+ */
+void
+Ruby::LowerMacroOps::refreshFrameEPs(TR::Node *callNode, TR::TreeTop *callTree)
+   {
+   TR_RubyFrameRegisters *registers = comp()->getSymRefTab()->getRubyFrameRegisters();
+   if (!registers || isFrameTransparent(comp(), callNode->getSymbolReference()))
+      return;
+
+   TR::Compilation *comp = TR::comp();
+   TR::SymbolReference *prevEPShadow = comp->getSymRefTab()->findOrCreateRubyPrevEPSymRef();
+
+   TR::TreeTop *lastTree = callTree;
+   TR::Node *cfp = registers->_cfpTemp ?
+      TR::Node::createLoad(registers->_cfpTemp) :
+      TR::Node::createWithSymRef(TR::aloadi, 1, 1, TR::Node::loadThread(comp->getMethodSymbol()), registers->_cfpShadow);
+   TR::Node *ep = TR::Node::createWithSymRef(TR::aloadi, 1, 1, cfp, registers->_epShadow);
+   if (registers->_epTemps[0])
+      {
+      lastTree = lastTree->insertAfter(TR::TreeTop::create(comp, TR::Node::createStore(registers->_epTemps[0], ep)));
+      ep = TR::Node::createLoad(registers->_epTemps[0]);
+      }
+
+   for (int32_t level = 1; level <= registers->_maxLevel; level++)
+      {
+      TR::Node *prevEP = TR::Node::xand(TR::Node::xloadi(prevEPShadow, ep, fe()), TR::Node::xconst(~3));
+      lastTree = lastTree->insertAfter(TR::TreeTop::create(comp, TR::Node::createStore(registers->_epTemps[level], prevEP)));
+      ep = TR::Node::createLoad(registers->_epTemps[level]);
+      }
+
+   TR::DebugCounter::incStaticDebugCounter(comp, TR::DebugCounter::debugCounterName(comp, "ruby.lowerMacroOps/frameEPsRefresh"));
+   }
@@ -28,6 +28,11 @@ namespace Ruby
 
 /**
  * Lower Ruby macro ops. 
+ *
+ * Also removes dead stores to the YARV stack, materializes the control frames
+ * of callees inlined without one around the helper calls of their bodies,
+ * writes locals kept in temporaries back to the environment where the VM
+ * reads it, and recomputes the cached EPs after calls.
  */
 class LowerMacroOps : public TR::Optimization
    {
@@ -61,6 +66,9 @@ class LowerMacroOps : public TR::Optimization
 
    void         lowerTreeTop(TR::TreeTop *); 
    void         lowerAsyncCheck(TR::Node *, TR::TreeTop *);
+   void         materializeVirtualFrame(TR::Node *, TR::TreeTop *);
+   void         writeBackPromotedLocals(TR::Node *, TR::TreeTop *);
+   void         refreshFrameEPs(TR::Node *, TR::TreeTop *);
    TR::Node*    pendingInterruptsNode(); 
 
    };
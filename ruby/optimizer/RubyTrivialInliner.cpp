@@ -18,6 +18,7 @@
 
 
 #include "ruby/optimizer/RubyTrivialInliner.hpp"
+#include "ruby/optimizer/RubyCallInfo.hpp"
 
 Ruby::TrivialInliner::TrivialInliner(TR::OptimizationManager *manager)
    : TR::Optimization(manager)
@@ -32,13 +33,15 @@ int32_t Ruby::TrivialInliner::perform()
    uint32_t initialSize = comp()->getOptions()->getTrivialInlinerMaxSize();
 
    //Check if we're overriding the defaultInitialSize via an option.
-   //If not increase initialSize as defaultInitialSize is too small.
+   //If not, use the policy's node bound; TR_RubyInliningPolicy also bounds
+   //callee sizes in iseq slots at every site.
    if(initialSize == defaultInitialSize)
       {
-      //TODO: Get statistics on a good threshold for inlining Ruby methods.
-      initialSize = 400;
+      initialSize = TR_RubyInliningPolicy::maxCalleeNodes();
       }
 
+   comp()->setInliningBudget(TR_RubyInliningPolicy::initialBudget());
+
    comp()->generateAccurateNodeCount();
 
    TR::ResolvedMethodSymbol * sym = comp()->getMethodSymbol();
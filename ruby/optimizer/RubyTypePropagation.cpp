@@ -0,0 +1,702 @@
+/*******************************************************************************
+ *
+ * (c) Copyright IBM Corp. 2000, 2016
+ *
+ *  This program and the accompanying materials are made available
+ *  under the terms of the Eclipse Public License v1.0 and
+ *  Apache License v2.0 which accompanies this distribution.
+ *
+ *      The Eclipse Public License is available at
+ *      http://www.eclipse.org/legal/epl-v10.html
+ *
+ *      The Apache License v2.0 is available at
+ *      http://www.opensource.org/licenses/apache2.0.php
+ *
+ * Contributors:
+ *    Multiple authors (IBM Corp.) - initial implementation and documentation
+ *******************************************************************************/
+
+
+#include "optimizer/RubyTypePropagation.hpp"
+
+#include <string.h>
+#include "il/Node.hpp"
+#include "il/Node_inlines.hpp"
+#include "il/Block.hpp"
+#include "il/TreeTop.hpp"
+#include "il/TreeTop_inlines.hpp"
+#include "infra/Cfg.hpp"
+#include "infra/CfgNode.hpp"
+#include "optimizer/Optimization_inlines.hpp"
+#include "compile/SymbolReferenceTable.hpp"
+#include "ras/DebugCounter.hpp"
+#include "ruby/env/RubyFE.hpp"
+
+#include "vm_core.h" // For BOP_LAST_
+
+#define OPT_DETAILS "O^O RUBYTYPEPROPAGATION: "
+
+// Bound on the size of the per block states, beyond which only constants
+// and the BOP flags are tracked.
+#define MAX_STATE_ENTRIES (4 * 1024 * 1024)
+
+enum CompareOutcome
+   {
+   AlwaysEqual,
+   NeverEqual,
+   MaybeEqual,
+   };
+
+Ruby::TypePropagation::TypePropagation(TR::OptimizationManager *manager)
+   : TR::Optimization(manager),
+     _numTemps(0),
+     _tempIndex(NULL),
+     _tempValues(NULL),
+     _inStates(NULL),
+     _changed(false),
+     _visitCount(0),
+     _foldedBranches(NULL),
+     _foldTaken(NULL),
+     _numFolds(0)
+   {}
+
+
+int32_t
+Ruby::TypePropagation::perform()
+   {
+   static const char *disableTypePropagation = feGetEnv("OMR_RUBY_DISABLE_TYPE_PROPAGATION");
+   if (disableTypePropagation)
+      return 0;
+
+   int32_t numSymRefs = comp()->getSymRefTab()->getNumSymRefs();
+   _tempIndex = (int32_t *) trMemory()->allocateHeapMemory(numSymRefs * sizeof(int32_t));
+   for (int32_t i = 0; i < numSymRefs; i++)
+      _tempIndex[i] = -1;
+
+   vcount_t visitCount = comp()->incVisitCount();
+   for (TR::TreeTop *tt = comp()->getStartTree(); tt; tt = tt->getNextTreeTop())
+      collectTemps(tt->getNode(), visitCount);
+
+   int32_t numBlocks = cfg()->getNextNodeNumber();
+   for (int32_t i = 0; i < numSymRefs; i++)
+      {
+      if (_tempIndex[i] == -2)
+         _tempIndex[i] = -1;
+      else if (_tempIndex[i] >= 0)
+         _tempIndex[i] = _numTemps++;
+      }
+
+   if ((int64_t)numBlocks * _numTemps > MAX_STATE_ENTRIES)
+      {
+      if (trace())
+         traceMsg(comp(), OPT_DETAILS "Not tracking %d temps over %d blocks\n", _numTemps, numBlocks);
+      for (int32_t i = 0; i < numSymRefs; i++)
+         _tempIndex[i] = -1;
+      _numTemps = 0;
+      }
+
+   if (trace())
+      traceMsg(comp(), OPT_DETAILS "Propagating the types of %d temps in %s\n", _numTemps, comp()->signature());
+
+   size_t typesSize = (_numTemps > 0 ? _numTemps : 1) * sizeof(uint16_t);
+   _tempValues = (TR::Node **) trMemory()->allocateHeapMemory((_numTemps > 0 ? _numTemps : 1) * sizeof(TR::Node *));
+   _inStates   = (State *) trMemory()->allocateHeapMemory(numBlocks * sizeof(State));
+   for (int32_t i = 0; i < numBlocks; i++)
+      {
+      _inStates[i].types   = (uint16_t *) trMemory()->allocateHeapMemory(typesSize);
+      _inStates[i].reached = false;
+      }
+   _current.types = (uint16_t *) trMemory()->allocateHeapMemory(typesSize);
+   _taken.types   = (uint16_t *) trMemory()->allocateHeapMemory(typesSize);
+
+   // Nothing is known on entry.
+   State entry;
+   entry.types = (uint16_t *) trMemory()->allocateHeapMemory(typesSize);
+   for (int32_t i = 0; i < _numTemps; i++)
+      entry.types[i] = TypeAny;
+   entry.unredefinedBOPs = 0;
+   entry.reached         = true;
+   TR_SuccessorIterator entries(cfg()->getStart());
+   for (TR::CFGEdge *edge = entries.getFirst(); edge; edge = entries.getNext())
+      mergeInto(toBlock(edge->getTo()), entry);
+
+   // Types only grow at merges, so this terminates.
+   do
+      {
+      _changed = false;
+      for (TR::TreeTop *tt = comp()->getStartTree(); tt; tt = tt->getNode()->getBlock()->getExit()->getNextTreeTop())
+         {
+         TR::Block *block = tt->getNode()->getBlock();
+         if (!continuesExtendedBlock(block->getPrevBlock(), block) && _inStates[block->getNumber()].reached)
+            walkExtendedBlock(block, false);
+         }
+      }
+   while (_changed);
+
+   _foldedBranches = (TR::TreeTop **) trMemory()->allocateHeapMemory(numBlocks * sizeof(TR::TreeTop *));
+   _foldTaken      = (bool *) trMemory()->allocateHeapMemory(numBlocks * sizeof(bool));
+   for (TR::TreeTop *tt = comp()->getStartTree(); tt; tt = tt->getNode()->getBlock()->getExit()->getNextTreeTop())
+      {
+      TR::Block *block = tt->getNode()->getBlock();
+      if (!continuesExtendedBlock(block->getPrevBlock(), block) && _inStates[block->getNumber()].reached)
+         walkExtendedBlock(block, true);
+      }
+
+   // Folding a branch may remove the blocks of another.
+   for (int32_t i = 0; i < _numFolds; i++)
+      {
+      TR::Block *block = _foldedBranches[i]->getEnclosingBlock();
+      if (!block->nodeIsRemoved())
+         foldBranch(_foldedBranches[i], _foldTaken[i]);
+      }
+
+   return _numFolds;
+   }
+
+
+/**
+ * Find the temps holding VALUEs whose every definition is a direct store.
+ * Temps whose address is taken are marked -2.
+ */
+void
+Ruby::TypePropagation::collectTemps(TR::Node *node, vcount_t visitCount)
+   {
+   if (node->getVisitCount() == visitCount)
+      return;
+   node->setVisitCount(visitCount);
+
+   for (int32_t i = 0; i < node->getNumChildren(); i++)
+      collectTemps(node->getChild(i), visitCount);
+
+   if (!node->getOpCode().hasSymbolReference() ||
+       !node->getSymbolReference()->getSymbol()->isAuto())
+      return;
+
+   int32_t ref = node->getSymbolReference()->getReferenceNumber();
+   if (node->getOpCodeValue() == TR::loadaddr ||
+       node->getDataType() != TR_RubyFE::slotType())
+      _tempIndex[ref] = -2;
+   else if (_tempIndex[ref] == -1 &&
+            (node->getOpCode().isLoadVarDirect() || node->getOpCode().isStoreDirect()))
+      _tempIndex[ref] = 0;
+   }
+
+
+/**
+ * Whether `next` is an extension of `block`, entered only from it.
+ */
+bool
+Ruby::TypePropagation::continuesExtendedBlock(TR::Block *block, TR::Block *next)
+   {
+   if (!block || !next || !next->isExtensionOfPreviousBlock())
+      return false;
+
+   TR_PredecessorIterator preds(next);
+   TR::CFGEdge *edge = preds.getFirst();
+   return edge && edge->getFrom() == block && !preds.getNext();
+   }
+
+
+/**
+ * Propagate the state on entry to `head` through its extended block, into
+ * the blocks it branches to. When `fold` is set, also note the branches
+ * whose outcome is known.
+ */
+void
+Ruby::TypePropagation::walkExtendedBlock(TR::Block *head, bool fold)
+   {
+   copyState(_current, _inStates[head->getNumber()]);
+   for (int32_t i = 0; i < _numTemps; i++)
+      _tempValues[i] = NULL;
+   _visitCount = comp()->incOrResetVisitCount();
+
+   for (TR::Block *block = head; ; )
+      {
+      TR::Node *branch = NULL;
+      for (TR::TreeTop *tt = block->getEntry()->getNextTreeTop(); tt != block->getExit(); tt = tt->getNextTreeTop())
+         {
+         evaluate(tt->getNode(), _current);
+         if (tt->getNode()->getOpCode().isIf())
+            branch = tt->getNode();
+         }
+
+      TR::Block *next = block->getNextBlock();
+      TR::Block *dest = branch ? branch->getBranchDestination()->getNode()->getBlock() : NULL;
+
+      if (branch && dest != next)
+         {
+         copyState(_taken, _current);
+         const char *kind = NULL;
+         BranchOutcome outcome = refineOnBranch(branch, _taken, _current, kind);
+         if (fold &&
+             outcome != BranchUnknown &&
+             performTransformation(comp(), "%s Folding %s test [%p], which is %s taken\n", OPT_DETAILS, kind, branch,
+                                   outcome == BranchAlwaysTaken ? "always" : "never"))
+            {
+            TR::DebugCounter::incStaticDebugCounter(comp(), TR::DebugCounter::debugCounterName(comp(), "ruby.typePropagation/folded/%s", kind));
+            _foldedBranches[_numFolds] = block->getLastRealTreeTop();
+            _foldTaken[_numFolds]      = outcome == BranchAlwaysTaken;
+            _numFolds++;
+            }
+         }
+
+      bool extends = continuesExtendedBlock(block, next);
+      TR_SuccessorIterator succs(block);
+      for (TR::CFGEdge *edge = succs.getFirst(); edge; edge = succs.getNext())
+         {
+         TR::Block *succ = toBlock(edge->getTo());
+         if (branch && succ == dest && dest != next)
+            mergeInto(succ, _taken);
+         else if (!(succ == next && extends))
+            mergeInto(succ, _current);
+         }
+
+      if (!extends || !_current.reached)
+         break;
+      block = next;
+      }
+   }
+
+
+/**
+ * Type the nodes of a tree, and apply its stores and calls to `state`.
+ * The type of each node is kept in its local index.
+ */
+void
+Ruby::TypePropagation::evaluate(TR::Node *node, State &state)
+   {
+   if (node->getVisitCount() == _visitCount)
+      return;
+   node->setVisitCount(_visitCount);
+
+   for (int32_t i = 0; i < node->getNumChildren(); i++)
+      evaluate(node->getChild(i), state);
+
+   uint16_t type = TypeAny;
+   TR::ILOpCode &op = node->getOpCode();
+   if (op.isStoreDirect() && _tempIndex[node->getSymbolReference()->getReferenceNumber()] >= 0)
+      {
+      int32_t temp = _tempIndex[node->getSymbolReference()->getReferenceNumber()];
+      state.types[temp] = node->getFirstChild()->getLocalIndex();
+      _tempValues[temp] = node->getFirstChild();
+      }
+   else if (op.isCall())
+      {
+      TR::SymbolReferenceTable *symRefTab = comp()->getSymRefTab();
+      TR::SymbolReference *symRef = node->getSymbolReference();
+      if (!symRefTab->isRubyHelperSymRef(symRef) ||
+          (TR::SymbolReferenceTable::getRubyHelperEffects((TR_RuntimeHelper)symRef->getReferenceNumber()) &
+           TR::SymbolReferenceTable::HelperEffectsGlobal))
+         state.unredefinedBOPs = 0;
+      type = getHelperResultType(node);
+      }
+   else if (node->getOpCodeValue() == TR::asynccheck)
+      {
+      // Interrupts may run any Ruby code.
+      state.unredefinedBOPs = 0;
+      }
+   else if (node->getDataType() == TR_RubyFE::slotType())
+      {
+      type = computeType(node, state);
+      }
+
+   node->setLocalIndex(type);
+   }
+
+
+uint16_t
+Ruby::TypePropagation::computeType(TR::Node *node, State &state)
+   {
+   TR::ILOpCode &op = node->getOpCode();
+   if (op.isLoadConst())
+      return getConstantType((VALUE)node->get64bitIntegralValue());
+
+   if (op.isLoadVarDirect())
+      {
+      int32_t temp = _tempIndex[node->getSymbolReference()->getReferenceNumber()];
+      if (temp < 0)
+         return TypeAny;
+      _tempValues[temp] = node;
+      return state.types[temp];
+      }
+
+   if (node->getOpCodeValue() == TR::lternary || node->getOpCodeValue() == TR::iternary)
+      return node->getSecondChild()->getLocalIndex() | node->getThirdChild()->getLocalIndex();
+
+   // Any odd word is a fixnum.
+   if (getLowBit(node, 3) == 1)
+      return TypeFixnum;
+
+   return TypeAny;
+   }
+
+
+/**
+ * The tag bit of the word computed by `node`: 0, 1, or -1 if unknown.
+ * Only the fixnum arithmetic of the fast paths is looked through, up to
+ * `depth` levels deep.
+ */
+int32_t
+Ruby::TypePropagation::getLowBit(TR::Node *node, int32_t depth)
+   {
+   TR::ILOpCode &op = node->getOpCode();
+   if (op.isLoadConst())
+      return (int32_t)(node->get64bitIntegralValue() & 1);
+
+   uint16_t type = node->getLocalIndex();
+   if (node->getVisitCount() == _visitCount && type == TypeFixnum)
+      return 1;
+   if (node->getVisitCount() == _visitCount && !(type & (TypeFixnum | TypeOther)))
+      return 0;
+
+   if (depth == 0 || node->getNumChildren() != 2 ||
+       !(op.isAdd() || op.isSub() || op.isAnd() || op.isOr() || op.isXor()))
+      return -1;
+
+   int32_t a = getLowBit(node->getFirstChild(), depth - 1);
+   int32_t b = getLowBit(node->getSecondChild(), depth - 1);
+   if (op.isOr())
+      return (a == 1 || b == 1) ? 1 : (a == 0 && b == 0) ? 0 : -1;
+   if (op.isAnd())
+      return (a == 0 || b == 0) ? 0 : (a == 1 && b == 1) ? 1 : -1;
+   return (a < 0 || b < 0) ? -1 : a ^ b;
+   }
+
+
+/**
+ * The kind of value a constant word is.
+ */
+uint16_t
+Ruby::TypePropagation::getConstantType(VALUE value)
+   {
+   if (FIXNUM_P(value))       return TypeFixnum;
+   if (FLONUM_P(value))       return TypeFlonum;
+   if (STATIC_SYM_P(value))   return TypeStaticSymbol;
+   if (value == Qnil)         return TypeNil;
+   if (value == Qtrue)        return TypeTrue;
+   if (value == Qfalse)       return TypeFalse;
+   if (value == Qundef)       return TypeUndef;
+   if (!SPECIAL_CONST_P(value)) return TypeHeapObject;
+   return TypeOther;
+   }
+
+
+/**
+ * The helpers that only ever return a new or existing heap object, or a
+ * boolean.
+ */
+uint16_t
+Ruby::TypePropagation::getHelperResultType(TR::Node *node)
+   {
+   if (!comp()->getSymRefTab()->isRubyHelperSymRef(node->getSymbolReference()))
+      return TypeAny;
+
+   switch (node->getSymbolReference()->getReferenceNumber())
+      {
+      case RubyHelper_rb_ary_new_capa:
+      case RubyHelper_rb_ary_new_from_values:
+      case RubyHelper_rb_ary_resurrect:
+      case RubyHelper_rb_ary_tmp_new:
+      case RubyHelper_rb_ary_push:
+      case RubyHelper_rb_str_new:
+      case RubyHelper_rb_str_new_cstr:
+      case RubyHelper_rb_str_resurrect:
+      case RubyHelper_rb_str_append:
+      case RubyHelper_rb_obj_as_string:
+      case RubyHelper_rb_hash_new:
+      case RubyHelper_rb_range_new:
+      case RubyHelper_rb_reg_new_ary:
+      case RubyHelper_rb_obj_alloc:
+      case RubyHelper_rb_class_of:
+         return TypeHeapObject;
+
+      case RubyHelper_rb_hash_has_key:
+      case RubyHelper_rb_str_equal:
+         return TypeTrue | TypeFalse;
+
+      default:
+         return TypeAny;
+      }
+   }
+
+
+/**
+ * The basic operator whose redefinition flag `symRef` is, or -1.
+ */
+int32_t
+Ruby::TypePropagation::getBOP(TR::SymbolReference *symRef)
+   {
+   for (int32_t bop = BOP_PLUS; bop < BOP_LAST_ && bop < 32; bop++)
+      {
+      if (comp()->getSymRefTab()->findRubyRedefinedFlagSymbolRef(bop) == symRef)
+         return bop;
+      }
+   return -1;
+   }
+
+
+/**
+ * Whether `(value & mask) == 0` for a value of kind `kind`.
+ */
+static CompareOutcome
+testMask(uint16_t kind, VALUE mask)
+   {
+   VALUE knownMask, knownBits;
+   switch (kind)
+      {
+      case Ruby::TypePropagation::TypeFixnum:
+         knownMask = RUBY_FIXNUM_FLAG;
+         knownBits = RUBY_FIXNUM_FLAG;
+         break;
+#if USE_FLONUM
+      case Ruby::TypePropagation::TypeFlonum:
+         knownMask = RUBY_FLONUM_MASK;
+         knownBits = RUBY_FLONUM_FLAG;
+         break;
+#endif
+      case Ruby::TypePropagation::TypeStaticSymbol:
+         knownMask = ~(~(VALUE)0 << RUBY_SPECIAL_SHIFT);
+         knownBits = RUBY_SYMBOL_FLAG;
+         break;
+      case Ruby::TypePropagation::TypeNil:   return (Qnil   & mask) == 0 ? AlwaysEqual : NeverEqual;
+      case Ruby::TypePropagation::TypeTrue:  return (Qtrue  & mask) == 0 ? AlwaysEqual : NeverEqual;
+      case Ruby::TypePropagation::TypeFalse: return (Qfalse & mask) == 0 ? AlwaysEqual : NeverEqual;
+      case Ruby::TypePropagation::TypeUndef: return (Qundef & mask) == 0 ? AlwaysEqual : NeverEqual;
+      case Ruby::TypePropagation::TypeHeapObject:
+         // Objects are aligned, and never at the words of nil and false, so
+         // they have some bit set above those.
+         if ((mask | RUBY_IMMEDIATE_MASK | Qnil) == ~(VALUE)0)
+            return NeverEqual;
+         knownMask = RUBY_IMMEDIATE_MASK;
+         knownBits = 0;
+         break;
+      default:
+         return MaybeEqual;
+      }
+
+   if (mask & knownMask & knownBits)
+      return NeverEqual;
+   if ((mask & ~knownMask) == 0)
+      return AlwaysEqual;
+   return MaybeEqual;
+   }
+
+
+/**
+ * Whether `value == constant` for a value of kind `kind`.
+ */
+static CompareOutcome
+testEqual(uint16_t kind, VALUE constant)
+   {
+   switch (kind)
+      {
+      case Ruby::TypePropagation::TypeNil:   return constant == Qnil   ? AlwaysEqual : NeverEqual;
+      case Ruby::TypePropagation::TypeTrue:  return constant == Qtrue  ? AlwaysEqual : NeverEqual;
+      case Ruby::TypePropagation::TypeFalse: return constant == Qfalse ? AlwaysEqual : NeverEqual;
+      case Ruby::TypePropagation::TypeUndef: return constant == Qundef ? AlwaysEqual : NeverEqual;
+      case Ruby::TypePropagation::TypeOther: return MaybeEqual;
+      default:
+         // The kinds are disjoint sets of words.
+         return Ruby::TypePropagation::getConstantType(constant) == kind ? MaybeEqual : NeverEqual;
+      }
+   }
+
+
+/**
+ * Split the state after a conditional branch into the states on its taken
+ * and fall through edges, and say whether its outcome is known. Handles
+ * the tests of the fast paths and of branchif/branchunless:
+ *
+ *     ifxcmpeq/ifxcmpne (xand value, mask), 0
+ *     ifxcmpeq/ifxcmpne value, constant
+ *     ifscmpeq/ifscmpne redefined_flag[bop], 0
+ */
+Ruby::TypePropagation::BranchOutcome
+Ruby::TypePropagation::refineOnBranch(TR::Node *branch, State &taken, State &notTaken, const char *&kind)
+   {
+   TR::ILOpCode &op = branch->getOpCode();
+   if (!op.isCompareForEquality() || branch->getNumChildren() < 2)
+      return BranchUnknown;
+
+   TR::Node *lhs = branch->getFirstChild();
+   TR::Node *rhs = branch->getSecondChild();
+   if (!rhs->getOpCode().isLoadConst())
+      return BranchUnknown;
+
+   bool takenIfEqual = op.isCompareTrueIfEqual();
+
+   if (lhs->getOpCode().isLoadVarDirect() &&
+       lhs->getSymbolReference()->getSymbol()->isStatic() &&
+       rhs->get64bitIntegralValue() == 0)
+      {
+      int32_t bop = getBOP(lhs->getSymbolReference());
+      if (bop < 0)
+         return BranchUnknown;
+
+      kind = "bop";
+      bool unredefined = (notTaken.unredefinedBOPs & (1u << bop)) != 0;
+      (takenIfEqual ? taken : notTaken).unredefinedBOPs |= 1u << bop;
+      if (!unredefined)
+         return BranchUnknown;
+      if (takenIfEqual)
+         {
+         notTaken.reached = false;
+         return BranchAlwaysTaken;
+         }
+      taken.reached = false;
+      return BranchNeverTaken;
+      }
+
+   if (lhs->getDataType() != TR_RubyFE::slotType())
+      return BranchUnknown;
+
+   TR::Node *value = lhs;
+   VALUE mask = 0;
+   bool isMaskTest = lhs->getOpCode().isAnd() &&
+                     lhs->getSecondChild()->getOpCode().isLoadConst() &&
+                     rhs->get64bitIntegralValue() == 0;
+   if (isMaskTest)
+      {
+      value = lhs->getFirstChild();
+      mask  = (VALUE)lhs->getSecondChild()->get64bitIntegralValue();
+      kind  = mask == ~Qnil ? "rtest" : "tag";
+      }
+   else
+      {
+      kind  = "compare";
+      }
+
+   uint16_t type = value->getLocalIndex();
+   uint16_t takenType = 0, notTakenType = 0;
+   for (uint16_t k = TypeFixnum; k <= TypeOther; k <<= 1)
+      {
+      if (!(type & k))
+         continue;
+
+      CompareOutcome equal = isMaskTest ? testMask(k, mask) : testEqual(k, (VALUE)rhs->get64bitIntegralValue());
+      if (equal != NeverEqual)
+         (takenIfEqual ? takenType : notTakenType) |= k;
+      if (equal != AlwaysEqual)
+         (takenIfEqual ? notTakenType : takenType) |= k;
+      }
+
+   refineTemps(value, takenType, taken);
+   refineTemps(value, notTakenType, notTaken);
+   value->setLocalIndex(notTakenType);
+
+   if (type == 0)
+      return BranchUnknown;
+   if (takenType == 0)
+      {
+      taken.reached = false;
+      return BranchNeverTaken;
+      }
+   if (notTakenType == 0)
+      {
+      notTaken.reached = false;
+      return BranchAlwaysTaken;
+      }
+   return BranchUnknown;
+   }
+
+
+/**
+ * Narrow the types of the temps holding `value` down to `type`.
+ */
+void
+Ruby::TypePropagation::refineTemps(TR::Node *value, uint16_t type, State &state)
+   {
+   for (int32_t i = 0; i < _numTemps; i++)
+      {
+      if (_tempValues[i] == value)
+         state.types[i] &= type;
+      }
+   }
+
+
+void
+Ruby::TypePropagation::mergeInto(TR::Block *block, State &state)
+   {
+   if (!state.reached)
+      return;
+
+   State &in = _inStates[block->getNumber()];
+   if (!in.reached)
+      {
+      copyState(in, state);
+      _changed = true;
+      return;
+      }
+
+   for (int32_t i = 0; i < _numTemps; i++)
+      {
+      uint16_t merged = in.types[i] | state.types[i];
+      if (merged != in.types[i])
+         {
+         in.types[i] = merged;
+         _changed = true;
+         }
+      }
+
+   uint32_t merged = in.unredefinedBOPs & state.unredefinedBOPs;
+   if (merged != in.unredefinedBOPs)
+      {
+      in.unredefinedBOPs = merged;
+      _changed = true;
+      }
+   }
+
+
+void
+Ruby::TypePropagation::copyState(State &to, State &from)
+   {
+   memcpy(to.types, from.types, _numTemps * sizeof(uint16_t));
+   to.unredefinedBOPs = from.unredefinedBOPs;
+   to.reached         = from.reached;
+   }
+
+
+/**
+ * Turn a branch that is always taken into a goto, and remove one that is
+ * never taken. The blocks left unreachable are removed with their edges.
+ */
+void
+Ruby::TypePropagation::foldBranch(TR::TreeTop *tt, bool taken)
+   {
+   TR::Node  *branch = tt->getNode();
+   TR::Block *block  = tt->getEnclosingBlock();
+   TR::Block *dest   = branch->getBranchDestination()->getNode()->getBlock();
+   TR::Block *next   = block->getNextBlock();
+
+   anchorChildren(branch, tt);
+
+   if (taken)
+      {
+      branch = TR::Node::recreate(branch, TR::Goto);
+      branch->removeAllChildren();
+      cfg()->removeEdge(block, next);
+      }
+   else
+      {
+      tt->unlink(true);
+      cfg()->removeEdge(block, dest);
+      }
+   }
+
+
+/**
+ * Keep the subtrees of a removed test that are commoned elsewhere
+ * evaluated where they were.
+ */
+void
+Ruby::TypePropagation::anchorChildren(TR::Node *node, TR::TreeTop *tt)
+   {
+   for (int32_t i = 0; i < node->getNumChildren(); i++)
+      {
+      TR::Node *child = node->getChild(i);
+      if (child->getReferenceCount() > 1)
+         tt->insertBefore(TR::TreeTop::create(comp(), TR::Node::create(TR::treetop, 1, child)));
+      else
+         anchorChildren(child, tt);
+      }
+   }
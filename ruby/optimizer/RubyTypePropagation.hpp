@@ -0,0 +1,149 @@
+/*******************************************************************************
+ *
+ * (c) Copyright IBM Corp. 2000, 2016
+ *
+ *  This program and the accompanying materials are made available
+ *  under the terms of the Eclipse Public License v1.0 and
+ *  Apache License v2.0 which accompanies this distribution.
+ *
+ *      The Eclipse Public License is available at
+ *      http://www.eclipse.org/legal/epl-v10.html
+ *
+ *      The Apache License v2.0 is available at
+ *      http://www.opensource.org/licenses/apache2.0.php
+ *
+ * Contributors:
+ *    Multiple authors (IBM Corp.) - initial implementation and documentation
+ *******************************************************************************/
+
+
+#ifndef RUBYTYPEPROPAGATION_INCL
+#define RUBYTYPEPROPAGATION_INCL
+
+#include "optimizer/Optimization.hpp"
+
+#include "ruby.h" //VALUE
+
+
+namespace Ruby
+{
+
+/**
+ * Fold the tag tests, BOP redefinition checks and RTEST branches whose
+ * outcome is known from the kinds of value being tested.
+ *
+ * A type is the set of kinds a VALUE may be: fixnum, flonum, static symbol,
+ * nil, true, false, undef, heap object, or a word that need not be a VALUE
+ * at all. Types come from constants, from the fixnum arithmetic of the fast
+ * paths and from the helpers known to return heap objects or booleans. They
+ * are tracked through temps, and refined along the edges of the tests on
+ * them, so that a value proven a fixnum by one diamond is still known to be
+ * one in the diamonds it flows into.
+ *
+ * The redefinition flags of the basic operators are known clear once tested,
+ * until a call that may redefine a method.
+ *
+ * This is a forward analysis over extended blocks, to a fixed point. The
+ * types of commoned nodes are kept within their extended block.
+ */
+class TypePropagation : public TR::Optimization
+   {
+   public:
+
+   TypePropagation(TR::OptimizationManager *manager);
+
+   /**
+    * Optimization factory method
+    */
+   static TR::Optimization *create(TR::OptimizationManager *manager)
+      {
+      return new (manager->allocator()) TypePropagation(manager);
+      }
+
+   TR::CFG * cfg() { return comp()->getFlowGraph(); }
+
+   virtual int32_t perform();
+
+   /**
+    * The kinds of value a type is made of.
+    */
+   enum
+      {
+      TypeFixnum       = 0x001,
+      TypeFlonum       = 0x002,
+      TypeStaticSymbol = 0x004,
+      TypeNil          = 0x008,
+      TypeTrue         = 0x010,
+      TypeFalse        = 0x020,
+      TypeUndef        = 0x040,
+      TypeHeapObject   = 0x080,
+      TypeOther        = 0x100,
+      TypeAny          = 0x1ff,
+      };
+
+   static uint16_t getConstantType(VALUE value);
+
+   private:
+
+   /**
+    * The types of the tracked temps, and the basic operators known not to
+    * be redefined, at some point of the method.
+    */
+   struct State
+      {
+      uint16_t *types;
+      uint32_t  unredefinedBOPs;
+      bool      reached;
+      };
+
+   enum BranchOutcome
+      {
+      BranchUnknown,
+      BranchAlwaysTaken,
+      BranchNeverTaken,
+      };
+
+   void          collectTemps(TR::Node *, vcount_t);
+   bool          continuesExtendedBlock(TR::Block *, TR::Block *);
+   void          walkExtendedBlock(TR::Block *, bool fold);
+   void          evaluate(TR::Node *, State &);
+   uint16_t      computeType(TR::Node *, State &);
+   int32_t       getLowBit(TR::Node *, int32_t depth);
+   uint16_t      getHelperResultType(TR::Node *);
+   int32_t       getBOP(TR::SymbolReference *);
+   BranchOutcome refineOnBranch(TR::Node *, State &taken, State &notTaken, const char *&kind);
+   void          refineTemps(TR::Node *, uint16_t, State &);
+   void          mergeInto(TR::Block *, State &);
+   void          copyState(State &, State &);
+   void          foldBranch(TR::TreeTop *, bool taken);
+   void          anchorChildren(TR::Node *, TR::TreeTop *);
+
+   int32_t   _numTemps;
+
+   /**
+    * For each symbol reference, the index of the temp it is tracked as, or
+    * -1 if it is not a tracked temp.
+    */
+   int32_t  *_tempIndex;
+
+   /**
+    * For each tracked temp, the node of the current extended block whose
+    * value it holds, if any.
+    */
+   TR::Node **_tempValues;
+
+   State    *_inStates;
+   State     _current;
+   State     _taken;
+   bool      _changed;
+   vcount_t  _visitCount;
+
+   TR::TreeTop **_foldedBranches;
+   bool         *_foldTaken;
+   int32_t       _numFolds;
+   };
+
+}
+
+
+#endif
@@ -0,0 +1,15 @@
+# A chain of plus and minus on locals is fastpathed as one guarded region,
+# and runs on the slow path when an operand is not a Fixnum or a step
+# overflows.
+#
+# expect: ruby.fastpath/arithmetic_chain/3
+
+def combine(a, b, c, d)
+  a + b - c + d
+end
+
+max = 2**62 - 1
+
+10000.times { raise "combine(1, 2, 3, 4) is #{combine(1, 2, 3, 4)}" unless combine(1, 2, 3, 4) == 4 }
+raise "combine(max, 1, 1, 0) is #{combine(max, 1, 1, 0)}" unless combine(max, 1, 1, 0) == max
+raise "combine(1, 2, 0.5, 4) is #{combine(1, 2, 0.5, 4)}" unless combine(1, 2, 0.5, 4) == 6.5
@@ -0,0 +1,33 @@
+# Literal blocks using next and break are still inlined into the loops the
+# fastpather expands core iterators into. next ends the iteration with the
+# value of the block, and break ends the send with its own value.
+#
+# expect: ruby.callSites/send/intrinsic/times
+# expect: ruby.callSites/send/intrinsic/each
+# expect: ruby.callSites/send/intrinsic/map
+# expect: ruby.callSites/yield_literal_block/inlined
+
+def sum_even(n)
+  total = 0
+  n.times do |i|
+    next if i.odd?
+    total += i
+  end
+  total
+end
+
+def first_over(a, limit)
+  a.each { |x| break x if x > limit }
+end
+
+def clamped(a)
+  a.map { |x| next 0 if x < 0; x }
+end
+
+a = [1, 5, -2, 7]
+10000.times do
+  raise "sum_even(10) is #{sum_even(10)}" unless sum_even(10) == 20
+  raise "first_over(a, 4) is #{first_over(a, 4)}" unless first_over(a, 4) == 5
+  raise "first_over(a, 9) is #{first_over(a, 9)}" unless first_over(a, 9).equal?(a)
+  raise "clamped(a) is #{clamped(a)}" unless clamped(a) == [1, 5, 0, 7]
+end
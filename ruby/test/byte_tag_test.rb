@@ -0,0 +1,15 @@
+# The Fixnum tag tests of the fastpaths test the low byte of the value, and
+# still send to non-Fixnum receivers.
+#
+# expect: ruby.codegen/tagTest/byte
+
+def lt(a, b)
+  a < b
+end
+
+10000.times do
+  raise "lt(1, 2) is #{lt(1, 2)}" unless lt(1, 2) == true
+  raise "lt(2, 1) is #{lt(2, 1)}" unless lt(2, 1) == false
+end
+raise "lt(1.5, 2) is #{lt(1.5, 2)}" unless lt(1.5, 2) == true
+raise "lt(2**64, 1) is #{lt(2**64, 1)}" unless lt(2**64, 1) == false
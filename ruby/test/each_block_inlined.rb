@@ -0,0 +1,14 @@
+# The literal block of Array#each is inlined into the loop the fastpather
+# expands the send into.
+#
+# expect: ruby.callSites/send/intrinsic/each
+# expect: ruby.callSites/yield_literal_block/inlined
+
+def sum(a)
+  total = 0
+  a.each { |x| total += x }
+  total
+end
+
+a = [1, 2, 3, 4]
+10000.times { raise "sum(a) is #{sum(a)}" unless sum(a) == 10 }
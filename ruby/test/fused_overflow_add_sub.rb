@@ -0,0 +1,23 @@
+# The Fixnum fastpaths of plus and minus reuse the sum or difference their
+# overflow test computed, and still fall back to the send on overflow.
+#
+# expect: ruby.codegen/overflowResult/add
+# expect: ruby.codegen/overflowResult/sub
+
+def add(a, b)
+  a + b
+end
+
+def sub(a, b)
+  a - b
+end
+
+max = 2**62 - 1
+min = -2**62
+
+10000.times do
+  raise "add(3, 4) is #{add(3, 4)}" unless add(3, 4) == 7
+  raise "sub(3, 4) is #{sub(3, 4)}" unless sub(3, 4) == -1
+end
+raise "add(max, 1) is #{add(max, 1)}" unless add(max, 1) == 2**62
+raise "sub(min, 1) is #{sub(min, 1)}" unless sub(min, 1) == -2**62 - 1
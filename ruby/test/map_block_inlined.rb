@@ -0,0 +1,22 @@
+# The literal block of Array#map and Array#collect is inlined into the loop
+# the fastpather expands the send into, which collects the values of the
+# block into a new array.
+#
+# expect: ruby.callSites/send/intrinsic/map
+# expect: ruby.callSites/send/intrinsic/collect
+# expect: ruby.callSites/yield_literal_block/inlined
+
+def doubled(a)
+  a.map { |x| x * 2 }
+end
+
+def squared(a)
+  a.collect { |x| x * x }
+end
+
+a = [1, 2, 3, 4]
+10000.times do
+  raise "doubled(a) is #{doubled(a)}" unless doubled(a) == [2, 4, 6, 8]
+  raise "squared(a) is #{squared(a)}" unless squared(a) == [1, 4, 9, 16]
+  raise "doubled([]) is #{doubled([])}" unless doubled([]) == []
+end
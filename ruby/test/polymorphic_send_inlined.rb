@@ -0,0 +1,40 @@
+# A send whose receiver changes class after its profile was taken is inlined
+# for both the profiled class and the class its inline cache was refilled for,
+# each behind its own class guard.
+#
+# expect: ruby.callSites/send_without_block/inlineable/polymorphic
+# expect: ruby.callSites/send_without_block/polymorphic/2
+
+class Square
+  def initialize(side)
+    @side = side
+  end
+
+  def area
+    @side * @side
+  end
+end
+
+class Rect
+  def initialize(w, h)
+    @w = w
+    @h = h
+  end
+
+  def area
+    @w * @h
+  end
+end
+
+def area_of(shape)
+  shape.area
+end
+
+square = Square.new(3)
+rect = Rect.new(2, 5)
+
+1000.times { raise "square area is #{area_of(square)}" unless area_of(square) == 9 }
+10000.times do
+  raise "rect area is #{area_of(rect)}" unless area_of(rect) == 10
+  raise "square area is #{area_of(square)}" unless area_of(square) == 9
+end
@@ -0,0 +1,17 @@
+# The literal block of Range#each is inlined into the loop the fastpather
+# expands the send into, for inclusive and exclusive ranges.
+#
+# expect: ruby.callSites/send/intrinsic/each
+# expect: ruby.callSites/yield_literal_block/inlined
+
+def sum(r)
+  total = 0
+  r.each { |i| total += i }
+  total
+end
+
+10000.times do
+  raise "sum(1..100) is #{sum(1..100)}" unless sum(1..100) == 5050
+  raise "sum(1...100) is #{sum(1...100)}" unless sum(1...100) == 4950
+  raise "sum(1..0) is #{sum(1..0)}" unless sum(1..0) == 0
+end
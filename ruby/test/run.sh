@@ -0,0 +1,56 @@
+#!/bin/sh
+###################################################################################
+# (c) Copyright IBM Corp. 2000, 2016
+#
+#  This program and the accompanying materials are made available
+#  under the terms of the Eclipse Public License v1.0 and
+#  Apache License v2.0 which accompanies this distribution.
+#
+#      The Eclipse Public License is available at
+#      http://www.eclipse.org/legal/epl-v10.html
+#
+#      The Apache License v2.0 is available at
+#      http://www.opensource.org/licenses/apache2.0.php
+#
+# Contributors:
+#    Multiple authors (IBM Corp.) - initial implementation and documentation
+##################################################################################
+
+# Run the JIT tests against a Ruby built with this JIT:
+#
+#    RUBY=/path/to/ruby ./run.sh [test.rb...]
+#
+# Each test checks its own results, and lists with `# expect:` lines the
+# static debug counters its compilations must hit.
+
+RUBY=${RUBY:-ruby}
+TESTDIR=$(dirname "$0")
+failed=0
+
+[ $# -eq 0 ] && set -- "$TESTDIR"/*.rb
+
+for test in "$@"
+do
+   counters=$(sed -n 's/^# expect: *//p' "$test")
+   output=$(OMR_JIT_OPTIONS="-Xjit:staticDebugCounters={ruby.*}" "$RUBY" "$test" 2>&1)
+   if [ $? -ne 0 ]
+   then
+      echo "FAIL $test"
+      echo "$output"
+      failed=1
+      continue
+   fi
+
+   for counter in $counters
+   do
+      if ! echo "$output" | grep -q "$counter"
+      then
+         echo "FAIL $test: $counter not hit"
+         failed=1
+         continue 2
+      fi
+   done
+   echo "PASS $test"
+done
+
+exit $failed
@@ -0,0 +1,13 @@
+# A send of Array#map passing &:sym is expanded into a loop sending the
+# symbol's method to each element.
+#
+# expect: ruby.callSites/send/intrinsic/symbolBlock/map
+
+Item = Struct.new(:name)
+
+def names(a)
+  a.map(&:name)
+end
+
+a = [Item.new("x"), Item.new("y")]
+10000.times { raise "names(a) is #{names(a)}" unless names(a) == ["x", "y"] }
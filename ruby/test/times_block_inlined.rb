@@ -0,0 +1,13 @@
+# The literal block of Integer#times is inlined into the loop the fastpather
+# expands the send into.
+#
+# expect: ruby.callSites/send/intrinsic/times
+# expect: ruby.callSites/yield_literal_block/inlined
+
+def sum(n)
+  total = 0
+  n.times { |i| total += i }
+  total
+end
+
+10000.times { raise "sum(100) is #{sum(100)}" unless sum(100) == 4950 }
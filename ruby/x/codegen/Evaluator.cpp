@@ -19,11 +19,252 @@
 
 #include "codegen/TreeEvaluator.hpp"
 #include "codegen/X86Evaluator.hpp"
+#include "codegen/CodeGenerator.hpp"
+#include "codegen/RegisterDependency.hpp"
+#include "env/ConcreteFE.hpp"
+#include "env/CompilerEnv.hpp"
+#include "il/Block.hpp"
 #include "il/Node.hpp"
 #include "il/Node_inlines.hpp"
+#include "ras/DebugCounter.hpp"
+#include "x/codegen/X86Instruction.hpp"
 
 extern "C"
    {
    void *fwdHalfWordCopyTable = 0;
    };
 
+
+static bool
+taggedEvaluatorsDisabled()
+   {
+   static auto *disableTaggedEvaluators = feGetEnv("OMR_RUBY_DISABLE_TAGGED_EVALUATORS");
+   return disableTaggedEvaluators != NULL;
+   }
+
+/**
+ * Generate the branch of a conditional branch node to its destination,
+ * with the global register dependencies of its last child, if any.
+ */
+static void
+generateBranch(TR_X86OpCodes op, TR::Node *node, int32_t numChildren, TR::CodeGenerator *cg)
+   {
+   TR::RegisterDependencyConditions *deps = NULL;
+   if (node->getNumChildren() > numChildren)
+      {
+      TR::Node *glRegDeps = node->getChild(numChildren);
+      cg->evaluate(glRegDeps);
+      deps = generateRegisterDependencyConditions(glRegDeps, cg, 0);
+      cg->decReferenceCount(glRegDeps);
+      }
+   generateLabelInstruction(op, node, node->getBranchDestination()->getNode()->getLabel(), deps, cg);
+   }
+
+/**
+ * Drop the sum or difference an overflow test left, if no add or subtract
+ * reused it.
+ */
+static void
+clearOverflowResult(TR::CodeGenerator *cg)
+   {
+   TR::CodeGenerator::OverflowResult &result = cg->overflowResult();
+   if (result.reg)
+      cg->stopUsingRegister(result.reg);
+   result = TR::CodeGenerator::OverflowResult();
+   }
+
+/**
+ * The overflow tests of the fastpaths of plus and minus:
+ *
+ *    iflcmno(a, b)    if (a + b) overflows
+ *    iflcmpo(a, b)    if (a - b) overflows
+ *
+ * are followed by the ladd or lsub of the same operands. The sum or
+ * difference is computed here, by the add or sub whose overflow flag the
+ * branch tests, and left for that add or subtract to reuse, so that each
+ * operation of the fast path is a single add or sub and jo.
+ */
+static TR::Register *
+overflowTestEvaluator(TR::Node *node, bool isAdd, bool branchOnOverflow, TR::CodeGenerator *cg)
+   {
+   TR::Node *left  = node->getFirstChild();
+   TR::Node *right = node->getSecondChild();
+
+   TR::Register *leftReg  = cg->evaluate(left);
+   TR::Register *rightReg = cg->evaluate(right);
+
+   clearOverflowResult(cg);
+
+   TR::Register *resultReg = cg->allocateRegister();
+   generateRegRegInstruction(MOV8RegReg, node, resultReg, leftReg, cg);
+   generateRegRegInstruction(isAdd ? ADD8RegReg : SUB8RegReg, node, resultReg, rightReg, cg);
+
+   TR::CodeGenerator::OverflowResult &result = cg->overflowResult();
+   result.left  = left;
+   result.right = right;
+   result.isAdd = isAdd;
+   result.reg   = resultReg;
+
+   generateBranch(branchOnOverflow ? JO4 : JNO4, node, 2, cg);
+
+   cg->decReferenceCount(left);
+   cg->decReferenceCount(right);
+   return NULL;
+   }
+
+/**
+ * Reuse the sum or difference an overflow test computed, if `node` adds or
+ * subtracts the same operands.
+ */
+static TR::Register *
+reuseOverflowResult(TR::Node *node, bool isAdd, TR::CodeGenerator *cg)
+   {
+   TR::CodeGenerator::OverflowResult &result = cg->overflowResult();
+   if (!result.reg ||
+       result.isAdd != isAdd ||
+       node->getFirstChild()  != result.left ||
+       node->getSecondChild() != result.right)
+      return NULL;
+
+   TR::Register *resultReg = result.reg;
+   result = TR::CodeGenerator::OverflowResult();
+
+   TR::DebugCounter::incStaticDebugCounter(cg->comp(), TR::DebugCounter::debugCounterName(cg->comp(), "ruby.codegen/overflowResult/%s", isAdd ? "add" : "sub"));
+
+   node->setRegister(resultReg);
+   cg->decReferenceCount(node->getFirstChild());
+   cg->decReferenceCount(node->getSecondChild());
+   return resultReg;
+   }
+
+/**
+ * The tag tests of the fastpaths:
+ *
+ *    iflcmpeq(land(v, mask), 0)
+ *    iflcmpne(land(v, mask), 0)
+ *
+ * with a mask that fits in a byte, as a test of the low byte of v:
+ *
+ *    test v, mask
+ *    je/jne
+ *
+ * \return false if `node` is not a tag test.
+ */
+static bool
+tagTestEvaluator(TR::Node *node, bool isEqual, TR::CodeGenerator *cg)
+   {
+   TR::Node *andNode  = node->getFirstChild();
+   TR::Node *zeroNode = node->getSecondChild();
+   if (andNode->getOpCodeValue() != TR::land      ||
+       andNode->getReferenceCount() != 1          ||
+       andNode->getRegister()                     ||
+       zeroNode->getOpCodeValue() != TR::lconst   ||
+       zeroNode->getLongInt() != 0)
+      return false;
+
+   TR::Node *valueNode = andNode->getFirstChild();
+   TR::Node *maskNode  = andNode->getSecondChild();
+   if (maskNode->getOpCodeValue() != TR::lconst ||
+       maskNode->getLongInt() <= 0              ||
+       maskNode->getLongInt() > 0x7f)
+      return false;
+
+   TR::DebugCounter::incStaticDebugCounter(cg->comp(), TR::DebugCounter::debugCounterName(cg->comp(), "ruby.codegen/tagTest/byte"));
+
+   TR::Register *valueReg = cg->evaluate(valueNode);
+   generateRegImmInstruction(TEST1RegImm1, node, valueReg, maskNode->getLongInt(), cg);
+   generateBranch(isEqual ? JE4 : JNE4, node, 2, cg);
+
+   cg->decReferenceCount(valueNode);
+   cg->decReferenceCount(maskNode);
+   cg->decReferenceCount(andNode);
+   cg->decReferenceCount(zeroNode);
+   return true;
+   }
+
+/**
+ * A sum or difference is only reused within the extended block of its
+ * overflow test: the fastpath's result is computed in the block the test
+ * falls through to, but nothing carries the register into a block entered
+ * any other way.
+ */
+TR::Register *
+Ruby::X86::TreeEvaluator::BBStartEvaluator(TR::Node *node, TR::CodeGenerator *cg)
+   {
+   if (!node->getBlock()->isExtensionOfPreviousBlock())
+      clearOverflowResult(cg);
+   return OMR::TreeEvaluatorConnector::BBStartEvaluator(node, cg);
+   }
+
+TR::Register *
+Ruby::X86::TreeEvaluator::BBEndEvaluator(TR::Node *node, TR::CodeGenerator *cg)
+   {
+   TR::Block *nextBlock = node->getBlock()->getNextBlock();
+   if (!nextBlock || !nextBlock->isExtensionOfPreviousBlock())
+      clearOverflowResult(cg);
+   return OMR::TreeEvaluatorConnector::BBEndEvaluator(node, cg);
+   }
+
+TR::Register *
+Ruby::X86::TreeEvaluator::iflcmnoEvaluator(TR::Node *node, TR::CodeGenerator *cg)
+   {
+   if (!TR::Compiler->target.is64Bit() || taggedEvaluatorsDisabled())
+      return OMR::TreeEvaluatorConnector::iflcmnoEvaluator(node, cg);
+
+   return overflowTestEvaluator(node, true, node->getOpCodeValue() == TR::iflcmno, cg);
+   }
+
+TR::Register *
+Ruby::X86::TreeEvaluator::iflcmpoEvaluator(TR::Node *node, TR::CodeGenerator *cg)
+   {
+   if (!TR::Compiler->target.is64Bit() || taggedEvaluatorsDisabled())
+      return OMR::TreeEvaluatorConnector::iflcmpoEvaluator(node, cg);
+
+   return overflowTestEvaluator(node, false, node->getOpCodeValue() == TR::iflcmpo, cg);
+   }
+
+TR::Register *
+Ruby::X86::TreeEvaluator::integerAddEvaluator(TR::Node *node, TR::CodeGenerator *cg)
+   {
+   if (node->getOpCodeValue() == TR::ladd)
+      {
+      TR::Register *resultReg = reuseOverflowResult(node, true, cg);
+      if (resultReg)
+         return resultReg;
+      }
+   return OMR::TreeEvaluatorConnector::integerAddEvaluator(node, cg);
+   }
+
+TR::Register *
+Ruby::X86::TreeEvaluator::integerSubEvaluator(TR::Node *node, TR::CodeGenerator *cg)
+   {
+   if (node->getOpCodeValue() == TR::lsub)
+      {
+      TR::Register *resultReg = reuseOverflowResult(node, false, cg);
+      if (resultReg)
+         return resultReg;
+      }
+   return OMR::TreeEvaluatorConnector::integerSubEvaluator(node, cg);
+   }
+
+TR::Register *
+Ruby::X86::TreeEvaluator::integerIfCmpeqEvaluator(TR::Node *node, TR::CodeGenerator *cg)
+   {
+   if (node->getOpCodeValue() == TR::iflcmpeq &&
+       TR::Compiler->target.is64Bit()          &&
+       !taggedEvaluatorsDisabled()             &&
+       tagTestEvaluator(node, true, cg))
+      return NULL;
+   return OMR::TreeEvaluatorConnector::integerIfCmpeqEvaluator(node, cg);
+   }
+
+TR::Register *
+Ruby::X86::TreeEvaluator::integerIfCmpneEvaluator(TR::Node *node, TR::CodeGenerator *cg)
+   {
+   if (node->getOpCodeValue() == TR::iflcmpne &&
+       TR::Compiler->target.is64Bit()          &&
+       !taggedEvaluatorsDisabled()             &&
+       tagTestEvaluator(node, false, cg))
+      return NULL;
+   return OMR::TreeEvaluatorConnector::integerIfCmpneEvaluator(node, cg);
+   }
@@ -0,0 +1,70 @@
+/*******************************************************************************
+ *
+ * (c) Copyright IBM Corp. 2000, 2016
+ *
+ *  This program and the accompanying materials are made available
+ *  under the terms of the Eclipse Public License v1.0 and
+ *  Apache License v2.0 which accompanies this distribution.
+ *
+ *      The Eclipse Public License is available at
+ *      http://www.eclipse.org/legal/epl-v10.html
+ *
+ *      The Apache License v2.0 is available at
+ *      http://www.opensource.org/licenses/apache2.0.php
+ *
+ * Contributors:
+ *    Multiple authors (IBM Corp.) - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef RUBY_X86_TREE_EVALUATORBASE_INCL
+#define RUBY_X86_TREE_EVALUATORBASE_INCL
+
+/*
+ * The following #define and typedef must appear before any #includes in this file
+ */
+#ifndef RUBY_TREE_EVALUATOR_CONNECTOR
+#define RUBY_TREE_EVALUATOR_CONNECTOR
+
+namespace Ruby { namespace X86 { class TreeEvaluator; } }
+namespace Ruby { typedef Ruby::X86::TreeEvaluator TreeEvaluatorConnector; }
+
+#else
+#error Ruby::X86::TreeEvaluator expected to be a primary connector, but a Ruby connector is already defined
+#endif
+
+
+#include "codegen/OMRTreeEvaluator.hpp"
+
+namespace TR { class CodeGenerator; }
+namespace TR { class Node; }
+namespace TR { class Register; }
+
+namespace Ruby
+{
+
+namespace X86
+{
+
+/**
+ * Evaluators for the IL shapes of the fastpaths of tagged fixnum arithmetic
+ * and tag tests. Each defers to the OMR evaluator when the node is not of
+ * that shape.
+ */
+class OMR_EXTENSIBLE TreeEvaluator : public OMR::TreeEvaluatorConnector
+   {
+   public:
+
+   static TR::Register *BBStartEvaluator(TR::Node *node, TR::CodeGenerator *cg);
+   static TR::Register *BBEndEvaluator(TR::Node *node, TR::CodeGenerator *cg);
+   static TR::Register *iflcmnoEvaluator(TR::Node *node, TR::CodeGenerator *cg);
+   static TR::Register *iflcmpoEvaluator(TR::Node *node, TR::CodeGenerator *cg);
+   static TR::Register *integerAddEvaluator(TR::Node *node, TR::CodeGenerator *cg);
+   static TR::Register *integerSubEvaluator(TR::Node *node, TR::CodeGenerator *cg);
+   static TR::Register *integerIfCmpeqEvaluator(TR::Node *node, TR::CodeGenerator *cg);
+   static TR::Register *integerIfCmpneEvaluator(TR::Node *node, TR::CodeGenerator *cg);
+   };
+
+}
+
+}
+#endif